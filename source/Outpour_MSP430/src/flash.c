@@ -69,15 +69,22 @@ void msp430Flash_erase_segment(uint8_t *flashSegmentAddrP) {
 * \brief Write data bytes to flash
 * \ingroup PUBLIC_API
 * 
+* The write is done in word mode wherever the flash address is 
+* word aligned.  Programming a word takes the same 30 tFTG as 
+* programming a byte, so aligned data is written in about half 
+* the time of a byte-by-byte write.  A leading odd address byte 
+* and a trailing odd byte are written in byte mode.  The bytes 
+* are copied in order, so the flash contents are the same as a 
+* byte-by-byte write. 
+* 
 * @param flashP  starting flash addr to write to
 * @param srcP starting addr where data is read from
 * @param num_bytes number of bytes to write
 */
 void msp430Flash_write_bytes(uint8_t *flashP, uint8_t *srcP, uint16_t num_bytes) {
-    volatile uint16_t i;
     volatile uint16_t us100_check_count;
     volatile uint8_t contextSaveSR;
-    volatile uint8_t checkCount = 0;
+    uint8_t step;
     contextSaveSR = __get_SR_register();
 
     // Clear GIE
@@ -87,12 +94,22 @@ void msp430Flash_write_bytes(uint8_t *flashP, uint8_t *srcP, uint16_t num_bytes)
     FCTL3 = FWKEY;                    // Clear Lock bit
     FCTL1 = (FWKEY | WRT);            // Enable write
 
-    // Write each byte
-    us100_check_count = 0;
-    for (i = 0; i < num_bytes; i++) {
+    // Write each word (or odd byte)
+    while (num_bytes) {
         us100_check_count = 0;
 
-        *flashP++ = *srcP++;
+        if (((uint16_t)flashP & 0x1) || (num_bytes == 1)) {
+            *flashP = *srcP;
+            step = 1;
+        } else {
+            // Build the word from the bytes so the source does not need
+            // to be word aligned.  The MSP430 is little endian.
+            *((uint16_t *)flashP) = (srcP[1] << 8) | srcP[0];
+            step = 2;
+        }
+        flashP += step;
+        srcP += step;
+        num_bytes -= step;
         /*
          * From the MSP40 Documentation
          * When a byte or word write or any erase operation is initiated 
@@ -107,7 +124,7 @@ void msp430Flash_write_bytes(uint8_t *flashP, uint8_t *srcP, uint16_t num_bytes)
          * kept around just to be safe? 
          * 
          * note - from empirical lab testing, it takes ~.15125ms to
-         * program each byte.
+         * program each byte (or word).
          */
         while (FCTL3 & BUSY) {
             // rough loop delay of 100us (assumes operating @ 1MHZ Clock);
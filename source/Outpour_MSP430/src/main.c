@@ -72,6 +72,9 @@ void sysError(void) {
 //  External ISR prototypes used by ProxyVectorTable
 //
 extern __interrupt void ISR_Timer1_A0(void);
+#if (MODEM_LINK_FAST_POWER_UP==1)
+extern __interrupt void ISR_Timer1_A1(void);
+#endif
 extern __interrupt void USCI0TX_ISR(void);
 extern __interrupt void USCI0RX_ISR(void);
 extern __interrupt void watchdog_timer(void);
@@ -87,6 +90,7 @@ __interrupt void Dummy_Isr(void)
 {
     // Something catastrophic has happened.
     // Erase the application record so that the bootloader will go into SOS mode.
+    // The INFO C event log (RECORD_EVENT_LOG) is erased with it.
     msp430Flash_erase_segment(APR_LOCATION);
     // Force watchdog reset
     WDTCTL = 0xDEAD;
@@ -137,7 +141,11 @@ const uint16_t ProxyVectorTable[] =
     0x4030, (uint16_t) Dummy_Isr,           // APP_PROXY_VECTOR(6) T0_0
     0x4030, (uint16_t) watchdog_timer,      // APP_PROXY_VECTOR(7) WDT
     0x4030, (uint16_t) Dummy_Isr,           // APP_PROXY_VECTOR(8) COMP_A
+#if (MODEM_LINK_FAST_POWER_UP==1)
+    0x4030, (uint16_t) ISR_Timer1_A1,       // APP_PROXY_VECTOR(9) TA1_1
+#else
     0x4030, (uint16_t) Dummy_Isr,           // APP_PROXY_VECTOR(9) TA1_1
+#endif
     0x4030, (uint16_t) ISR_Timer1_A0,       // APP_PROXY_VECTOR(10) TA1_0
     0x4030, (uint16_t) Dummy_Isr,           // APP_PROXY_VECTOR(11) NMI
 };
@@ -6,20 +6,48 @@
  * \brief Handle sending commands to and getting responses from 
  *        the modem.  Handle the details of modem message
  *        protocol and format details.
+ *
+ * \note Commands written while a transaction is in progress are
+ *       queued.  The UART ISRs only flag the end of the transmit
+ *       and of the response and wake up the main loop, which calls
+ *       modemCmd_exec between the one second ticks (see
+ *       sysExec_exec).  modemCmd_exec validates the response,
+ *       passes it to the response function (see
+ *       modemCmd_setResponseFunc) and starts the next queued
+ *       command, so a batch of commands does not wait a tick per
+ *       command.  Timeouts are checked on the tick.
+ *
+ * \note With MODEM_ADAPTIVE_TIMEOUT, the round trip times of the 
+ *       send data and the partial read commands (the ones with a
+ *       payload) are measured with the fine tick (1/1024 second)
+ *       and kept (min, avg, max, see modemCmd_getRttStats).  The
+ *       timeout of these commands is twice their longest round
+ *       trip plus a margin and the transmit time of the payload,
+ *       doubled on each retry and capped at
+ *       MODEM_TX_RX_TIMEOUT_IN_SEC.  As the timeout is checked on
+ *       the tick, a lost byte costs one to two seconds of modem on
+ *       time per try instead of ten to eleven.  Off by default: it
+ *       costs about 280 bytes of code and 10 bytes of RAM.
+ *
+ * \note DATA_MSG_MULTI_DAY: A send data payload that is not in
+ *       one buffer (the daily logs of a multi-day message are in
+ *       flash, with a few bytes between them that are not) is read
+ *       in segments: the payloadFuncP of the command is called by
+ *       the transmit ISR at the end of each segment to get the
+ *       next one.  The CRC of such a payload can only be computed
+*       as it is sent, so it needs MODEM_CMD_ISR_CRC.
  */
 
 #include "outpour.h"
 
+#if (DATA_MSG_MULTI_DAY==1) && (MODEM_CMD_ISR_CRC==0)
+#error DATA_MSG_MULTI_DAY needs MODEM_CMD_ISR_CRC
+#endif
+
 /***************************
  * Module Data Definitions
  **************************/
 
-/**
- * \def ISR_BUF_SIZE 
- * \brief Define the size of the UART receive buffer. 
- */
-#define ISR_BUF_SIZE ((uint8_t)48)
-
 /**
  * \def MODEM_CMD_START_BYTE 
  * \brief Modem Command start byte 
@@ -45,6 +73,37 @@
  */
 #define MODEM_TX_RX_TIMEOUT_IN_SEC ((uint32_t)10*(TIME_SCALER))
 
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+/**
+ * \def MODEM_RTT_TIMEOUT_MARGIN
+ * \brief Define the margin (in fine ticks) added to twice the 
+ *        longest round trip of a command for its timeout.
+ */
+#define MODEM_RTT_TIMEOUT_MARGIN ((uint16_t)(FINE_TICKS_PER_SEC / 4))
+
+/**
+ * \def MODEM_UART_BYTES_PER_SEC
+ * \brief Define the UART byte rate to the modem (9600 baud, ten 
+ *        bits per byte).
+ */
+#define MODEM_UART_BYTES_PER_SEC ((uint16_t)960)
+
+/**
+ * \def MODEM_CMD_RTT_SHIFT
+ * \brief Define the unit of the round trip time statistics as 
+ *        a power of two of fine ticks (1/64 second, up to 4
+ *        seconds in a byte).
+ */
+#define MODEM_CMD_RTT_SHIFT 4
+
+/**
+ * \def MODEM_CMD_RTT_NUM_CMDS
+ * \brief Define how many commands have round trip time 
+ *        statistics (see rttCmdIds).
+ */
+#define MODEM_CMD_RTT_NUM_CMDS ((uint8_t)2)
+#endif
+
 /**
  * \typedef txIsrState_t
  * \brief Define the states that the tx ISR will transition 
@@ -67,6 +126,27 @@ typedef enum txIsrState_e {
  */
 #define MODEM_CMD_MAX_RETRIES ((uint8_t)3)
 
+/**
+ * \def MODEM_CMD_QUEUE_SIZE
+ * \brief Define how many commands can wait behind the one in 
+ *        progress.  A modem manager batch job is four commands.
+ */
+#define MODEM_CMD_QUEUE_SIZE ((uint8_t)4)
+
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+/**
+ * \typedef rttData_t
+ * \brief Round trip time statistics of one command in 
+ *        MODEM_CMD_RTT_SHIFT units.  A max of zero means no
+ *        response was measured yet.
+ */
+typedef struct rttData_s {
+    uint8_t min;                       /**< shortest round trip */
+    uint8_t max;                       /**< longest round trip */
+    uint16_t avgX8;                    /**< running average round trip times 8 */
+} rttData_t;
+#endif
+
 /**
  * \typedef modemCmdData_t 
  * \brief Contains module data 
@@ -75,22 +155,40 @@ typedef struct modemCmdData_s {
 
     bool busy;                         /**< signals we are busy sending a modem msg */
     modem_command_t modemCmdId;        /**< the cmd we are sending to the modem */
+    const modemCmdWriteData_t *cmdP;   /**< the cmd info object (to rebuild the header for a retry) */
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    fine_tick_t sendTimestamp;         /**< time we enabled the tx isr */
+#else
     sys_tick_t sendTimestamp;          /**< time we enabled the tx isr */
+#endif
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    uint16_t timeoutInFineTicks;       /**< timeout of the current try */
+#endif
 
     uint8_t retryCount;                /**< how many tries to tx/rx the msg */
     bool msgTxRxFailed;                /**< the message failed to tx or rx properly */
-    bool responseReady;                /**< flag to indicate we have response data ready for pickup */
-    uint16_t crc;                      /**< crc16 calculated value on tx or rx msg */
+#if (MODEM_CMD_ISR_CRC==1)
+    uint16_t txCrc;                    /**< running crc16 of the tx msg, updated by the tx isr */
+    uint16_t rxCrc;                    /**< running crc16 of the rx msg, updated by the rx isr */
+#else
+    uint16_t txCrc;                    /**< crc16 of the tx msg */
+#endif
 
     uint8_t *txHeaderP;                /**< buffer for holding modem msg cmd header */
     uint8_t txHeaderLength;            /**< length of msg tx cmd header */
-    bool txMsgContainsAPayload;        /**< modem tx msg has data associated with it */
-    uint16_t txMsgPayloadLength;       /**< modem tx msg data payload length (if any) */
+    uint16_t txMsgPayloadLength;       /**< modem tx msg data payload length (0 if none) */
     uint8_t expectedResponseLength;    /**< expected msg response length */
 
     txIsrState_t txIsrState;           /**< holds the tx isr state */
     bool txIsrMsgComplete;             /**< A complete msg has been transmitted */
+#if (DATA_MSG_MULTI_DAY==1)
+    uint8_t *txPayloadP;               /**< pointer to tx data payload (segment) */
+    modemCmdPayloadFunc_t txPayloadFuncP; /**< returns the payload segments, NULL for one buffer */
+    uint16_t txSegmentLength;          /**< length of the payload segment */
+    uint8_t txSegment;                 /**< number of the payload segment */
+#else
     uint8_t *txPayloadP;               /**< pointer to tx data payload */
+#endif
     uint16_t txIsrDataIndex;           /**< Tx Isr Data Index into buffer */
 
     bool rxIsrMsgComplete;             /**< A complete msg has been received */
@@ -102,6 +200,14 @@ typedef struct modemCmdData_s {
     uint8_t statsWrongResp;            /**< Total illegal modem responses */
     uint8_t statsSuccessiveCmdErrors;  /**< Number of errors in a row, zeros on any good */
 
+    const modemCmdWriteData_t *queue[MODEM_CMD_QUEUE_SIZE]; /**< commands waiting, next first */
+    uint8_t queueCount;                /**< number of commands waiting */
+    modemCmdResponseFunc_t responseFuncP; /**< called when each command is done */
+
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    rttData_t rtt[MODEM_CMD_RTT_NUM_CMDS]; /**< round trip times, indexed as rttCmdIds */
+#endif
+
 } modemCmdData_t;
 
 /****************************
@@ -121,14 +227,37 @@ uint8_t isrCommBuf[ISR_BUF_SIZE];  /**< Common buffer used to tx and rx data to/
 // static
 modemCmdData_t mcData;
 
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+/**
+* \var rttCmdIds
+* \brief The commands with round trip time statistics.  The 
+*        other commands are short and keep the fixed timeout.
+*/
+static const uint8_t rttCmdIds[MODEM_CMD_RTT_NUM_CMDS] = {
+    M_COMMAND_SEND_DATA,
+    M_COMMAND_GET_INCOMING_PARTIAL,
+};
+#endif
+
 /*************************
  * Module Prototypes
  ************************/
 
 static bool modemCmdProcessRxMsg(void);
+static void modemCmdStart(const modemCmdWriteData_t *writeCmdP);
+static void modemCmdPrepare(const modemCmdWriteData_t *writeCmdP);
 static void modemCmdIsrRestart(void);
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+static uint8_t modemCmdRttIndex(modem_command_t cmd);
+static void modemCmdRecordRtt(void);
+static void modemCmdSetTimeout(void);
+#endif
+static void modemCmdDone(void);
 static void modemCmdCleanup(void);
 static void initForPingCmd(void);
+#if (MODEM_TRANSMIT_SPREAD==1)
+static void initForModemInfoCmd(void);
+#endif
 static void initForPowerOffCmd(void);
 static void initForSendDataCmd(uint8_t *payloadP, uint16_t payloadSize, uint8_t payloadMsgId);
 static void initForSendDebugDataCmd(uint8_t *payloadP, uint16_t payloadSize, uint8_t payloadMsgId);
@@ -147,10 +276,11 @@ static inline void disable_UART_rx(void);
 
 /**
 * \brief Modem Cmd executive.  Called on the 1 second system 
-*        tick to manage a single modem transmit/receive
-*        transaction.  If no transaction is in progress, just
-*        returns.  Detects when a transaction is timeout or
-*        completed successfully.
+*        tick, and when the UART ISRs wake up the main loop, to
+*        manage a single modem transmit/receive transaction.  If
+*        no transaction is in progress, just returns.  Detects
+*        when a transaction is timeout or completed successfully,
+*        and starts the next queued one.
 * \ingroup EXEC_ROUTINE
 */
 void modemCmd_exec(void) {
@@ -169,8 +299,10 @@ void modemCmd_exec(void) {
         msgOk = modemCmdProcessRxMsg();
         if (msgOk) {
             // Success! Message transaction complete
-            mcData.responseReady = true;
             mcData.statsSuccessiveCmdErrors = 0;
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+            modemCmdRecordRtt();
+#endif
             done = true;
         } else {
             retryNeeded = true;
@@ -179,9 +311,19 @@ void modemCmd_exec(void) {
         }
     }
     // Check for a timeout
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    else if (GET_ELAPSED_FINE_TICKS(mcData.sendTimestamp) > mcData.timeoutInFineTicks) {
+#else
     else if (GET_ELAPSED_TIME_IN_SEC(mcData.sendTimestamp) > MODEM_TX_RX_TIMEOUT_IN_SEC) {
+#endif
         retryNeeded = true;
         mcData.statsTimeouts++;
+#if (RECORD_EVENT_LOG==1)
+        // Only log the timeout of the last try
+        if (mcData.retryCount >= MODEM_CMD_MAX_RETRIES) {
+            storageMgr_logEvent(EVENT_MODEM_TIMEOUT, mcData.modemCmdId);
+        }
+#endif
     }
 
     if (retryNeeded) {
@@ -189,7 +331,9 @@ void modemCmd_exec(void) {
         if (mcData.retryCount < MODEM_CMD_MAX_RETRIES) {
             mcData.retryCount++;
             mcData.statsRetries++;
-            // Resend the command
+            // Resend the command.  The response shares the buffer with
+            // the command header, so build the header again.
+            modemCmdPrepare(mcData.cmdP);
             modemCmdIsrRestart();
         } else {
             mcData.msgTxRxFailed = true;
@@ -198,7 +342,7 @@ void modemCmd_exec(void) {
     }
 
     if (done) {
-        modemCmdCleanup();
+        modemCmdDone();
     }
 }
 
@@ -215,70 +359,58 @@ void modemCmd_init(void) {
 }
 
 /**
-* \brief Start a new data tx/rx transaction with the modem.
+* \brief Set the function called when each command is done 
+*        (response validated, or failed after the retries).  It
+*        is called from modemCmd_exec and must read the response
+*        with modemCmd_read before returning, as the next queued
+*        command reuses the buffer.
+* \ingroup PUBLIC_API
+* 
+* @param responseFuncP The function (NULL for none)
+*/
+void modemCmd_setResponseFunc(modemCmdResponseFunc_t responseFuncP) {
+    mcData.responseFuncP = responseFuncP;
+}
+
+/**
+* \brief Start a new data tx/rx transaction with the modem, or 
+*        queue it behind the transaction in progress.
 * \ingroup PUBLIC_API
 * 
 * @param writeCmdP Pointer to a modemCmdWriteData_t object 
 *                  initialized with the cmd data to transmit.
+*                  IMPORTANT - object must not be on the stack if
+*                  the command is queued.
 * 
-* @return bool Returns true if the modem is not busy and a 
-*         message transaction session was started.
+* @return bool Returns true if the message transaction was 
+*         started or queued, false if the queue is full.
 */
-bool modemCmd_write(modemCmdWriteData_t *writeCmdP) {
+bool modemCmd_write(const modemCmdWriteData_t *writeCmdP) {
     // Bad....
     if (writeCmdP == NULL) {
         sysError();
     }
 
-    // If not busy, mark as busy.  Other return false if already busy.
     if (!mcData.busy) {
-        // For safety, disable UART interrupts
-        disable_UART_tx();
-        disable_UART_rx();
         mcData.busy = true;
+        modemCmdStart(writeCmdP);
+    } else if (mcData.queueCount < MODEM_CMD_QUEUE_SIZE) {
+        mcData.queue[mcData.queueCount++] = writeCmdP;
     } else {
         return false;
     }
-
-    // Prepare the command to send to the modem.
-    switch (writeCmdP->cmd) {
-    case M_COMMAND_PING:
-        initForPingCmd();
-        break;
-    case M_COMMAND_MODEM_STATUS:
-        initForModemStatusCmd();
-        break;
-    case M_COMMAND_MESSAGE_STATUS:
-        initForMsgStatusCmd();
-        break;
-    case M_COMMAND_SEND_DATA:
-        initForSendDataCmd(writeCmdP->payloadP, writeCmdP->payloadLength, writeCmdP->payloadMsgId);
-        break;
-    case M_COMMAND_SEND_DEBUG_DATA:
-        initForSendDebugDataCmd(writeCmdP->payloadP, writeCmdP->payloadLength, writeCmdP->payloadMsgId);
-        break;
-    case M_COMMAND_GET_INCOMING_PARTIAL:
-        initForIncommingPartialCmd(writeCmdP->payloadOffset, writeCmdP->payloadLength);
-        break;
-    case M_COMMAND_DELETE_INCOMING:
-        initForDeleteIncomingCmd();
-        break;
-    case M_COMMAND_POWER_OFF:
-        initForPowerOffCmd();
-        break;
-    default:
-        sysError();
-    }
-
-    // Init ISR parameters and enable ISR's to start the modem transaction.
-    mcData.retryCount = 0;
-    mcData.msgTxRxFailed = false;
-    mcData.responseReady = false;
-    modemCmdIsrRestart();
-
     return true;
 }
 
+/**
+* \brief Drop the commands waiting in the queue.  The transaction 
+*        in progress (if any) runs to completion.
+* \ingroup PUBLIC_API
+*/
+void modemCmd_flushQueue(void) {
+    mcData.queueCount = 0;
+}
+
 /**
 * \brief Read the last response from the modem.  This represents 
 *        the data received as a result of the last completed
@@ -292,22 +424,9 @@ void modemCmd_read(modemCmdReadData_t *readDataP) {
     readDataP->modemCmdId = mcData.modemCmdId;
 }
 
-/**
-* \brief Return True if a modem response is available to read. 
-*        This means that a complete tx/rx transaction completed
-*        and the result is ready to read via the modemCmdRead
-*        API.
-* \ingroup PUBLIC_API
-* 
-* @return bool True if ready to read.
-*/
-bool modemCmd_isResponseReady(void) {
-    return mcData.responseReady;
-}
-
 /**
 * \brief Return true if a modem msg tx/rx transaction is in 
-*        process.
+*        process or queued.
 * \ingroup PUBLIC_API
 * 
 * @return bool True if busy.
@@ -339,10 +458,109 @@ uint8_t modemCmd_successiveErrors(void) {
     return mcData.statsSuccessiveCmdErrors;
 }
 
+/**
+* \brief Return the round trip time statistics of a command for 
+*        telemetry.
+* \ingroup PUBLIC_API
+* 
+* @param cmd The modem command
+* @param statsP Pointer to the object to fill in
+* 
+* @return bool True if the command has completed at least once 
+*         (statistics valid).
+*/
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+bool modemCmd_getRttStats(modem_command_t cmd, modemCmdRttStats_t *statsP) {
+    uint8_t i = modemCmdRttIndex(cmd);
+
+    memset(statsP, 0, sizeof(modemCmdRttStats_t));
+    if ((i >= MODEM_CMD_RTT_NUM_CMDS) || (mcData.rtt[i].max == 0)) {
+        return false;
+    }
+    statsP->min = mcData.rtt[i].min;
+    statsP->avg = mcData.rtt[i].avgX8 >> 3;
+    statsP->max = mcData.rtt[i].max;
+    return true;
+}
+#endif
+
 /*************************
  * Module Private Functions
  ************************/
 
+/**
+* \brief Helper function to prepare a command and start the
+*        tx/rx transaction.
+* 
+* @param writeCmdP Pointer to the cmd data to transmit.
+*/
+static void modemCmdStart(const modemCmdWriteData_t *writeCmdP) {
+    // For safety, disable UART interrupts
+    disable_UART_tx();
+    disable_UART_rx();
+
+    mcData.cmdP = writeCmdP;
+    modemCmdPrepare(writeCmdP);
+
+    // Init ISR parameters and enable ISR's to start the modem transaction.
+    mcData.retryCount = 0;
+    mcData.msgTxRxFailed = false;
+    modemCmdIsrRestart();
+}
+
+/**
+* \brief Helper function to build the command header to send to 
+*        the modem.
+* 
+* @param writeCmdP Pointer to the cmd data to transmit.
+*/
+static void modemCmdPrepare(const modemCmdWriteData_t *writeCmdP) {
+    switch (writeCmdP->cmd) {
+    case M_COMMAND_PING:
+        initForPingCmd();
+        break;
+#if (MODEM_TRANSMIT_SPREAD==1)
+    case M_COMMAND_MODEM_INFO:
+        initForModemInfoCmd();
+        break;
+#endif
+    case M_COMMAND_MODEM_STATUS:
+        initForModemStatusCmd();
+        break;
+    case M_COMMAND_MESSAGE_STATUS:
+        initForMsgStatusCmd();
+        break;
+    case M_COMMAND_SEND_DATA:
+        initForSendDataCmd(writeCmdP->payloadP, writeCmdP->payloadLength, writeCmdP->payloadMsgId);
+#if (DATA_MSG_MULTI_DAY==1)
+        // A payload that is read in segments
+        mcData.txPayloadFuncP = writeCmdP->payloadFuncP;
+        mcData.txSegment = 0;
+        if (mcData.txPayloadFuncP) {
+            mcData.txSegmentLength = mcData.txPayloadFuncP(0, &mcData.txPayloadP);
+        }
+#endif
+        break;
+    case M_COMMAND_SEND_DEBUG_DATA:
+        initForSendDebugDataCmd(writeCmdP->payloadP, writeCmdP->payloadLength, writeCmdP->payloadMsgId);
+        break;
+    case M_COMMAND_GET_INCOMING_PARTIAL:
+        initForIncommingPartialCmd(writeCmdP->payloadOffset, writeCmdP->payloadLength);
+        break;
+    case M_COMMAND_DELETE_INCOMING:
+        initForDeleteIncomingCmd();
+        break;
+    case M_COMMAND_POWER_OFF:
+        initForPowerOffCmd();
+        break;
+    default:
+        sysError();
+    }
+#if (MODEM_CMD_ISR_CRC==0)
+    mcData.txCrc = gen_crc16_2buf(mcData.txHeaderP, mcData.txHeaderLength, mcData.txPayloadP, mcData.txMsgPayloadLength);
+#endif
+}
+
 /**
 * \brief Helper function to setup parameters and enable UART 
 *        hardware interrupts to start a tx/rx transaction.
@@ -352,10 +570,20 @@ static void modemCmdIsrRestart(void) {
 
     disable_UART_rx();
     disable_UART_tx();
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    modemCmdSetTimeout();
+#endif
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    mcData.sendTimestamp = GET_FINE_TICK();
+#else
     mcData.sendTimestamp = GET_SYSTEM_TICK();
+#endif
     mcData.txIsrMsgComplete = false;
     mcData.txIsrDataIndex = 0;
     mcData.txIsrState = TX_ISR_STATE_SEND_START_BYTE;
+#if (MODEM_CMD_ISR_CRC==1)
+    mcData.txCrc = CRC16_INIT_VALUE;
+#endif
     mcData.rxIsrDataIndex = 0;
     mcData.rxIsrMsgComplete = false;
     // For all non-debug cases, there is an expected response from the
@@ -373,6 +601,107 @@ static void modemCmdIsrRestart(void) {
     enable_UART_tx();
 }
 
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+/**
+* \brief Find the round trip time statistics of a command.
+* 
+* @param cmd The modem command
+* 
+* @return uint8_t The index in rttCmdIds, or 
+*         MODEM_CMD_RTT_NUM_CMDS if the command has none.
+*/
+static uint8_t modemCmdRttIndex(modem_command_t cmd) {
+    uint8_t i;
+    for (i = 0; i < MODEM_CMD_RTT_NUM_CMDS; i++) {
+        if (rttCmdIds[i] == cmd) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+* \brief Add the round trip time of the current try to the 
+*        statistics of the command.  Called when the response
+*        validates.
+*/
+static void modemCmdRecordRtt(void) {
+    uint8_t i = modemCmdRttIndex(mcData.modemCmdId);
+    fine_tick_t elapsed;
+    uint8_t rtt;
+    rttData_t *rttP;
+
+    if (i >= MODEM_CMD_RTT_NUM_CMDS) {
+        return;
+    }
+    rttP = &mcData.rtt[i];
+
+    // Saturate at the unit range, and keep zero for "not measured"
+    elapsed = GET_ELAPSED_FINE_TICKS(mcData.sendTimestamp) >> MODEM_CMD_RTT_SHIFT;
+    rtt = (elapsed > 0xFF) ? 0xFF : (elapsed ? elapsed : 1);
+
+    if (rttP->max == 0) {
+        rttP->min = rtt;
+        rttP->max = rtt;
+        rttP->avgX8 = (uint16_t)rtt << 3;
+    } else {
+        if (rtt < rttP->min) {
+            rttP->min = rtt;
+        }
+        if (rtt > rttP->max) {
+            rttP->max = rtt;
+        }
+        // Average over about the last eight round trips
+        rttP->avgX8 = rttP->avgX8 - (rttP->avgX8 >> 3) + rtt;
+    }
+}
+
+/**
+* \brief Set the timeout of the try being started.  Twice the 
+*        longest round trip of the command plus a margin, doubled
+*        for each retry.  The fixed MODEM_TX_RX_TIMEOUT_IN_SEC if
+*        the command has no round trip yet, or as the upper limit.
+*/
+static void modemCmdSetTimeout(void) {
+    uint8_t i = modemCmdRttIndex(mcData.modemCmdId);
+    uint32_t timeout = MODEM_TX_RX_TIMEOUT_IN_SEC << FINE_TICK_SHIFT;
+    uint32_t adaptive;
+
+    if ((i < MODEM_CMD_RTT_NUM_CMDS) && mcData.rtt[i].max) {
+        adaptive = ((uint32_t)mcData.rtt[i].max << (MODEM_CMD_RTT_SHIFT + 1)) + MODEM_RTT_TIMEOUT_MARGIN;
+        adaptive += ((uint32_t)mcData.txMsgPayloadLength << FINE_TICK_SHIFT) / MODEM_UART_BYTES_PER_SEC;
+        adaptive <<= mcData.retryCount;
+        if (adaptive < timeout) {
+            timeout = adaptive;
+        }
+    }
+    mcData.timeoutInFineTicks = timeout;
+}
+#endif
+
+/**
+* \brief Helper function to finish a command.  Passes the 
+*        response to the response function and starts the next
+*        queued command, or puts the module in a quiescent state
+*        if none.
+*/
+static void modemCmdDone(void) {
+    const modemCmdWriteData_t *nextCmdP;
+
+    if (mcData.responseFuncP) {
+        mcData.responseFuncP();
+    }
+
+    if (mcData.queueCount) {
+        nextCmdP = mcData.queue[0];
+        mcData.queueCount--;
+        memmove(&mcData.queue[0], &mcData.queue[1], mcData.queueCount * sizeof(mcData.queue[0]));
+        modemCmdStart(nextCmdP);
+    } else {
+        modemCmdCleanup();
+    }
+}
+
 /**
 * \brief Helper function to put the UART hardware and module in 
 *        a quiescent state.
@@ -424,21 +753,22 @@ static bool modemCmdProcessRxMsg(void) {
 
     if (!errorOccured) {
         // Perform CRC check on the message.
-        volatile uint16_t calculatedCrc = 0;
-        volatile uint16_t rxCrc = ~0;
-
-        // The CRC of the response does not include the start byte, the crc[2] and the end byte
-        uint8_t rxCrcNumBytes = totalRxBytes - 4;
+        uint16_t rxCrc;
 
         // Grab the CRC in the response
         rxCrc = mcData.rxBufP[totalRxBytes - 3];  // get MSB
         rxCrc <<= 8;
         rxCrc |= mcData.rxBufP[totalRxBytes - 2]; // get LSB
 
-        // Calculate CRC of message
-        calculatedCrc = gen_crc16(&mcData.rxBufP[1], rxCrcNumBytes);
+        // The CRC of the response does not include the start byte,
+        // the crc[2] and the end byte.
         // compare calculated against received
-        if (rxCrc != calculatedCrc) {
+#if (MODEM_CMD_ISR_CRC==1)
+        // The rx ISR computed the CRC of the message as it arrived.
+        if (rxCrc != CRC16_FINAL(mcData.rxCrc)) {
+#else
+        if (rxCrc != gen_crc16(&mcData.rxBufP[1], totalRxBytes - 4)) {
+#endif
             errorOccured = true;
         }
     }
@@ -454,12 +784,26 @@ static bool modemCmdProcessRxMsg(void) {
 static void initForPingCmd(void) {
     mcData.modemCmdId = M_COMMAND_PING;
     mcData.txHeaderP[0] = M_COMMAND_PING;        // command Byte
-    mcData.crc = ((uint16_t)0x0);               // precalculated crc
     mcData.txHeaderLength = 1;
-    mcData.txMsgContainsAPayload = false;
+    mcData.txMsgPayloadLength = 0;
     mcData.expectedResponseLength = 5;                  // start,cmd,crc[2],end
 }
 
+#if (MODEM_TRANSMIT_SPREAD==1)
+/**
+* \brief Fill header with a modem info message.
+* \brief Helper function to initialize the tx msg header with a
+*        modem info command (software version and IMEI).
+*/
+static void initForModemInfoCmd(void) {
+    mcData.modemCmdId = M_COMMAND_MODEM_INFO;
+    mcData.txHeaderP[0] = M_COMMAND_MODEM_INFO;       // command byte
+    mcData.txHeaderLength = 1;
+    mcData.txMsgPayloadLength = 0;
+    mcData.expectedResponseLength = 15; // start,cmd,major,minor,imei[8],crc[2],end
+}
+#endif
+
 /**
 * \brief Fill header with a power off modem message.
 * \brief Help function to initialize the buffer with a stop 
@@ -468,9 +812,8 @@ static void initForPingCmd(void) {
 static void initForPowerOffCmd(void) {
     mcData.modemCmdId = M_COMMAND_POWER_OFF;
     mcData.txHeaderP[0] = M_COMMAND_POWER_OFF;   // command Byte
-    mcData.crc = ((uint16_t)0x8801);            // precalculated crc
     mcData.txHeaderLength = 1;
-    mcData.txMsgContainsAPayload = false;
+    mcData.txMsgPayloadLength = 0;
     mcData.expectedResponseLength = 5;                  // start,cmd,crc[2],end
 }
 
@@ -480,7 +823,8 @@ static void initForPowerOffCmd(void) {
 *        command and enable uart tx interrupt. 
 * 
 * @param payloadP Data Pointer to data buffer to send to modem
-* @param payloadSize Size of data in bytes to send
+* @param payloadSize Size of data in bytes to send (all the 
+*                    segments)
 * @param payloadMsgId The Outpour message ID
 */
 static void initForSendDataCmd(uint8_t *payloadP, uint16_t payloadSize, uint8_t payloadMsgId) {
@@ -502,12 +846,11 @@ static void initForSendDataCmd(uint8_t *payloadP, uint16_t payloadSize, uint8_t
     mcData.txHeaderP[5] = 0x01;                       // Payload start byte
     mcData.txHeaderP[6] = payloadMsgId;               // Payload message type
     mcData.txHeaderLength = 7;
-    if (payloadSize > 0) {
-        mcData.txMsgContainsAPayload = true;
-        mcData.txMsgPayloadLength = payloadSize;
-        mcData.txPayloadP = payloadP;
-    }
-    mcData.crc = gen_crc16_2buf((uint8_t *)&(mcData.txHeaderP[0]), mcData.txHeaderLength, payloadP, payloadSize);
+    mcData.txMsgPayloadLength = payloadSize;
+    mcData.txPayloadP = payloadP;
+#if (DATA_MSG_MULTI_DAY==1)
+    mcData.txSegmentLength = payloadSize;
+#endif
     mcData.expectedResponseLength = 5;                        // start,cmd,crc[2],end
 }
 
@@ -534,11 +877,12 @@ static void initForSendDebugDataCmd(uint8_t *payloadP, uint16_t payloadSize, uin
     mcData.txHeaderP[5] = 0x01;                       // Payload start byte
     mcData.txHeaderP[6] = payloadMsgId;               // Payload message type
     mcData.txHeaderLength = 7;
-    if (payloadSize > 0) {
-        mcData.txMsgContainsAPayload = true;
-        mcData.txMsgPayloadLength = payloadSize;
-        mcData.txPayloadP = payloadP;
-    }
+    mcData.txMsgPayloadLength = payloadSize;
+    mcData.txPayloadP = payloadP;
+#if (DATA_MSG_MULTI_DAY==1)
+    mcData.txSegmentLength = payloadSize;
+    mcData.txPayloadFuncP = NULL;
+#endif
     // No response expected for debug data
     mcData.expectedResponseLength = 0;
 }
@@ -551,9 +895,8 @@ static void initForSendDebugDataCmd(uint8_t *payloadP, uint16_t payloadSize, uin
 static void initForModemStatusCmd(void) {
     mcData.modemCmdId = M_COMMAND_MODEM_STATUS;
     mcData.txHeaderP[0] = M_COMMAND_MODEM_STATUS;     // command byte
-    mcData.crc = ((uint16_t)0xc181);                 // precalculated crc
     mcData.txHeaderLength = 1;
-    mcData.txMsgContainsAPayload = false;
+    mcData.txMsgPayloadLength = 0;
     mcData.expectedResponseLength = 15; // start,cmd,status[10],crc[2],end
 }
 
@@ -565,9 +908,8 @@ static void initForModemStatusCmd(void) {
 static void initForMsgStatusCmd(void) {
     mcData.modemCmdId = M_COMMAND_MESSAGE_STATUS;
     mcData.txHeaderP[0] = M_COMMAND_MESSAGE_STATUS;   // command Byte
-    mcData.crc = ((uint16_t)0x0140);                 // pre-calculated crc
     mcData.txHeaderLength = 1;
-    mcData.txMsgContainsAPayload = false;
+    mcData.txMsgPayloadLength = 0;
     mcData.expectedResponseLength = 23; // start,cmd,status[18],crc[2],end
 }
 
@@ -591,9 +933,9 @@ static void initForIncommingPartialCmd(uint16_t offsetInBytes, uint16_t sizeInBy
     mcData.txHeaderP[7] = (sizeInBytes >> 8) & 0xff;   // size bits 8-15
     mcData.txHeaderP[8] = sizeInBytes & 0xff;          // size bits 0-7
     mcData.txHeaderLength = 9;
-    mcData.txMsgContainsAPayload = false;
-    mcData.crc = gen_crc16(&(mcData.txHeaderP[0]), mcData.txHeaderLength);
-    mcData.expectedResponseLength = 13 + sizeInBytes;          // start,cmd,len[4],remaining[4],payload[sizeInBytes],crc[2],end
+    mcData.txMsgPayloadLength = 0;
+    // The most expected - the rx ISR shortens it to the length returned
+    mcData.expectedResponseLength = MODEM_PARTIAL_RESP_OVERHEAD + sizeInBytes;
 }
 
 /**
@@ -604,9 +946,8 @@ static void initForIncommingPartialCmd(uint16_t offsetInBytes, uint16_t sizeInBy
 static void initForDeleteIncomingCmd(void) {
     mcData.modemCmdId = M_COMMAND_DELETE_INCOMING;
     mcData.txHeaderP[0] = M_COMMAND_DELETE_INCOMING; // command byte
-    mcData.crc = 0xf141;                             // precalculated crc
     mcData.txHeaderLength = 1;
-    mcData.txMsgContainsAPayload = false;
+    mcData.txMsgPayloadLength = 0;
     mcData.expectedResponseLength = 5;                       // start,cmd,crc[2],end
 }
 
@@ -636,7 +977,11 @@ static inline void disable_UART_rx(void) {
  ****************************/
 
 /**
-* \brief Uart Transmit Interrupt Service Routine.
+* \brief Uart Transmit Interrupt Service Routine.  With 
+*        MODEM_CMD_ISR_CRC, the CRC of the header and payload is
+*        computed one byte at a time as the bytes are loaded into
+*        the UART, so no pass over the message is needed before
+*        the transmit starts.
 * \ingroup ISR
 */
 #ifndef FOR_USE_WITH_BOOTLOADER
@@ -652,10 +997,15 @@ __interrupt void USCI0TX_ISR(void) {
         break;
 
     case TX_ISR_STATE_HEADER:
+#if (MODEM_CMD_ISR_CRC==1)
+        UCA0TXBUF = mcData.txHeaderP[mcData.txIsrDataIndex];
+        mcData.txCrc = gen_crc16_byte(mcData.txCrc, mcData.txHeaderP[mcData.txIsrDataIndex++]);
+#else
         UCA0TXBUF = mcData.txHeaderP[mcData.txIsrDataIndex++];
+#endif
         if (mcData.txIsrDataIndex == mcData.txHeaderLength) {
             mcData.txIsrDataIndex = 0;
-            if (mcData.txMsgContainsAPayload && mcData.txMsgPayloadLength) {
+            if (mcData.txMsgPayloadLength) {
                 mcData.txIsrState = TX_ISR_STATE_PAYLOAD;
             } else {
                 mcData.txIsrState = TX_ISR_STATE_CRC_BYTE_0;
@@ -664,19 +1014,41 @@ __interrupt void USCI0TX_ISR(void) {
         break;
 
     case TX_ISR_STATE_PAYLOAD:
+#if (MODEM_CMD_ISR_CRC==1)
+        UCA0TXBUF = mcData.txPayloadP[mcData.txIsrDataIndex];
+        mcData.txCrc = gen_crc16_byte(mcData.txCrc, mcData.txPayloadP[mcData.txIsrDataIndex++]);
+#else
         UCA0TXBUF = mcData.txPayloadP[mcData.txIsrDataIndex++];
+#endif
+#if (DATA_MSG_MULTI_DAY==1)
+        if (mcData.txIsrDataIndex >= mcData.txSegmentLength) {
+            // Get the next segment of a payload that is not in one buffer
+            mcData.txSegmentLength = 0;
+            if (mcData.txPayloadFuncP) {
+                mcData.txSegmentLength = mcData.txPayloadFuncP(++mcData.txSegment, &mcData.txPayloadP);
+                mcData.txIsrDataIndex = 0;
+            }
+            if (!mcData.txSegmentLength) {
+                mcData.txIsrState = TX_ISR_STATE_CRC_BYTE_0;
+            }
+        }
+#else
         if (mcData.txIsrDataIndex >= mcData.txMsgPayloadLength) {
             mcData.txIsrState = TX_ISR_STATE_CRC_BYTE_0;
         }
+#endif
         break;
 
     case TX_ISR_STATE_CRC_BYTE_0:
-        UCA0TXBUF = ((mcData.crc >> 8) & 0xff);
+#if (MODEM_CMD_ISR_CRC==1)
+        mcData.txCrc = CRC16_FINAL(mcData.txCrc);
+#endif
+        UCA0TXBUF = ((mcData.txCrc >> 8) & 0xff);
         mcData.txIsrState = TX_ISR_STATE_CRC_BYTE_1;
         break;
 
     case TX_ISR_STATE_CRC_BYTE_1:
-        UCA0TXBUF = mcData.crc & 0xff;
+        UCA0TXBUF = mcData.txCrc & 0xff;
         mcData.txIsrState = TX_ISR_STATE_SEND_STOP_BYTE;
         break;
 
@@ -689,12 +1061,20 @@ __interrupt void USCI0TX_ISR(void) {
     case TX_ISR_STATE_DISABLE:
         disable_UART_tx();
         mcData.txIsrMsgComplete = true;
+        // Wake up the main loop to finish a command without response
+        if (mcData.rxIsrMsgComplete) {
+            __bic_SR_register_on_exit(LPM3_bits);
+        }
         break;
     }
 }
 
 /**
-* \brief Uart Receive Interrupt Service Routine.
+* \brief Uart Receive Interrupt Service Routine.  With 
+*        MODEM_CMD_ISR_CRC, the CRC of the response is computed one
+*        byte at a time as the bytes arrive.  It has its own running
+*        crc: a stray start byte (a late response of an earlier try)
+*        may arrive while the tx isr is still sending.
 * \ingroup ISR
 */
 #ifndef FOR_USE_WITH_BOOTLOADER
@@ -709,8 +1089,28 @@ __interrupt void USCI0RX_ISR(void) {
         // Just return if we are expecting a response start byte and its not one.
         return;
     } else if (mcData.rxIsrDataIndex < ISR_BUF_SIZE) {
+#if (MODEM_CMD_ISR_CRC==1)
+        // The CRC covers the bytes after the start byte up to the crc[2]
+        if (mcData.rxIsrDataIndex == 0) {
+            mcData.rxCrc = CRC16_INIT_VALUE;
+        } else if (mcData.rxIsrDataIndex < (mcData.expectedResponseLength - 3)) {
+            mcData.rxCrc = gen_crc16_byte(mcData.rxCrc, rxByte);
+        }
+#endif
         // Read the data as long as there is room in the rx buffer
         mcData.rxBufP[mcData.rxIsrDataIndex++] = rxByte;
+        // A partial read returns at most the size requested.  Once
+        // the length field (bytes 2-5, MSB first) is in, expect only
+        // the bytes returned.  The expected length of a partial read
+        // is the overhead plus the size requested (see
+        // initForIncommingPartialCmd).
+        if ((mcData.rxIsrDataIndex == 6) && (mcData.modemCmdId == M_COMMAND_GET_INCOMING_PARTIAL)) {
+            uint8_t *lengthP = &mcData.rxBufP[2];
+            if (!(lengthP[0] | lengthP[1] | lengthP[2]) &&
+                (lengthP[3] < (uint8_t)(mcData.expectedResponseLength - MODEM_PARTIAL_RESP_OVERHEAD))) {
+                mcData.expectedResponseLength = MODEM_PARTIAL_RESP_OVERHEAD + lengthP[3];
+            }
+        }
     } else {
         // Trouble - we went beyond the buffer length
         done = true;
@@ -724,6 +1124,8 @@ __interrupt void USCI0RX_ISR(void) {
     if (done) {
         disable_UART_rx();
         mcData.rxIsrMsgComplete = true;
+        // Wake up the main loop to finish the command (modemCmd_exec)
+        __bic_SR_register_on_exit(LPM3_bits);
     }
 }
 
@@ -5,6 +5,14 @@
  * 
  * \brief modem module responsible for bringing up the modem and 
  *        shutting it down.
+ *
+ * \note Power up (MODEM_LINK_FAST_POWER_UP).  The supplies are
+ *       switched on and GSM_EN is raised in the first second,
+ *       with short timer A1 sleeps between the steps, instead of
+ *       one step per second.  The modem is up as soon as it
+ *       raises GSM_STATUS.  The fixed times (GSM_EN pulse and init
+ *       wait) are kept as the upper bound for a modem that does
+ *       not drive GSM_STATUS.
  */
 
 #include "outpour.h"
@@ -13,6 +21,29 @@
  * Module Data Definitions
  **************************/
 
+#if (MODEM_LINK_FAST_POWER_UP==1)
+/**
+ * \def MODEM_SUPPLY_SETTLE_FINE_TICKS
+ * \brief Time between the supply power up steps (GSM_DCDC, LS_VCC
+ *        and GSM_EN).  100 ms in 1/1024 second fine ticks.
+ */
+#define MODEM_SUPPLY_SETTLE_FINE_TICKS ((uint16_t)102)
+
+/**
+ * \def MODEM_GSM_EN_MAX_SECONDS
+ * \brief Longest time GSM_EN is held high when the modem does not
+ *        raise GSM_STATUS.
+ */
+#define MODEM_GSM_EN_MAX_SECONDS ((uint8_t)6*TIME_SCALER)
+
+/**
+ * \def MODEM_INIT_WAIT_MAX_SECONDS
+ * \brief Longest time to wait after GSM_EN goes low before the
+ *        modem is considered up when it does not raise GSM_STATUS.
+ */
+#define MODEM_INIT_WAIT_MAX_SECONDS ((uint8_t)5*TIME_SCALER)
+#endif
+
 /**
  * \typedef modemPowerOnSeqState_t
  * \brief Define the different states to power on the modem.
@@ -37,6 +68,10 @@ typedef struct modemLinkData_s {
     bool modemUp;
     sys_tick_t startTimestamp;
     modemPowerOnSeqState_t powerOnHwSeqState;
+#if (MODEM_LINK_FAST_POWER_UP==1)
+    uint8_t gsmEnOnTime;      /**< Seconds from start when GSM_EN was raised */
+    bool statusPinValid;      /**< GSM_STATUS was low before power up */
+#endif
 } modemLinkData_t;
 
 /****************************
@@ -51,6 +86,9 @@ modemLinkData_t mlData;
  *********************/
 
 static bool modemPowerUpStateMachine(void);
+#if (MODEM_LINK_FAST_POWER_UP==1)
+static bool modemLinkIsStatusUp(void);
+#endif
 
 /***************************
  * Module Public Functions
@@ -86,6 +124,13 @@ void modemLink_restart(void) {
     mlData.active = true;
     mlData.modemUp = false;
     mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_ALL_OFF;
+#if (MODEM_LINK_FAST_POWER_UP==1)
+    // The one second off time is only needed to power cycle a modem
+    // that is on.
+    if (!(P1OUT & (GSM_DCDC + LS_VCC))) {
+        mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_DCDC;
+    }
+#endif
     mlData.startTimestamp = GET_SYSTEM_TICK();
     modemPowerUpStateMachine();
 }
@@ -102,6 +147,18 @@ bool modemLink_isModemUp(void) {
     return mlData.modemUp;
 }
 
+#if (MODEM_KEEP_WARM==1)
+/**
+* \brief Restart the modem up time (modemLink_getModemUpTimeInSecs)
+*        of a modem that is already up, when a new session reuses
+*        it.
+* \ingroup PUBLIC_API
+*/
+void modemLink_resetUpTime(void) {
+    mlData.startTimestamp = GET_SYSTEM_TICK();
+}
+#endif
+
 uint16_t modemLink_getModemUpTimeInSecs(void) {
     sys_tick_t onTime = GET_ELAPSED_TIME_IN_SEC(mlData.startTimestamp);
     uint16_t onTime16 = onTime;
@@ -115,57 +172,110 @@ uint16_t modemLink_getModemUpTimeInSecs(void) {
 /**
 * \brief State machine to sequence through the modem power on 
 *        hardware steps. This is a timebased sequence to control
-*        the hardware power on.
+*        the hardware power on.  With MODEM_LINK_FAST_POWER_UP,
+*        the supply steps run back to back in one call and
+*        GSM_STATUS ends the GSM_EN pulse and the init wait.
 */
 static bool modemPowerUpStateMachine(void) {
     // Continue processing is used to determine whether
     // the do-while state processing loop should continue
     // for another iteration.
-    bool continue_processing = false;
+    bool continue_processing;
     volatile sys_tick_t onTime = GET_ELAPSED_TIME_IN_SEC(mlData.startTimestamp);
-    switch (mlData.powerOnHwSeqState) {
-    case MODEM_POWERUP_STATE_IDLE:
-        break;
-    case MODEM_POWERUP_STATE_ALL_OFF:
-        P1OUT &= ~GSM_DCDC;
-        P1OUT &= ~LS_VCC;
-        if (onTime >= (1 * TIME_SCALER)) {
-            mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_DCDC;
-        }
-        break;
-    case MODEM_POWERUP_STATE_DCDC:
-        if (onTime >= (2 * TIME_SCALER)) {
+    do {
+        continue_processing = false;
+        switch (mlData.powerOnHwSeqState) {
+        case MODEM_POWERUP_STATE_IDLE:
+            break;
+        case MODEM_POWERUP_STATE_ALL_OFF:
+            P1OUT &= ~GSM_DCDC;
+            P1OUT &= ~LS_VCC;
+            if (onTime >= (1 * TIME_SCALER)) {
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_DCDC;
+#if (MODEM_LINK_FAST_POWER_UP==1)
+                continue_processing = true;
+#endif
+            }
+            break;
+#if (MODEM_LINK_FAST_POWER_UP==1)
+        case MODEM_POWERUP_STATE_DCDC:
+            // A modem without power can't drive GSM_STATUS high.  If it
+            // reads high, the pin is not used for this power up.
+            mlData.statusPinValid = (P1IN & GSM_STATUS) ? false : true;
             P1OUT |= GSM_DCDC;
-            mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_LSVCC;
-        }
-        break;
-    case MODEM_POWERUP_STATE_LSVCC:
-        if (onTime >= (3 * TIME_SCALER)) {
+            timerA1_sleepFineTicks(MODEM_SUPPLY_SETTLE_FINE_TICKS);
             P1OUT |= LS_VCC;
-            mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_GSM_HIGH;
-        }
-        break;
-    case MODEM_POWERUP_STATE_GSM_HIGH:
-        if (onTime >= (4 * TIME_SCALER)) {
+            timerA1_sleepFineTicks(MODEM_SUPPLY_SETTLE_FINE_TICKS);
             P1OUT |= GSM_EN;
+            mlData.gsmEnOnTime = onTime;
             mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_GSM_LOW;
+            break;
+        case MODEM_POWERUP_STATE_LSVCC:
+        case MODEM_POWERUP_STATE_GSM_HIGH:
+            break;
+        case MODEM_POWERUP_STATE_GSM_LOW:
+            if (modemLinkIsStatusUp() ||
+                (onTime >= (mlData.gsmEnOnTime + MODEM_GSM_EN_MAX_SECONDS))) {
+                P1OUT &= ~GSM_EN;
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_INIT_WAIT;
+                continue_processing = true;
+            }
+            break;
+        case MODEM_POWERUP_STATE_INIT_WAIT:
+            if (modemLinkIsStatusUp() ||
+                (onTime >= (mlData.gsmEnOnTime + MODEM_GSM_EN_MAX_SECONDS + MODEM_INIT_WAIT_MAX_SECONDS))) {
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_READY;
+                mlData.modemUp = true;
+            }
+            break;
+#else
+        case MODEM_POWERUP_STATE_DCDC:
+            if (onTime >= (2 * TIME_SCALER)) {
+                P1OUT |= GSM_DCDC;
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_LSVCC;
+            }
+            break;
+        case MODEM_POWERUP_STATE_LSVCC:
+            if (onTime >= (3 * TIME_SCALER)) {
+                P1OUT |= LS_VCC;
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_GSM_HIGH;
+            }
+            break;
+        case MODEM_POWERUP_STATE_GSM_HIGH:
+            if (onTime >= (4 * TIME_SCALER)) {
+                P1OUT |= GSM_EN;
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_GSM_LOW;
+            }
+            break;
+        case MODEM_POWERUP_STATE_GSM_LOW:
+            if (onTime >= (10 * TIME_SCALER)) {
+                P1OUT &= ~GSM_EN;
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_INIT_WAIT;
+            }
+            break;
+        case MODEM_POWERUP_STATE_INIT_WAIT:
+            if (onTime >= (15 * TIME_SCALER)) {
+                mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_READY;
+                mlData.modemUp = true;
+            }
+            break;
+#endif
+        case MODEM_POWERUP_STATE_READY:
+            break;
         }
-        break;
-    case MODEM_POWERUP_STATE_GSM_LOW:
-        if (onTime >= (10 * TIME_SCALER)) {
-            P1OUT &= ~GSM_EN;
-            mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_INIT_WAIT;
-        }
-        break;
-    case MODEM_POWERUP_STATE_INIT_WAIT:
-        if (onTime >= (15 * TIME_SCALER)) {
-            mlData.powerOnHwSeqState = MODEM_POWERUP_STATE_READY;
-            mlData.modemUp = true;
-        }
-        break;
-    case MODEM_POWERUP_STATE_READY:
-        break;
-    }
+    } while (continue_processing);
     return continue_processing;
 }
 
+#if (MODEM_LINK_FAST_POWER_UP==1)
+/**
+* \brief Check the GSM_STATUS pin.  The modem drives it high once
+*        it is powered on.
+*
+* @return bool True if the pin is used and high
+*/
+static bool modemLinkIsStatusUp(void) {
+    return (mlData.statusPinValid && (P1IN & GSM_STATUS)) ? true : false;
+}
+#endif
+
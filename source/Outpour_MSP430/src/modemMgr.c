@@ -21,10 +21,10 @@
  *
  * This total set of commands is referred to as a modem write
  * batch job.  This composes the fundamental framework used to
- * communicate with the modem for the upper layers. A batch job
- * runs a state machine that cycles though several states to
- * send the individual commands to the modem and wait for
- * responses.
+ * communicate with the modem for the upper layers. The commands
+ * of a batch job are queued in modemCmd, which sends each one as
+ * soon as the previous response is in and passes the responses
+ * to modemMgr_processCmdResponse.
  * 
  * The upper layers use the single API modemMgr_sendModemCmdBatch
  * to send the modem command they are interested in.  The batch
@@ -34,6 +34,53 @@
  * are parsed for key information such as Network Connection
  * Status and Number of pending OTA messages.
  *
+ * The batch profile of the command (modemBatchProfile_t) selects
+ * a lean job when the full sequence is not needed: a status only
+ * job sends the two status commands.  With MODEM_LEAN_BATCH, a
+ * data only job sends the command alone and only adds the status
+ * commands when the last status is stale (older than
+ * MODEM_STATUS_MAX_AGE_IN_SECONDS), and a command only job sends
+ * the command alone.  The client refreshes a stale status before
+ * it relies on it (modemMgr_isStatusStale).
+ *
+ * \note Energy budget (MODEM_ENERGY_BUDGET):  The modem is by 
+ *       far the largest battery load.  modemMgr_exec counts the seconds the modem is
+ *       powered per session and per rolling day (a leaky bucket
+ *       that drains one 24th of the day budget every hour).  The
+ *       budgets are configured OTA (modemMgr_setBudgetConfig).
+ *       The data message state machine cuts a session at the
+ *       session budget and the data message manager defers the
+ *       backlog and check-in sessions while the day budget is
+ *       used up.
+ *
+ * \note Keep warm (MODEM_KEEP_WARM):  Powering up the modem and 
+ *       registering on the network costs more than a short idle
+ *       time.  If a hold time is configured (with the budget),
+ *       modemMgr_release leaves a registered modem on for that
+ *       long.  A grab in that time reuses the modem without a
+ *       power up.  The hold counts toward the rolling day budget.
+ *       It only saves modem on time if the next session starts
+ *       within about half a minute (see the host readme).
+ *
+ * \note Coverage profile (MODEM_COVERAGE_RETRY):  The time the 
+ *       link took to come up is kept as a rolling average per hour
+ *       of the day.  A session that did not get a link counts as
+ *       the worst link time.  The data message manager schedules
+ *       its retries toward the hours that connected fastest
+ *       (modemMgr_getCoverageRetryDelay).
+ *
+ * \note Transmit offset (MODEM_TRANSMIT_SPREAD):  All units
+ *       start their scheduled transmissions at the same storage
+ *       time, and the storage day of a region starts at the same
+ *       local time.  Each unit delays them by its own offset in a
+ *       spread window (modemMgr_getTransmitOffset), so that a fleet
+ *       does not load the cell and the backend all at once.  The
+ *       offset follows from the modem IMEI, read once with
+ *       M_COMMAND_MODEM_INFO in the first full batch job after a
+ *       reset.  Until then it follows from the factory calibration
+ *       of the chip (INFO A), which differs from chip to chip but
+ *       is not unique.
+ *
  */
 
 /***************************
@@ -43,22 +90,74 @@
 #include "outpour.h"
 
 /**
- * \typedef mwBatchState_t
- * \brief Define the states that make up the modem write batch 
- *        job states.
+ * \def MODEM_STATUS_MAX_AGE_IN_SECONDS
+ * \brief The link status and the number of OTA messages are 
+ *        stale when the last message status is older than this.
+ *        A data only batch job then also sends the status
+ *        commands, so that a link lost during a long session is
+ *        noticed.
+ */
+#if (MODEM_LEAN_BATCH==1)
+#define MODEM_STATUS_MAX_AGE_IN_SECONDS ((sys_tick_t)10)
+#endif
+
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+ * \def MODEM_SESSION_BUDGET_DEFAULT_MINUTES
+ * \brief Default modem on time budget of a session.  Must be 
+ *        longer than the wait for the network link (10 minutes).
+ */
+#define MODEM_SESSION_BUDGET_DEFAULT_MINUTES ((uint8_t)15)
+
+/**
+ * \def MODEM_DAY_BUDGET_DEFAULT_MINUTES
+ * \brief Default modem on time budget of a rolling day.  Allows 
+ *        a session without network and its retry.
+ */
+#define MODEM_DAY_BUDGET_DEFAULT_MINUTES ((uint8_t)30)
+
+/**
+ * \def MODEM_BUDGET_DRAIN_PERIOD_IN_SECONDS
+ * \brief The rolling day budget is drained by one 24th every 
+ *        hour.
+ */
+#define MODEM_BUDGET_DRAIN_PERIOD_IN_SECONDS ((uint16_t)60*60)
+
+/**
+ * \def MODEM_BUDGET_MAX_SECONDS
+ * \brief The modem on time counters saturate.
+ */
+#define MODEM_BUDGET_MAX_SECONDS ((uint16_t)0xFFFF)
+#endif
+
+#if (MODEM_COVERAGE_RETRY==1)
+/**
+ * \def MODEM_COVERAGE_UNIT_SECONDS
+ * \brief The link time of the coverage profile is kept in units 
+ *        of 4 seconds (the 10 minute link wait is 150).
+ */
+#define MODEM_COVERAGE_UNIT_SECONDS ((uint8_t)4)
+
+/**
+ * \def MODEM_COVERAGE_NO_LINK
+ * \brief The link time sample of a session without a link.
  */
-typedef enum mwBatchState_e {
-    MWBATCH_STATE_IDLE,
-    MWBATCH_STATE_PING,
-    MWBATCH_STATE_PING_WAIT,
-    MWBATCH_STATE_WRITE_CMD,
-    MWBATCH_STATE_WRITE_CMD_WAIT,
-    MWBATCH_STATE_MODEM_STATUS,
-    MWBATCH_STATE_MODEM_STATUS_WAIT,
-    MWBATCH_STATE_MSG_STATUS,
-    MWBATCH_STATE_MSG_STATUS_WAIT,
-    MWBATCH_STATE_DONE,
-}mwBatchState_t;
+#define MODEM_COVERAGE_NO_LINK ((uint8_t)0xFF)
+
+/**
+ * \def MODEM_COVERAGE_UNKNOWN
+ * \brief The link time of an hour without a session yet (about 4
+ *        minutes).  A known good hour is preferred, a known bad
+ *        one is avoided.
+ */
+#define MODEM_COVERAGE_UNKNOWN ((uint8_t)64)
+
+/**
+ * \def MODEM_LINK_SECS_NONE
+ * \brief The link time of a session that has no link (yet).
+ */
+#define MODEM_LINK_SECS_NONE ((uint16_t)0xFFFF)
+#endif
 
 /**
  * \typedef mwBatchData_t
@@ -69,13 +168,45 @@ typedef struct mwBatchData_s {
     bool allocated;                 /**< flag to indicate modem is owned by client */
     bool active;                    /**< currently sending out a write batch job */
     bool commError;                 /**< A modem UART comm error occurred during the job */
+    uint8_t cmdsPending;            /**< commands of the job without a response yet */
+#if (MODEM_KEEP_WARM==1)
+    uint8_t warmSecsLeft;           /**< seconds the released modem is still kept on */
+#endif
+#if (MODEM_LEAN_BATCH==1)
+    sys_tick_t statusTimestamp;     /**< time of the last message status response */
+#endif
     uint8_t modemLinkUpStatus;      /**< network connection status received from modem */
-    mwBatchState_t mwBatchState;    /**< current batch job state */
-    modemCmdWriteData_t *cmdWriteP; /**< A pointer to the command info object */
     otaResponse_t otaResponse;      /**< payload of the last ota message received */
     uint8_t numOfOtaMsgsAvailable;  /**< parsed from modem message status command */
+#if (MODEM_COVERAGE_RETRY==1)
+    uint8_t rssi;                   /**< RSSI (in -dBm) of the last modem status, 0 for none */
+    uint8_t signalStrength;         /**< signal strength (in percent) of the last modem status */
+    uint16_t linkSecs;              /**< modem up time when the link came up in the session */
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+    bool unitSeedValid;             /**< the modem info was read since the reset */
+    uint16_t unitSeed;              /**< CRC16 of the modem IMEI (INFO A before), sets the transmit offset */
+#endif
 } mwBatchData_t;
 
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+ * \typedef modemBudgetData_t
+ * \brief Define a container to hold the modem energy budget 
+ *        data.
+ */
+typedef struct modemBudgetData_s {
+    uint16_t sessionOnSecs;         /**< modem on seconds of the current session */
+    uint16_t lastSessionOnSecs;     /**< modem on seconds of the last session */
+    uint16_t dayOnSecs;             /**< modem on seconds of the rolling day */
+    uint8_t sessionMinutes;         /**< session budget */
+    uint8_t dayMinutes;             /**< rolling day budget */
+#if (MODEM_KEEP_WARM==1)
+    uint8_t keepWarmSecs;           /**< modem hold time after release, 0 for none */
+#endif
+} modemBudgetData_t;
+#endif
+
 /****************************
  * Module Data Declarations
  ***************************/
@@ -100,10 +231,53 @@ uint8_t otaBuf[OTA_PAYLOAD_BUF_LENGTH];  /**< A buffer to hold one OTA message *
 // static
 mwBatchData_t mwBatchData;
 
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+ * \var budgetData
+ * \brief Declare the container to hold the modem energy budget 
+ *        data.
+ */
+// static
+modemBudgetData_t budgetData;
+#endif
+
+#if (MODEM_COVERAGE_RETRY==1)
+/**
+ * \var coverageLinkTime
+ * \brief Declare the coverage profile: the rolling average link 
+ *        time (MODEM_COVERAGE_UNIT_SECONDS units), indexed by the
+ *        hour of the day.
+ */
+// static
+uint8_t coverageLinkTime[24];
+#endif
+
+/**
+ * \var pingCmdWrite
+ * \brief The support commands of a batch job (constant, they are 
+ *        queued by reference).
+ */
+static const modemCmdWriteData_t pingCmdWrite = { M_COMMAND_PING };
+#if (MODEM_TRANSMIT_SPREAD==1)
+static const modemCmdWriteData_t modemInfoCmdWrite = { M_COMMAND_MODEM_INFO };
+#endif
+static const modemCmdWriteData_t modemStatusCmdWrite = { M_COMMAND_MODEM_STATUS };
+static const modemCmdWriteData_t msgStatusCmdWrite = { M_COMMAND_MESSAGE_STATUS };
+
 /*************************
  * Module Prototypes
  ************************/
-static void modemMgr_stateMachine(void);
+static void modemMgr_processCmdResponse(void);
+static void modemMgrInvalidateStatus(void);
+#if (MODEM_ENERGY_BUDGET==1)
+static void modemMgrLoadBudget(void);
+#endif
+#if (MODEM_COVERAGE_RETRY==1)
+static void modemMgrRecordCoverage(void);
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+static void parseModemInfoCmdResponse(modemCmdReadData_t *readDataP);
+#endif
 static void parseModemStatusCmdResponse(modemCmdReadData_t *readDataP);
 static void parseModemMsgStatusCmdResponse(modemCmdReadData_t *readDataP);
 static void parseModemOtaCmdResponse(modemCmdReadData_t *readDataP);
@@ -112,19 +286,6 @@ static void parseModemOtaCmdResponse(modemCmdReadData_t *readDataP);
  * Module Public Functions
  **************************/
 
-// TODO - need overall timeout on batch job!
-
-/**
-* \brief Drive the state machines for sending a write batch job
-*        or to handle OTA messages
-* \ingroup EXEC_ROUTINE
-*/
-void modemMgr_exec(void) {
-    if (mwBatchData.active) {
-        modemMgr_stateMachine();
-    }
-}
-
 /**
 * \brief Initialize the modem manager module.  Should be called 
 *        once on system start up.
@@ -132,15 +293,70 @@ void modemMgr_exec(void) {
 */
 void modemMgr_init(void) {
     memset(&mwBatchData, 0, sizeof(mwBatchData_t));
-    mwBatchData.mwBatchState = MWBATCH_STATE_PING;
     mwBatchData.otaResponse.buf = otaBuf;
+    modemCmd_setResponseFunc(modemMgr_processCmdResponse);
+#if (MODEM_ENERGY_BUDGET==1)
+    memset(&budgetData, 0, sizeof(modemBudgetData_t));
+    modemMgrLoadBudget();
+#endif
+#if (MODEM_COVERAGE_RETRY==1)
+    memset(coverageLinkTime, MODEM_COVERAGE_UNKNOWN, sizeof(coverageLinkTime));
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+    // The transmit offset until the IMEI is read
+    mwBatchData.unitSeed = gen_crc16(FLASH_ADDR_TO_PTR(CAL_LOCATION), CAL_LENGTH);
+#endif
 }
 
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+* \brief Exec routine should be called once every second from 
+*        the main processing loop.  Counts the modem on time of
+*        the session and of the rolling day and shuts the modem
+*        down at the end of the hold time.
+* \ingroup EXEC_ROUTINE
+*/
+void modemMgr_exec(void) {
+    // The modem is powered while it is allocated or held
+    if (mwBatchData.allocated) {
+        if (budgetData.sessionOnSecs < MODEM_BUDGET_MAX_SECONDS) {
+            budgetData.sessionOnSecs++;
+        }
+    }
+    if (modemMgr_isAllocated()) {
+        if (budgetData.dayOnSecs < MODEM_BUDGET_MAX_SECONDS) {
+            budgetData.dayOnSecs++;
+        }
+    }
+#if (MODEM_KEEP_WARM==1)
+    if (mwBatchData.warmSecsLeft) {
+        mwBatchData.warmSecsLeft--;
+        if (modemMgr_isDayBudgetExhausted()) {
+            mwBatchData.warmSecsLeft = 0;
+        }
+        if (!mwBatchData.warmSecsLeft) {
+            modemLink_shutdownModem();
+        }
+    }
+#endif
+    // Every hour drain one 24th of the day budget (60 * minutes / 24)
+    if ((getSecondsSinceBoot() % MODEM_BUDGET_DRAIN_PERIOD_IN_SECONDS) == 0) {
+        uint16_t drain = ((uint16_t)budgetData.dayMinutes * 5) >> 1;
+        if (budgetData.dayOnSecs > drain) {
+            budgetData.dayOnSecs -= drain;
+        } else {
+            budgetData.dayOnSecs = 0;
+        }
+    }
+}
+#endif
+
 /**
 * \brief Grab the modem resource.  This is the first step that 
 *        any modem client must use to allocate the modem.  If
-*        the modem is not currently up, then the grab function
-*        will start the modem power up sequence.
+*        the modem is not currently up (or held after the last
+*        release), then the grab function will start the modem
+*        power up sequence.
 * \ingroup PUBLIC_API
 * 
 * @return bool Returns true if the modem resource was 
@@ -150,10 +366,29 @@ bool modemMgr_grab(void) {
     bool success = false;
     if (!mwBatchData.allocated) {
         mwBatchData.allocated = true;
+        modemMgrInvalidateStatus();
+#if (MODEM_ENERGY_BUDGET==1)
+        // A new session: the budget may have been changed OTA.
+        modemMgrLoadBudget();
+        budgetData.sessionOnSecs = 0;
+#endif
+#if (MODEM_KEEP_WARM==1)
+        mwBatchData.warmSecsLeft = 0;
+#endif
+#if (MODEM_COVERAGE_RETRY==1)
+        mwBatchData.rssi = 0;
+        mwBatchData.linkSecs = MODEM_LINK_SECS_NONE;
+#endif
         success = true;
         if (!modemMgr_isModemUp()) {
             modemLink_restart();
         }
+#if (MODEM_KEEP_WARM==1)
+        else {
+            // A held modem: the link wait time starts now
+            modemLink_resetUpTime();
+        }
+#endif
     }
     return success;
 }
@@ -187,7 +422,8 @@ bool modemMgr_isModemUpError(void) {
 *        batch job.  A write batch contains a number of
 *        cmds that are sent to the modem in addition to the
 *        command, including a modem status cmd and a modem
-*        message status cmd.
+*        message status cmd.  The batchProfile of the command
+*        selects which of them are sent.
 * \ingroup PUBLIC_API
 *
 * @param cmdWriteP  pointer to a modemCmdWriteData_t object. 
@@ -195,12 +431,68 @@ bool modemMgr_isModemUpError(void) {
 *                   The pointer is saved for future operations.
 */
 void modemMgr_sendModemCmdBatch(modemCmdWriteData_t *cmdWriteP) {
-    mwBatchData.cmdWriteP = cmdWriteP;
-    mwBatchData.mwBatchState = MWBATCH_STATE_PING;
-    mwBatchData.active = true;
+    modemBatchProfile_t profile = cmdWriteP->batchProfile;
+    bool sendStatus = true;
+#if (MODEM_TRANSMIT_SPREAD==1)
+    bool sendInfo = false;
+#endif
+    uint8_t cmdsPending = 0;
+
+#if (MODEM_LEAN_BATCH==1)
+    // A data only job skips the status while it is recent.
+    if ((profile == MODEM_BATCH_DATA_ONLY) && !modemMgr_isStatusStale()) {
+        sendStatus = false;
+    }
+    // A command only job leaves the status refresh to the client.
+    if (profile == MODEM_BATCH_CMD_ONLY) {
+        sendStatus = false;
+    }
+#else
+    // Only the status only job is lean.
+    if (profile != MODEM_BATCH_STATUS_ONLY) {
+        profile = MODEM_BATCH_FULL;
+    }
+#endif
+    if (profile == MODEM_BATCH_FULL) {
+        cmdsPending++;
+#if (MODEM_TRANSMIT_SPREAD==1)
+        // Read the IMEI once (see modemMgr_getTransmitOffset)
+        if (!mwBatchData.unitSeedValid) {
+            sendInfo = true;
+            cmdsPending++;
+        }
+#endif
+    }
+    if (profile != MODEM_BATCH_STATUS_ONLY) {
+        cmdsPending++;
+    }
+    if (sendStatus) {
+        cmdsPending += 2;
+        mwBatchData.modemLinkUpStatus = MODEM_STATE_IDLE;
+    }
+    mwBatchData.cmdsPending = cmdsPending;
     mwBatchData.commError = false;
-    mwBatchData.modemLinkUpStatus = MODEM_STATE_IDLE;
-    modemMgr_stateMachine();
+    mwBatchData.active = true;
+
+    // Queue the batch job.  The queue holds a full job behind a
+    // command that is still in progress.
+    if (profile == MODEM_BATCH_FULL) {
+        modemCmd_write(&pingCmdWrite);
+    }
+#if (MODEM_TRANSMIT_SPREAD==1)
+    if (sendInfo) {
+        modemCmd_write(&modemInfoCmdWrite);
+    }
+#endif
+    // A status only job only requests modem status information
+    // and does not send a new data command.
+    if (profile != MODEM_BATCH_STATUS_ONLY) {
+        modemCmd_write(cmdWriteP);
+    }
+    if (sendStatus) {
+        modemCmd_write(&modemStatusCmdWrite);
+        modemCmd_write(&msgStatusCmdWrite);
+    }
 }
 
 /**
@@ -208,8 +500,8 @@ void modemMgr_sendModemCmdBatch(modemCmdWriteData_t *cmdWriteP) {
 * \ingroup PUBLIC_API
 */
 void modemMgr_stopModemCmdBatch(void) {
-    mwBatchData.mwBatchState = MWBATCH_STATE_IDLE;
     mwBatchData.active = false;
+    modemCmd_flushQueue();
 }
 
 /**
@@ -249,29 +541,58 @@ bool modemMgr_isModemCmdError(void) {
 * \ingroup PUBLIC_API
 */
 void modemMgr_restartModem(void) {
+    modemMgrInvalidateStatus();
     modemLink_restart();
 }
 
 /**
-* \brief Check if modem is in use.
+* \brief Check if modem is in use.  A modem held on after the 
+*        last release is in use too: it draws power and listens
+*        on the UART.
 * \ingroup PUBLIC_API
 * 
 * @return bool 
 */
 bool modemMgr_isAllocated(void) {
+#if (MODEM_KEEP_WARM==1)
+    return (mwBatchData.allocated || mwBatchData.warmSecsLeft) ? true : false;
+#else
     return mwBatchData.allocated;
+#endif
 }
 
 /**
 * \brief Release the modem.  Must be called by all upper layer 
-*        message objects when they are done with the modem.
+*        message objects when they are done with the modem.  A
+*        modem that is registered on the network (and had no
+*        comm error) is kept on for the configured hold time,
+*        otherwise it is shut down.
 * \ingroup PUBLIC_API
 */
 void modemMgr_release(void) {
+    if (mwBatchData.allocated) {
+#if (MODEM_ENERGY_BUDGET==1)
+        budgetData.lastSessionOnSecs = budgetData.sessionOnSecs;
+#endif
+#if (MODEM_COVERAGE_RETRY==1)
+        modemMgrRecordCoverage();
+#endif
+#if (MODEM_KEEP_WARM==1)
+        if (modemMgr_isLinkUp() && !mwBatchData.commError && !modemMgr_isDayBudgetExhausted()) {
+            mwBatchData.warmSecsLeft = budgetData.keepWarmSecs;
+        }
+#endif
+    }
     mwBatchData.allocated = false;
     mwBatchData.active = false;
-    mwBatchData.mwBatchState = MWBATCH_STATE_IDLE;
+    modemCmd_flushQueue();
+#if (MODEM_KEEP_WARM==1)
+    if (!mwBatchData.warmSecsLeft) {
+        modemLink_shutdownModem();
+    }
+#else
     modemLink_shutdownModem();
+#endif
 }
 
 /**
@@ -287,6 +608,22 @@ uint8_t modemMgr_getNumOtaMsgsPending(void) {
     return mwBatchData.numOfOtaMsgsAvailable;
 }
 
+#if (MODEM_LEAN_BATCH==1)
+/**
+* \brief Returns true if the last message status is older than 
+*        MODEM_STATUS_MAX_AGE_IN_SECONDS (or there was none since
+*        the modem was powered on).  The link status and the
+*        number of OTA messages pending may then be out of date.
+* \ingroup PUBLIC_API
+* 
+* @return bool True if the status should be refreshed before it 
+*         is used.
+*/
+bool modemMgr_isStatusStale(void) {
+    return (GET_ELAPSED_TIME_IN_SEC(mwBatchData.statusTimestamp) >= MODEM_STATUS_MAX_AGE_IN_SECONDS);
+}
+#endif
+
 /**
 * \brief Returns true if the modem network status is connected. 
 *        This information is parsed from the modem status
@@ -344,132 +681,293 @@ uint8_t* modemMgr_getSharedBuffer(void) {
     return mwBatchData.otaResponse.buf;
 }
 
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+* \brief Returns true if the modem has been on for the session 
+*        budget since it was grabbed.  The client should end the
+*        session.
+* \ingroup PUBLIC_API
+* 
+* @return bool True if the session budget is used up.
+*/
+bool modemMgr_isSessionBudgetExhausted(void) {
+    return (budgetData.sessionOnSecs >= ((uint16_t)budgetData.sessionMinutes * 60));
+}
+
+/**
+* \brief Write the modem energy budget configuration received 
+*        from an OTA message.  Data is the modem on time budget
+*        per session and per rolling day in minutes (see
+*        modemMgr_exec), then the time in seconds the modem is
+*        kept on after a session (see modemMgr_release).  All
+*        zero restores the defaults.  Used from the next session
+*        on.
+* \ingroup PUBLIC_API
+* 
+* @param dataP A pointer to the configuration received from the 
+*              OTA message.
+* 
+* @return bool False if the configuration is not valid.
+*/
+bool modemMgr_setBudgetConfig(uint8_t *dataP) {
+    modemConfig_t config;
+    // A session may not be longer than the day
+    if ((!dataP[0] != !dataP[1]) || (dataP[0] > dataP[1])) {
+        return false;
+    }
+    storageMgr_getModemConfig(&config);
+    config.sessionMinutes = dataP[0];
+    config.dayMinutes = dataP[1];
+    config.keepWarmSecs = dataP[2];
+    storageMgr_setModemConfig(&config);
+    return true;
+}
+
+/**
+* \brief Returns true if the modem on time of the rolling day 
+*        has reached the day budget.  Traffic that can wait should
+*        be deferred.
+* \ingroup PUBLIC_API
+* 
+* @return bool True if the day budget is used up.
+*/
+bool modemMgr_isDayBudgetExhausted(void) {
+    return (budgetData.dayOnSecs >= ((uint16_t)budgetData.dayMinutes * 60));
+}
+
+/**
+* \brief Write the budget use for the check-in message: the modem 
+*        on seconds of the last session and of the rolling day
+*        (16 bits, MSB first), then the session and the day
+*        budget in minutes.
+* \ingroup PUBLIC_API
+* 
+* @param bufP Where to write the report
+* 
+* @return uint8_t The size of the report in bytes
+*/
+uint8_t modemMgr_getBudgetReport(uint8_t *bufP) {
+    bufP[0] = budgetData.lastSessionOnSecs >> 8;
+    bufP[1] = budgetData.lastSessionOnSecs & 0xFF;
+    bufP[2] = budgetData.dayOnSecs >> 8;
+    bufP[3] = budgetData.dayOnSecs & 0xFF;
+    bufP[4] = budgetData.sessionMinutes;
+    bufP[5] = budgetData.dayMinutes;
+    return 6;
+}
+#endif
+
+#if (MODEM_COVERAGE_RETRY==1)
+/**
+* \brief Pick the retry delay from the coverage profile: the 
+*        start of the hour with the shortest average link time
+*        among the hours that start in the window.  The earliest
+*        is taken of equal hours, so without a profile this is the
+*        first hour start in the window.
+* \ingroup PUBLIC_API
+* 
+* @param minSecs The shortest delay in seconds
+* @param maxSecs The longest delay in seconds
+* 
+* @return uint16_t The delay in seconds, minSecs if no hour 
+*         starts in the window.
+*/
+uint16_t modemMgr_getCoverageRetryDelay(uint16_t minSecs, uint16_t maxSecs) {
+    timePacket_t *tp = getBinTime();
+    uint8_t hour = tp->hour24;
+    // Seconds to the start of the next hour
+    uint32_t delay = SECONDS_PER_HOUR - (((uint16_t)tp->minute * SECONDS_PER_MINUTE) + tp->second);
+    uint16_t bestDelay = minSecs;
+    uint8_t bestLinkTime = MODEM_COVERAGE_NO_LINK;
+    bool found = false;
+
+    for (; delay <= maxSecs; delay += SECONDS_PER_HOUR) {
+        if (++hour >= 24) {
+            hour = 0;
+        }
+        if (delay < minSecs) {
+            continue;
+        }
+        if (!found || (coverageLinkTime[hour] < bestLinkTime)) {
+            found = true;
+            bestLinkTime = coverageLinkTime[hour];
+            bestDelay = (uint16_t)delay;
+        }
+    }
+    return bestDelay;
+}
+
+/**
+* \brief Write the coverage profile for the check-in message: 
+*        the RSSI and signal strength of the last modem status,
+*        then the average link time (MODEM_COVERAGE_UNIT_SECONDS
+*        units) of each hour of the day.
+* \ingroup PUBLIC_API
+* 
+* @param bufP Where to write the report
+* 
+* @return uint8_t The size of the report in bytes
+*/
+uint8_t modemMgr_getCoverageReport(uint8_t *bufP) {
+    uint8_t i;
+    bufP[0] = mwBatchData.rssi;
+    bufP[1] = mwBatchData.signalStrength;
+    for (i = 0; i < 24; i++) {
+        bufP[2 + i] = coverageLinkTime[i];
+    }
+    return 26;
+}
+#endif
+
+#if (MODEM_TRANSMIT_SPREAD==1)
+/**
+* \brief Return the transmit offset of the unit in a spread 
+*        window: the IMEI CRC16 scaled to the window, so the
+*        offsets of a fleet are spread evenly and each unit keeps
+*        the same one.  Until the modem info was read after a
+*        reset, the CRC16 of the factory calibration (INFO A) is
+*        used instead.
+* \ingroup PUBLIC_API
+* 
+* @param windowSecs The spread window in seconds
+* 
+* @return uint16_t The offset in seconds, less than windowSecs
+*/
+uint16_t modemMgr_getTransmitOffset(uint16_t windowSecs) {
+    return (uint16_t)(((uint32_t)mwBatchData.unitSeed * windowSecs) >> 16);
+}
+#endif
+
 /*************************
  * Module Private Functions
  ************************/
 
 /**
-* \brief State machine for sending the modem write batch set of 
-*        commands.
-*/
-static void modemMgr_stateMachine(void) {
-    bool continue_processing = false;
-    do {
-        continue_processing = false;
-        switch (mwBatchData.mwBatchState) {
-        case MWBATCH_STATE_IDLE:
-            break;
-        case MWBATCH_STATE_PING:
-            {
-                modemCmdWriteData_t mcWriteData;
-                memset(&mcWriteData, 0, sizeof(modemCmdWriteData_t));
-                mcWriteData.cmd = M_COMMAND_PING;
-                modemCmd_write(&mcWriteData);
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_PING_WAIT;
-            }
-            break;
-        case MWBATCH_STATE_PING_WAIT:
-            if (!modemCmd_isBusy()) {
-                // If the status only flag is set in the cmd, then the client is
-                // only requesting modem status information and not to send
-                // a new data command.  So set the state accordingly.
-                if (mwBatchData.cmdWriteP->statusOnly) {
-                    // Next state - jump to get modem status
-                    mwBatchData.mwBatchState = MWBATCH_STATE_MODEM_STATUS;
-                } else {
-                    // Next state - send command
-                    mwBatchData.mwBatchState = MWBATCH_STATE_WRITE_CMD;
-                }
-                continue_processing = true;
-            }
-            break;
-
-        case MWBATCH_STATE_WRITE_CMD:
-            {
-                modemCmd_write(mwBatchData.cmdWriteP);
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_WRITE_CMD_WAIT;
-            }
-            break;
-        case MWBATCH_STATE_WRITE_CMD_WAIT:
-            if (!modemCmd_isBusy()) {
-                // If a uart comm error occurred, record it.
-                // We only record comm errors for sending the data command.
-                // Not for ping or status messages.
-                if (modemCmd_isError()) {
-                    mwBatchData.commError = true;
-                }
-                // If cmd was a get OTA data request, parse and save the data
-                if (mwBatchData.cmdWriteP->cmd == M_COMMAND_GET_INCOMING_PARTIAL) {
-                    modemCmdReadData_t readData;
-                    modemCmd_read(&readData);
-                    parseModemOtaCmdResponse(&readData);
-                }
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_MODEM_STATUS;
-                continue_processing = true;
-            }
-            break;
-
-        case MWBATCH_STATE_MODEM_STATUS:
-            {
-                modemCmdWriteData_t mcWriteData;
-                memset(&mcWriteData, 0, sizeof(modemCmdWriteData_t));
-                mcWriteData.cmd = M_COMMAND_MODEM_STATUS;
-                modemCmd_write(&mcWriteData);
-
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_MODEM_STATUS_WAIT;
-            }
-            break;
-
-        case MWBATCH_STATE_MODEM_STATUS_WAIT:
-            if (!modemCmd_isBusy()) {
-                // Read data and parse
-                modemCmdReadData_t readData;
-                modemCmd_read(&readData);
-                parseModemStatusCmdResponse(&readData);
-
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_MSG_STATUS;
-                continue_processing = true;
-            }
-            break;
-
-        case MWBATCH_STATE_MSG_STATUS:
-            {
-                modemCmdWriteData_t mcWriteData;
-                memset(&mcWriteData, 0, sizeof(modemCmdWriteData_t));
-                mcWriteData.cmd = M_COMMAND_MESSAGE_STATUS;
-                modemCmd_write(&mcWriteData);
-
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_MSG_STATUS_WAIT;
-            }
-            break;
-
-        case MWBATCH_STATE_MSG_STATUS_WAIT:
-            if (!modemCmd_isBusy()) {
-                // Read data and parse
-                modemCmdReadData_t readData;
-                modemCmd_read(&readData);
-                parseModemMsgStatusCmdResponse(&readData);
-
-                // Next state
-                mwBatchData.mwBatchState = MWBATCH_STATE_DONE;
-                continue_processing = true;
-            }
-            break;
-
-        case MWBATCH_STATE_DONE:
-            mwBatchData.active = false;
-            break;
+* \brief Response function of the modem write batch job.  Called
+*        by modemCmd (possibly from the UART ISR) when each
+*        command of the job is done, before the next queued
+*        command is started.
+*/
+static void modemMgr_processCmdResponse(void) {
+    modemCmdReadData_t readData;
+
+    // Only the responses of a batch job are of interest (not debug data).
+    if (!mwBatchData.active) {
+        return;
+    }
+
+    modemCmd_read(&readData);
+    switch (readData.modemCmdId) {
+    case M_COMMAND_PING:
+        break;
+#if (MODEM_TRANSMIT_SPREAD==1)
+    case M_COMMAND_MODEM_INFO:
+        parseModemInfoCmdResponse(&readData);
+        break;
+#endif
+    case M_COMMAND_MODEM_STATUS:
+        parseModemStatusCmdResponse(&readData);
+        break;
+    case M_COMMAND_MESSAGE_STATUS:
+        parseModemMsgStatusCmdResponse(&readData);
+        break;
+    default:
+        // The command of the batch job.
+        // If a uart comm error occurred, record it.
+        // We only record comm errors for sending the data command.
+        // Not for ping or status messages.
+        if (!readData.valid) {
+            mwBatchData.commError = true;
+        }
+        // If cmd was a get OTA data request, parse and save the data
+        if (readData.modemCmdId == M_COMMAND_GET_INCOMING_PARTIAL) {
+            parseModemOtaCmdResponse(&readData);
         }
+        break;
+    }
 
-    } while (continue_processing);
+    // The job is done when the last of its commands is done.
+    if (mwBatchData.cmdsPending) {
+        mwBatchData.cmdsPending--;
+    }
+    if (mwBatchData.cmdsPending == 0) {
+        mwBatchData.active = false;
+    }
 }
 
+/**
+* \brief Forget the status of the last power up: the link is not 
+*        up and the status is stale until the next message
+*        status.
+*/
+static void modemMgrInvalidateStatus(void) {
+    mwBatchData.modemLinkUpStatus = MODEM_STATE_IDLE;
+#if (MODEM_LEAN_BATCH==1)
+    mwBatchData.statusTimestamp = GET_SYSTEM_TICK();
+    mwBatchData.statusTimestamp -= MODEM_STATUS_MAX_AGE_IN_SECONDS;
+#endif
+}
+
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+* \brief Read the budget configuration, zero selects the 
+*        default (no hold time).
+*/
+static void modemMgrLoadBudget(void) {
+    modemConfig_t config;
+    storageMgr_getModemConfig(&config);
+    budgetData.sessionMinutes = config.sessionMinutes;
+    budgetData.dayMinutes = config.dayMinutes;
+#if (MODEM_KEEP_WARM==1)
+    budgetData.keepWarmSecs = config.keepWarmSecs;
+#endif
+    if (!budgetData.sessionMinutes) {
+        budgetData.sessionMinutes = MODEM_SESSION_BUDGET_DEFAULT_MINUTES;
+    }
+    if (!budgetData.dayMinutes) {
+        budgetData.dayMinutes = MODEM_DAY_BUDGET_DEFAULT_MINUTES;
+    }
+}
+#endif
+
+#if (MODEM_COVERAGE_RETRY==1)
+/**
+* \brief Add the session to the coverage profile of the current 
+*        hour: a rolling average in which the new sample has a
+*        weight of one quarter.  A session that ended on a UART
+*        comm error without a link says nothing about the coverage
+*        and is skipped.
+*/
+static void modemMgrRecordCoverage(void) {
+    uint8_t *averageP = &coverageLinkTime[getBinTime()->hour24];
+    uint8_t linkTime = MODEM_COVERAGE_NO_LINK;
+
+    if (mwBatchData.linkSecs != MODEM_LINK_SECS_NONE) {
+        uint16_t units = mwBatchData.linkSecs / MODEM_COVERAGE_UNIT_SECONDS;
+        linkTime = (units < MODEM_COVERAGE_NO_LINK) ? (uint8_t)units : (MODEM_COVERAGE_NO_LINK - 1);
+    } else if (mwBatchData.commError) {
+        return;
+    }
+    *averageP = (uint8_t)((((uint16_t)*averageP * 3) + linkTime + 2) >> 2);
+}
+#endif
+
+#if (MODEM_TRANSMIT_SPREAD==1)
+/**
+* \brief Parse a modem info command response: the transmit 
+*        offset seed is the CRC16 of the IMEI.
+* 
+* @param readDataP Pointer to a modemCmdReadData_t object 
+*/
+static void parseModemInfoCmdResponse(modemCmdReadData_t *readDataP) {
+    if (readDataP->valid && (readDataP->modemCmdId == M_COMMAND_MODEM_INFO)) {
+        // bytes 2 major, 3 minor, 4..11 IMEI (MSB first)
+        mwBatchData.unitSeed = gen_crc16(&readDataP->dataP[4], 8);
+        mwBatchData.unitSeedValid = true;
+    }
+}
+#endif
+
 /**
 * \brief Parse a modem status command response to retrieve the 
 *        link status.
@@ -481,6 +979,14 @@ static void parseModemStatusCmdResponse(modemCmdReadData_t *readDataP) {
     if (readDataP->valid && (readDataP->modemCmdId == M_COMMAND_MODEM_STATUS)) {
         modem_state_t modemState = (modem_state_t)readDataP->dataP[2];
         mwBatchData.modemLinkUpStatus = (uint8_t)modemState;
+#if (MODEM_COVERAGE_RETRY==1)
+        // bytes 3,4 voltage, 5,6 adc, 7 rssi, 8 signal strength
+        mwBatchData.rssi = readDataP->dataP[7];
+        mwBatchData.signalStrength = readDataP->dataP[8];
+        if ((modemState == MODEM_STATE_CONNECTED) && (mwBatchData.linkSecs == MODEM_LINK_SECS_NONE)) {
+            mwBatchData.linkSecs = modemLink_getModemUpTimeInSecs();
+        }
+#endif
     }
 }
 
@@ -494,6 +1000,9 @@ static void parseModemMsgStatusCmdResponse(modemCmdReadData_t *readDataP) {
     if (readDataP->valid && (readDataP->modemCmdId == M_COMMAND_MESSAGE_STATUS)) {
         // Only take LS Byte of message count
         mwBatchData.numOfOtaMsgsAvailable = readDataP->dataP[3];
+#if (MODEM_LEAN_BATCH==1)
+        mwBatchData.statusTimestamp = GET_SYSTEM_TICK();
+#endif
     }
 }
 
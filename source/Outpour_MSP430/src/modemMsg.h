@@ -21,6 +21,9 @@ typedef enum messageType {
 	MSG_TYPE_RETRYBYTE = 0x04,
 	MSG_TYPE_CHECKIN = 0x05,
     MSG_TYPE_SOS = 0x06,
+    MSG_TYPE_MINUTE_FLOW = 0x07,
+    MSG_TYPE_EVENT_LOG = 0x08,
+    MSG_TYPE_MULTI_DAY = 0x09,
     MSG_TYPE_DEBUG_PAD_STATS = 0x10,
     MSG_TYPE_DEBUG_STORAGE_INFO = 0x11,
     MSG_TYPE_DEBUG_TIME_INFO = 0x12
@@ -39,6 +42,9 @@ typedef enum otaOpcodes_e {
     OTA_OPCODE_SILENCE_DEVICE = 0x06,
     OTA_OPCODE_UPDATE_CONSTANTS = 0x07,
     OTA_OPCODE_RESET_DEVICE = 0x08,
+    OTA_OPCODE_MINUTE_CAPTURE = 0x0A,
+    OTA_OPCODE_MODEM_BUDGET = 0x0B,
+    OTA_OPCODE_TRANSMIT_SPREAD = 0x0C,
     OTA_OPCODE_FIRMWARE_UPGRADE = 0x10
 } OtaOpcode_t;
 
@@ -5,14 +5,71 @@
  * 
  * \brief Manage the high level details of sending a data 
  *        message to the modem.
+ *
+ * \note Outbound queue (DATA_MSG_QUEUE):  The daily log backlog 
+ *       and the check-in message are posted to a small queue (one
+ *       bit per message type, so a message posted twice is sent
+ *       once) instead of being dropped when a session is already
+ *       in progress.  A session sends the queue in priority order
+ *       after its own message (DATA_MSG_QUEUE_xxx, lowest bit
+ *       first), so messages that collide share one modem session.
+ *       An entry is removed when the session that sent it
+ *       succeeded.  The queue is kept in RAM that is not
+ *       initialized at reset, so what is left after a watchdog or
+ *       OTA reset is sent with the final assembly message.
+ *       Without the option, a daily log session still sends the
+ *       backlog, but a send that collides with a session is
+ *       dropped.
+ *
+ * \note Transmit spread (MODEM_TRANSMIT_SPREAD):  The daily log 
+ *       and check-in sessions are started at fixed storage times,
+ *       the same for all the units of a region.  A new session is
+ *       started after the transmit offset of the unit
+ *       (modemMgr_getTransmitOffset) in the spread window
+ *       configured OTA (modemConfig_t), so that the fleet spreads
+ *       its traffic over the window.
  */
 
 #include "outpour.h"
 
+#if ((MODEM_ENERGY_BUDGET==1) || (MODEM_TRANSMIT_SPREAD==1)) && (DATA_MSG_QUEUE==0)
+#error MODEM_ENERGY_BUDGET and MODEM_TRANSMIT_SPREAD need DATA_MSG_QUEUE
+#endif
+
 /***************************
  * Module Data Definitions
  **************************/
 
+#if (MODEM_COVERAGE_RETRY==1)
+/**
+ * \def DATA_MSG_MAX_RETRIES
+ * \brief Specify how many retries to attempt to send the data 
+ *        msg if the network was not able to connect.
+ */
+#define DATA_MSG_MAX_RETRIES ((uint8_t)3)
+
+/**
+ * \def DATA_MSG_RETRY_BACKOFF_IN_SECONDS
+ * \brief Specify the shortest wait to retransmit as a result of 
+ *        the modem failing to connect to the network.  The wait
+ *        doubles with each retry (exponential backoff).  The
+ *        retry is placed at the start of the hour with the best
+ *        coverage profile between the wait and twice the wait
+ *        (modemMgr_getCoverageRetryDelay): 2 to 4, 4 to 8 and 8
+ *        to 16 hours.
+ * \note Max hours in a uint16_t representing seconds is 18.2 
+ *       hours.
+ */
+#define DATA_MSG_RETRY_BACKOFF_IN_SECONDS ((uint16_t)2*60*60)
+
+/**
+ * \def DATA_MSG_RETRY_JITTER_IN_SECONDS
+ * \brief Specify the random time added to the retry delay, so 
+ *        that the units of a site that lost the network do not
+ *        all retry at the start of the same hour.
+ */
+#define DATA_MSG_RETRY_JITTER_IN_SECONDS ((uint16_t)30*60)
+#else
 /**
  * \def DATA_MSG_MAX_RETRIES
  * \brief Specify how many retries to attempt to send the data 
@@ -28,6 +85,81 @@
  *       hours.  Currently set at 12 hours.
  */
 #define DATA_MSG_DELAY_IN_SECONDS_TILL_RETX ((uint16_t)12*60*60)
+#endif
+
+/**
+ * \def DATA_MSG_MAX_DAILY_LOGS_PER_SESSION
+ * \brief Specify the maximum number of daily logs from the 
+ *        backlog to send in one modem session.  Any remaining
+ *        daily logs are sent in the next session.
+ */
+#define DATA_MSG_MAX_DAILY_LOGS_PER_SESSION ((uint8_t)10)
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+ * \def DATA_MSG_MAX_DAYS_PER_MSG
+ * \brief Specify the maximum number of daily logs in a multi-day 
+ *        message (7 days are 14 + 7 * 91 = 651 bytes).
+ */
+#define DATA_MSG_MAX_DAYS_PER_MSG ((uint8_t)7)
+#endif
+
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+ * \def DATA_MSG_BUDGET_DEFER_IN_SECONDS
+ * \brief Specify how long to defer a session when the modem day 
+ *        budget is used up.  The budget is checked again then.
+ */
+#define DATA_MSG_BUDGET_DEFER_IN_SECONDS ((uint16_t)60*60)
+#endif
+
+#if (MODEM_TRANSMIT_SPREAD==1)
+/**
+ * \def DATA_MSG_SPREAD_DEFAULT_MINUTES
+ * \brief Specify the default transmit spread window.
+ */
+#define DATA_MSG_SPREAD_DEFAULT_MINUTES ((uint8_t)60)
+
+/**
+ * \def DATA_MSG_SPREAD_OFF
+ * \brief The transmit spread configuration that starts the 
+ *        sessions at the storage time.
+ */
+#define DATA_MSG_SPREAD_OFF ((uint8_t)0xFF)
+#endif
+
+#if (DATA_MSG_QUEUE==1)
+/**
+ * \def DATA_MSG_QUEUE_DAILY_LOGS
+ * \brief Outbound queue entry: the daily log backlog, followed by 
+ *        the minute flow captures and the event log when built in
+ *        (MINUTE_FLOW_CAPTURE, RECORD_EVENT_LOG).  Posted for
+ *        the weekly send and for a red flag change.
+ */
+#define DATA_MSG_QUEUE_DAILY_LOGS ((uint8_t)0x01)
+
+/**
+ * \def DATA_MSG_QUEUE_CHECKIN
+ * \brief Outbound queue entry: the check-in message.
+ */
+#define DATA_MSG_QUEUE_CHECKIN ((uint8_t)0x02)
+
+/**
+ * \def DATA_MSG_QUEUE_ALL
+ * \brief All the outbound queue entries.
+ */
+#define DATA_MSG_QUEUE_ALL ((uint8_t)0x03)
+
+/**
+ * \typedef msgQueue_t
+ * \brief The outbound message queue.  Kept across a reset, the 
+ *        check byte tells if the RAM content is valid.
+ */
+typedef struct msgQueue_s {
+    uint8_t pending;           /**< DATA_MSG_QUEUE_xxx entries to send */
+    uint8_t check;             /**< complement of pending */
+} msgQueue_t;
+#endif
 
 /**
  * \typedef msgData_t
@@ -39,8 +171,28 @@ typedef struct msgData_s {
     bool sendDataMsgScheduled; /**< flag to mark a data message is scheduled */
     bool sendFaScheduled;      /**< flag to mark a send Final Assembly is scheduled */
     bool sendFaActive;         /**< flag to mark a send Final Assembly is in progress */
-    bool sendDailyLogs;        /**< flag to indicate we are sending daily logs */
-    uint8_t weeklyLogNum;      /**< which weekly log to access when retrieving daily logs */
+#if (DATA_MSG_QUEUE==1)
+    bool sendQueued;           /**< flag to indicate the session sends the queue after its current message */
+#else
+    bool sendQueued;           /**< flag to indicate the session sends the daily log backlog after its current message */
+#endif
+    uint8_t dailyLogCount;     /**< number of daily logs sent in the current session */
+    uint16_t dailyLogMask;     /**< transmit index mask of the daily logs sent in the current session */
+#if (MINUTE_FLOW_CAPTURE==1)
+    uint8_t minuteCaptureMask; /**< mask of the minute captures sent in the current session */
+#endif
+#if (RECORD_EVENT_LOG==1)
+    uint8_t eventLogCount;     /**< number of events sent in the current session */
+#endif
+#if (DATA_MSG_QUEUE==1)
+    uint8_t sessionMask;       /**< queue entries sent in the current session */
+#endif
+#if (MODEM_ENERGY_BUDGET==1)
+    bool budgetDeferred;       /**< flag to indicate a session was deferred (modem day budget) */
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+    bool spreadScheduled;      /**< flag to indicate the scheduled session waits for the transmit offset */
+#endif
     uint8_t retryCount;           /**< number of retries attempted */
     uint16_t secsTillTransmit; /**< time in seconds until transmit: max is 18.2 hours as 16 bit value */
     dataMsgSm_t dataMsgSm;     /**< Data message state machine object */
@@ -57,10 +209,48 @@ typedef struct msgData_s {
 // static
 msgData_t msgData;
 
+#if (DATA_MSG_QUEUE==1)
+/**
+* \var msgQueue
+* \brief Declare the outbound message queue.  Not initialized at 
+*        reset.
+*/
+#pragma NOINIT(msgQueue)
+// static
+msgQueue_t msgQueue;
+#endif
+
 /*************************
  * Module Prototypes
  ************************/
 
+static uint16_t getNextSessionPayload(uint8_t **dataPP, MessageType_t *msgIdP);
+#if (MODEM_ENERGY_BUDGET==1)
+static bool deferOverBudget(void);
+#endif
+#if (DATA_MSG_QUEUE==1)
+static void startQueuedSession(void);
+#endif
+static void startSession(MessageType_t msgId, uint8_t *dataP, uint16_t length);
+static void setPayload(modemCmdWriteData_t *cmdWriteP, MessageType_t msgId, uint8_t *dataP, uint16_t length);
+#if (MODEM_TRANSMIT_SPREAD==1)
+static void spreadQueuedSession(void);
+#endif
+static void initSessionQueue(void);
+static void sendNextQueued(dataMsgSm_t *dataMsgSmP);
+static bool queueSessionDone(dataMsgSm_t *dataMsgSmP);
+#if (DATA_MSG_QUEUE==1)
+static void queuePost(uint8_t entry);
+static void queueRemove(uint8_t entries);
+#endif
+static uint16_t getCheckinPayload(uint8_t **dataPP);
+#if (MODEM_COVERAGE_RETRY==1)
+static uint16_t getRetryDelay(uint8_t retryCount);
+#endif
+#if (DATA_MSG_MULTI_DAY==1)
+static modemCmdPayloadFunc_t getPayloadFunc(MessageType_t msgId);
+#endif
+
 /***************************
  * Module Public Functions
  **************************/
@@ -72,6 +262,15 @@ msgData_t msgData;
 */
 void dataMsgMgr_init(void) {
     memset(&msgData, 0, sizeof(msgData_t));
+#if (DATA_MSG_QUEUE==1)
+    // The queue is kept across a reset if it is valid.  It is sent
+    // with the final assembly message.
+    if ((msgQueue.check != (uint8_t)~msgQueue.pending) ||
+        (msgQueue.pending & ~DATA_MSG_QUEUE_ALL)) {
+        msgQueue.pending = 0;
+        msgQueue.check = (uint8_t)~0;
+    }
+#endif
 }
 
 /**
@@ -87,29 +286,9 @@ void dataMsgMgr_exec(void) {
 
         dataMsgSm_t *dataMsgSmP = &msgData.dataMsgSm;
 
-        // If we are sending daily logs, then check if the data message state
-        // machine is done sending the current daily log.  If done, then we
-        // will get the next daily log, and start sending it.
-        if (msgData.sendDailyLogs && dataMsgSmP->sendCmdDone) {
-            uint8_t *dataP;
-            modemCmdWriteData_t *cmdWriteP = &dataMsgSmP->cmdWrite;
-            // Check if there is another daily log to send
-            // If so, it returns a non-zero value representing the length
-            uint16_t length = storageMgr_getNextDailyLogToTransmit(&dataP, msgData.weeklyLogNum);
-            if (length) {
-                // Update the data message state machine so that it will be
-                // in the correct state to send the next daily log.
-                dataMsgSm_sendAnotherDataMsg(dataMsgSmP);
-                // Update the data command object with info about the current
-                // daily log to send
-                cmdWriteP->cmd             = M_COMMAND_SEND_DATA;
-                cmdWriteP->payloadMsgId    = MSG_TYPE_DAILY;  /* the payload type */
-                cmdWriteP->payloadP        = dataP;   /* the payload pointer */
-                cmdWriteP->payloadLength   = length;  /* size of the payload in bytes */
-            } else {
-                msgData.sendDailyLogs = false;
-            }
-        }
+        // When the current message is sent, send the next message of
+        // the queue (the daily log backlog) in the same session.
+        sendNextQueued(dataMsgSmP);
 
         // Call the data message state machine to perform work
         dataMsgSm_stateMachine(dataMsgSmP);
@@ -118,6 +297,14 @@ void dataMsgMgr_exec(void) {
         // complete session
         if (dataMsgSmP->allDone) {
             msgData.sendDataMsgActive = false;
+#if (DATA_MSG_QUEUE==1)
+            if (queueSessionDone(dataMsgSmP)) {
+                // Send what was posted after the sending part of the session
+                startQueuedSession();
+            }
+#else
+            queueSessionDone(dataMsgSmP);
+#endif
             if (dataMsgSmP->connectTimeout) {
                 // Error case
                 // Check if this already was a retry
@@ -125,7 +312,11 @@ void dataMsgMgr_exec(void) {
                 if (msgData.retryCount < DATA_MSG_MAX_RETRIES) {
                     msgData.retryCount++;
                     msgData.sendDataMsgScheduled = true;
+#if (MODEM_COVERAGE_RETRY==1)
+                    msgData.secsTillTransmit = getRetryDelay(msgData.retryCount);
+#else
                     msgData.secsTillTransmit = DATA_MSG_DELAY_IN_SECONDS_TILL_RETX;
+#endif
                 }
             }
         }
@@ -137,12 +328,34 @@ void dataMsgMgr_exec(void) {
             // The sendWaterMsg function will clear the retryCount.
             // We need to save the current value so we can restore it.
             uint8_t retryCount = msgData.retryCount;
-            // Use the standard data msg API to initiate the retry.
-            // For retries, we assume the data is already stored in the modem
-            // from the original try. We only have to "kick" the modem with any
-            // type of M_COMMAND_SEND_DATA msg to get it to send out what it has
-            // stored in its FIFOs (once its connected to the network).
+#if (DATA_MSG_QUEUE==1)
+#if (MODEM_TRANSMIT_SPREAD==1)
+            // A session that waited for the transmit offset is no retry
+            bool retry = !msgData.spreadScheduled;
+            msgData.spreadScheduled = false;
+#else
+            bool retry = true;
+#endif
+            // Send the queue.  The entries of the failed session were not
+            // removed (and its daily logs not marked as transmitted).  With
+            // MODEM_ENERGY_BUDGET the session is scheduled again if the
+            // modem day budget is still used up.
+            msgData.sendDataMsgScheduled = false;
+            startQueuedSession();
+            if (retry && !msgData.sendDataMsgActive && !msgData.sendDataMsgScheduled) {
+                // Use the standard data msg API to initiate the retry.
+                // For retries, we assume the data is already stored in the modem
+                // from the original try. We only have to "kick" the modem with any
+                // type of M_COMMAND_SEND_DATA msg to get it to send out what it has
+                // stored in its FIFOs (once its connected to the network).
+                dataMsgMgr_sendDataMsg(MSG_TYPE_RETRYBYTE, NULL, 0);
+            }
+#else
+            // Use the standard data msg API to initiate the retry.  The
+            // daily logs of the failed session were not marked as
+            // transmitted, they are sent again by the next daily log send.
             dataMsgMgr_sendDataMsg(MSG_TYPE_RETRYBYTE, NULL, 0);
+#endif
             // Restore retryCount value.
             msgData.retryCount = retryCount;
         }
@@ -157,107 +370,497 @@ void dataMsgMgr_exec(void) {
 *  
 * \note If the modem does not connect to the network within a
 *       specified time frame (WAIT_FOR_LINK_UP_TIME_IN_SECONDS),
-*       then one retry will be scheduled for the future.
+*       then up to DATA_MSG_MAX_RETRIES retries will be scheduled
+*       for the future.
 * 
 * @param msgId The outpour message identifier
 * @param dataP Pointer to the data to send
 * @param lengthInBytes The length of the data to send.
 */
 bool dataMsgMgr_sendDataMsg(MessageType_t msgId, uint8_t *dataP, uint16_t lengthInBytes) {
-    dataMsgSm_t *dataMsgSmP = &msgData.dataMsgSm;
-
     // If already busy, just return.
     // Should never happen, but just in case.
     if (msgData.sendDataMsgActive || msgData.sendFaActive) {
         return false;
     }
 
-    // Note - a new data transmission will cancel any scheduled re-transmission
-
-    msgData.sendDataMsgActive = true;
-    msgData.sendDataMsgScheduled = false;
-    msgData.sendFaScheduled = false;
-    msgData.retryCount = 0;
-    msgData.secsTillTransmit = 0;
-
-    // Initialize the data msg object.
-    dataMsgSm_initForNewSession(dataMsgSmP);
-
-    // Initialize the data command object in the data object
-    dataMsgSmP->cmdWrite.cmd             = M_COMMAND_SEND_DATA;
-    dataMsgSmP->cmdWrite.payloadMsgId    = msgId;          /* the payload type */
-    dataMsgSmP->cmdWrite.payloadP        = dataP;          /* the payload pointer */
-    dataMsgSmP->cmdWrite.payloadLength   = lengthInBytes;  /* size of the payload in bytes */
-
-    // Call the state machine
-    dataMsgSm_stateMachine(dataMsgSmP);
+#if (MODEM_ENERGY_BUDGET==1)
+    if (deferOverBudget()) {
+        return true;
+    }
+#endif
 
+    initSessionQueue();
+#if (DATA_MSG_QUEUE==0)
+    // Only a daily log session goes on with the backlog
+    msgData.sendQueued = false;
+#endif
+    startSession(msgId, dataP, lengthInBytes);
     return true;
 }
 
 /**
  * 
- * \brief Inform the data message manager to start sending out 
- *        the daily logs of the current week.  This function
- *        will start the first daily log that needs to be sent.
- *        The function queries the storage module to get the
- *        next daily log to send.  Then initializes the command
- *        write structure and calls the data message state
- *        machine to start the transmit sequence.  The calls to
- *        get the remaining data logs for the week to send is
- *        done by the data message manager exec function.
+ * \brief Inform the data message manager to send out the daily
+ *        log backlog.  Posts the backlog to the outbound queue
+ *        and starts a session after the transmit offset if none
+ *        is in progress (without DATA_MSG_QUEUE, starts the
+ *        session unless one is in progress).  The
+ *        daily logs are sent oldest first, over all the weekly
+ *        logs.  The calls to get the remaining daily logs to
+ *        send is done by the data message manager exec function,
+ *        so the complete backlog (up to
+ *        DATA_MSG_MAX_DAILY_LOGS_PER_SESSION) is drained in one
+ *        modem session.  Pending minute flow captures and then
+ *        the event log are sent after the daily logs.
 * \ingroup PUBLIC_API
  * 
- * \param weeklyLogNum Which weekly log that the daily logs to
- *        send live in.
- * 
- * \return bool Returns false if the data message manager is 
- *         already busy transmitting and currently not
- *         available.
+ * \return bool With DATA_MSG_QUEUE always true: a session in 
+ *         progress sends the queued backlog after its current
+ *         message.  Otherwise false if a session is in progress.
  */
-bool dataMsgMgr_sendDailyLogs(uint8_t weeklyLogNum) {
+bool dataMsgMgr_sendDailyLogs(void) {
+#if (DATA_MSG_QUEUE==1)
+    queuePost(DATA_MSG_QUEUE_DAILY_LOGS);
+#if (MODEM_TRANSMIT_SPREAD==1)
+    spreadQueuedSession();
+#else
+    startQueuedSession();
+#endif
+#else
     uint8_t *dataP;
-    uint16_t length = 0;
+    MessageType_t msgId;
+    uint16_t length;
 
     // If already busy, just return.
-    // Should never happen, but just in case.
     if (msgData.sendDataMsgActive || msgData.sendFaActive) {
         return false;
     }
 
     // Get the first daily log to send.
-    length = storageMgr_getNextDailyLogToTransmit(&dataP, weeklyLogNum);
+    initSessionQueue();
+    length = getNextSessionPayload(&dataP, &msgId);
     if (length) {
-        dataMsgSm_t *dataMsgSmP = &msgData.dataMsgSm;
-        modemCmdWriteData_t *cmdWriteP = &dataMsgSmP->cmdWrite;
+        startSession(msgId, dataP, length);
+    }
+#endif
+    return true;
+}
+
+/**
+* \brief Send the check-in message (see getCheckinPayload).  Posts
+*        the check-in to the outbound queue and starts a session
+*        after the transmit offset if none is in progress (without
+*        DATA_MSG_QUEUE, starts the session unless one is in
+*        progress).
+* \ingroup PUBLIC_API
+* 
+* \return bool With DATA_MSG_QUEUE always true: a session in 
+*         progress sends the queued check-in after its current
+*         message.  Otherwise false if a session is in progress.
+*/
+bool dataMsgMgr_sendCheckin(void) {
+#if (DATA_MSG_QUEUE==1)
+    queuePost(DATA_MSG_QUEUE_CHECKIN);
+#if (MODEM_TRANSMIT_SPREAD==1)
+    spreadQueuedSession();
+#else
+    startQueuedSession();
+#endif
+    return true;
+#else
+    uint8_t *payloadP;
+    uint16_t length = getCheckinPayload(&payloadP);
+    return dataMsgMgr_sendDataMsg(MSG_TYPE_CHECKIN, payloadP, length);
+#endif
+}
 
-        // Note - a new data transmission will cancel any scheduled re-transmission
+/*************************
+ * Module Private Functions
+ ************************/
 
-        msgData.sendDataMsgActive = true;
-        msgData.sendDailyLogs = true;
-        msgData.sendDataMsgScheduled = false;
-        msgData.sendFaScheduled = false;
-        msgData.retryCount = 0;
-        msgData.secsTillTransmit = 0;
-        msgData.weeklyLogNum = weeklyLogNum;
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+* \brief If the modem day budget is used up, schedule the 
+*        session for later instead of starting it.  This replaces
+*        a scheduled retry.  The first deferral is logged (event
+*        payload 0).
+* 
+* @return bool True if the session was deferred.
+*/
+static bool deferOverBudget(void) {
+    if (!modemMgr_isDayBudgetExhausted()) {
+        msgData.budgetDeferred = false;
+        return false;
+    }
+    if (!msgData.budgetDeferred) {
+        msgData.budgetDeferred = true;
+#if (RECORD_EVENT_LOG==1)
+        storageMgr_logEvent(EVENT_MODEM_BUDGET, 0);
+#endif
+    }
+    msgData.retryCount = 0;
+    msgData.sendDataMsgScheduled = true;
+    msgData.secsTillTransmit = DATA_MSG_BUDGET_DEFER_IN_SECONDS;
+    return true;
+}
+#endif
 
-        // Initialize the data message object so its ready to
-        // start processing a new message.
-        dataMsgSm_initForNewSession(dataMsgSmP);
+#if (DATA_MSG_QUEUE==1)
+/**
+* \brief Start a session that sends the outbound queue.  Nothing 
+*        is started while a session is in progress or the final
+*        assembly message is scheduled: that session sends the
+*        queue after its own message.
+*/
+static void startQueuedSession(void) {
+    uint8_t *dataP;
+    MessageType_t msgId;
+    uint16_t length;
 
-        // Initialize the data command object used to communicate payload
-        // pointer and length to the data message manager.
-        cmdWriteP->cmd           = M_COMMAND_SEND_DATA;
-        cmdWriteP->payloadMsgId  = MSG_TYPE_DAILY;  /* the payload type */
-        cmdWriteP->payloadP      = dataP;   /* the payload pointer */
-        cmdWriteP->payloadLength = length;  /* size of the payload in bytes */
+    if (!msgQueue.pending ||
+        msgData.sendDataMsgActive || msgData.sendFaActive || msgData.sendFaScheduled) {
+        return;
+    }
 
-        // Call the data message state machine to perform work
-        dataMsgSm_stateMachine(dataMsgSmP);
+#if (MODEM_ENERGY_BUDGET==1)
+    if (deferOverBudget()) {
+        return;
     }
+#endif
+
+    // Get the first message to send.
+    initSessionQueue();
+    length = getNextSessionPayload(&dataP, &msgId);
+    if (length) {
+        startSession(msgId, dataP, length);
+    } else {
+        // Nothing to send (an empty backlog)
+        queueRemove(msgData.sessionMask);
+    }
+}
+#endif
+
+/**
+* \brief Start a data message session with its first message. 
+*        Shared by dataMsgMgr_sendDataMsg and startQueuedSession
+*        (dataMsgMgr_sendDailyLogs without DATA_MSG_QUEUE).
+* 
+* @param msgId The payload message type
+* @param dataP Pointer to the payload
+* @param length The length of the payload in bytes
+*/
+static void startSession(MessageType_t msgId, uint8_t *dataP, uint16_t length) {
+    dataMsgSm_t *dataMsgSmP = &msgData.dataMsgSm;
+
+    // Note - a new data transmission will cancel any scheduled re-transmission
+
+    msgData.sendDataMsgActive = true;
+    msgData.sendDataMsgScheduled = false;
+#if (MODEM_TRANSMIT_SPREAD==1)
+    msgData.spreadScheduled = false;
+#endif
+    msgData.sendFaScheduled = false;
+    msgData.retryCount = 0;
+    msgData.secsTillTransmit = 0;
+
+    // Initialize the data message object so its ready to
+    // start processing a new message.
+    dataMsgSm_initForNewSession(dataMsgSmP);
+    setPayload(&dataMsgSmP->cmdWrite, msgId, dataP, length);
+
+    // Call the data message state machine to perform work
+    dataMsgSm_stateMachine(dataMsgSmP);
+}
+
+/**
+* \brief Initialize the data command object used to communicate 
+*        the payload pointer and length to the data message
+*        state machine.
+* 
+* @param cmdWriteP The data command object
+* @param msgId The payload message type
+* @param dataP Pointer to the payload
+* @param length The length of the payload in bytes
+*/
+static void setPayload(modemCmdWriteData_t *cmdWriteP, MessageType_t msgId, uint8_t *dataP, uint16_t length) {
+    cmdWriteP->cmd           = M_COMMAND_SEND_DATA;
+    cmdWriteP->payloadMsgId  = msgId;   /* the payload type */
+    cmdWriteP->payloadP      = dataP;   /* the payload pointer */
+#if (DATA_MSG_MULTI_DAY==1)
+    cmdWriteP->payloadFuncP  = getPayloadFunc(msgId);
+#endif
+    cmdWriteP->payloadLength = length;  /* size of the payload in bytes */
+}
+
+#if (MODEM_TRANSMIT_SPREAD==1)
+/**
+* \brief Start a session that sends the outbound queue after the 
+*        transmit offset of the unit.  The offset replaces a
+*        scheduled retry (the new session sends what the retry
+*        would have).  A session in progress or already waiting
+*        for the offset sends the queue as it is.
+*/
+static void spreadQueuedSession(void) {
+    modemConfig_t config;
+    uint8_t minutes;
+    uint16_t offset;
+
+    if (msgData.spreadScheduled) {
+        return;
+    }
+    storageMgr_getModemConfig(&config);
+    minutes = config.transmitSpreadMinutes;
+    if (!minutes) {
+        minutes = DATA_MSG_SPREAD_DEFAULT_MINUTES;
+    }
+    offset = (minutes == DATA_MSG_SPREAD_OFF) ? 0 : modemMgr_getTransmitOffset((uint16_t)minutes * 60);
+    if (!offset || msgData.sendDataMsgActive || msgData.sendFaActive || msgData.sendFaScheduled) {
+        startQueuedSession();
+        return;
+    }
+    msgData.spreadScheduled = true;
+    msgData.sendDataMsgScheduled = true;
+    msgData.retryCount = 0;
+    msgData.secsTillTransmit = offset;
+}
+#endif
+
+/**
+* \brief Prepare to send the queue in a new session.
+*/
+static void initSessionQueue(void) {
+    msgData.sendQueued = true;
+#if (DATA_MSG_QUEUE==1)
+    msgData.sessionMask = 0;
+#endif
+    msgData.dailyLogCount = 0;
+    msgData.dailyLogMask = 0;
+#if (MINUTE_FLOW_CAPTURE==1)
+    msgData.minuteCaptureMask = 0;
+#endif
+#if (RECORD_EVENT_LOG==1)
+    msgData.eventLogCount = 0;
+#endif
+}
+
+/**
+* \brief When the data message state machine is done sending the 
+*        current message, set it up to send the next message of
+*        the queue in the same session.  Once the queue is empty,
+*        the session moves on (link wait, OTA messages).
+* 
+* @param dataMsgSmP The data message object of the session
+*/
+static void sendNextQueued(dataMsgSm_t *dataMsgSmP) {
+    if (msgData.sendQueued && dataMsgSmP->sendCmdDone) {
+        uint8_t *dataP;
+        MessageType_t msgId;
+        // Check if there is another message to send.  If so, it
+        // returns a non-zero value representing the length.
+        uint16_t length = getNextSessionPayload(&dataP, &msgId);
+        if (length) {
+            // Update the data message state machine so that it will be
+            // in the correct state to send the next message.
+            dataMsgSm_sendAnotherDataMsg(dataMsgSmP);
+            // Update the data command object with info about the
+            // message to send
+            setPayload(&dataMsgSmP->cmdWrite, msgId, dataP, length);
+        } else {
+            msgData.sendQueued = false;
+        }
+    }
+}
+
+/**
+* \brief Called when a session is done.  The daily logs of the 
+*        session are only marked as transmitted and the queue
+*        entries sent only removed if the session was successful.
+*        Otherwise they stay for the next session.
+* 
+* @param dataMsgSmP The data message object of the session
+* 
+* @return bool True if the session was successful.
+*/
+static bool queueSessionDone(dataMsgSm_t *dataMsgSmP) {
+    msgData.sendQueued = false;
+    if (dataMsgSmP->connectTimeout || dataMsgSmP->commError) {
+        return false;
+    }
+    storageMgr_markDailyLogsAsTransmitted(msgData.dailyLogMask);
+#if (MINUTE_FLOW_CAPTURE==1)
+    storageMgr_markMinuteCapturesAsTransmitted(msgData.minuteCaptureMask);
+#endif
+#if (RECORD_EVENT_LOG==1)
+    storageMgr_markEventLogAsTransmitted(msgData.eventLogCount);
+#endif
+#if (DATA_MSG_QUEUE==1)
+    queueRemove(msgData.sessionMask);
+#endif
     return true;
 }
 
+#if (DATA_MSG_QUEUE==1)
+/**
+* \brief Post an entry to the outbound queue.  An entry already 
+*        sent in the current session is sent again.
+* 
+* @param entry DATA_MSG_QUEUE_xxx
+*/
+static void queuePost(uint8_t entry) {
+    msgQueue.pending |= entry;
+    msgQueue.check = ~msgQueue.pending;
+    msgData.sessionMask &= ~entry;
+}
+
+/**
+* \brief Remove entries from the outbound queue.
+* 
+* @param entries DATA_MSG_QUEUE_xxx bits
+*/
+static void queueRemove(uint8_t entries) {
+    msgQueue.pending &= ~entries;
+    msgQueue.check = ~msgQueue.pending;
+}
+#endif
+
+/**
+* \brief Get the next payload of the queue in priority order: 
+*        the next daily logs of the backlog (a multi-day message
+*        or a daily log, up to DATA_MSG_MAX_DAILY_LOGS_PER_SESSION
+*        in the session), the pending minute
+*        flow captures and the events in batches, then the
+*        check-in message (only with DATA_MSG_QUEUE).  Updates the
+*        session masks.
+* 
+* @param dataPP Filled in with the payload pointer (NULL for a 
+*               multi-day message, see getPayloadFunc)
+* @param msgIdP Filled in with the payload message type
+* 
+* @return uint16_t Size of the payload, zero if there is nothing
+*         left to send in this session.
+*/
+static uint16_t getNextSessionPayload(uint8_t **dataPP, MessageType_t *msgIdP) {
+    uint16_t length = 0;
+#if (DATA_MSG_QUEUE==1)
+    uint8_t todo = msgQueue.pending & ~msgData.sessionMask;
+
+    if (todo & DATA_MSG_QUEUE_DAILY_LOGS) {
+#else
+    {
+#endif
+#if (DATA_MSG_MULTI_DAY==1)
+        uint8_t maxDays = DATA_MSG_MAX_DAILY_LOGS_PER_SESSION - msgData.dailyLogCount;
+        uint8_t numDays;
+        if (maxDays > DATA_MSG_MAX_DAYS_PER_MSG) {
+            maxDays = DATA_MSG_MAX_DAYS_PER_MSG;
+        }
+        length = storageMgr_getNextMultiDayToTransmit(&msgData.dailyLogMask, maxDays, &numDays);
+        if (length) {
+            // The payload is read with storageMgr_getMultiDaySegment
+            msgData.dailyLogCount += numDays;
+            *dataPP = NULL;
+            *msgIdP = MSG_TYPE_MULTI_DAY;
+        } else {
+#else
+        if (msgData.dailyLogCount < DATA_MSG_MAX_DAILY_LOGS_PER_SESSION) {
+            length = storageMgr_getNextDailyLogToTransmit(dataPP, &msgData.dailyLogMask);
+        }
+        if (length) {
+            msgData.dailyLogCount++;
+            *msgIdP = MSG_TYPE_DAILY;
+        } else {
+#endif
+#if (MINUTE_FLOW_CAPTURE==1)
+            length = storageMgr_getNextMinuteCaptureToTransmit(dataPP, &msgData.minuteCaptureMask);
+            *msgIdP = MSG_TYPE_MINUTE_FLOW;
+#endif
+#if (RECORD_EVENT_LOG==1)
+            if (!length) {
+                length = storageMgr_getNextEventLogToTransmit(dataPP, &msgData.eventLogCount);
+                *msgIdP = MSG_TYPE_EVENT_LOG;
+            }
+#endif
+        }
+#if (DATA_MSG_QUEUE==1)
+        if (!length) {
+            msgData.sessionMask |= DATA_MSG_QUEUE_DAILY_LOGS;
+        }
+#endif
+    }
+#if (DATA_MSG_QUEUE==1)
+    if (!length && (todo & DATA_MSG_QUEUE_CHECKIN)) {
+        length = getCheckinPayload(dataPP);
+        *msgIdP = MSG_TYPE_CHECKIN;
+        msgData.sessionMask |= DATA_MSG_QUEUE_CHECKIN;
+    }
+#endif
+    return length;
+}
+
+/**
+* \brief Prepare the check-in message in the shared buffer: the 
+*        standard message header followed, with
+*        MODEM_ENERGY_BUDGET, by the modem energy budget use
+*        (modemMgr_getBudgetReport) and, with
+*        MODEM_COVERAGE_RETRY, the coverage profile
+*        (modemMgr_getCoverageReport).
+* 
+* @param dataPP Filled in with the payload pointer
+* 
+* @return uint16_t Size of the payload
+*/
+static uint16_t getCheckinPayload(uint8_t **dataPP) {
+    uint16_t length;
+    // Get the shared buffer (we borrow the ota buffer)
+    uint8_t *payloadP = modemMgr_getSharedBuffer();
+    // Fill in the buffer with the standard message header
+    length = storageMgr_prepareMsgHeader(payloadP);
+#if (MODEM_ENERGY_BUDGET==1)
+    length += modemMgr_getBudgetReport(&payloadP[length]);
+#endif
+#if (MODEM_COVERAGE_RETRY==1)
+    length += modemMgr_getCoverageReport(&payloadP[length]);
+#endif
+    *dataPP = payloadP;
+    return length;
+}
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+* \brief Get the payload function of a message: the segments of 
+*        a multi-day message are read from flash by the modem
+*        command module.
+* 
+* @param msgId The payload message type
+* 
+* @return modemCmdPayloadFunc_t The payload function, NULL if 
+*         the payload is in one buffer.
+*/
+static modemCmdPayloadFunc_t getPayloadFunc(MessageType_t msgId) {
+    return (msgId == MSG_TYPE_MULTI_DAY) ? storageMgr_getMultiDaySegment : NULL;
+}
+#endif
+
+#if (MODEM_COVERAGE_RETRY==1)
+/**
+* \brief Compute the delay of a retry: exponential backoff 
+*        toward the hour with the best coverage, plus jitter.
+* 
+* @param retryCount The retry number, starting at 1
+* 
+* @return uint16_t The delay in seconds
+*/
+static uint16_t getRetryDelay(uint8_t retryCount) {
+    uint16_t backoff = DATA_MSG_RETRY_BACKOFF_IN_SECONDS << (retryCount - 1);
+    uint16_t delay = modemMgr_getCoverageRetryDelay(backoff, backoff << 1);
+    // The low bits of the fine tick at the end of a session are
+    // random enough to spread the units of a site.
+    delay += (uint16_t)getFineTicksSinceBoot() % DATA_MSG_RETRY_JITTER_IN_SECONDS;
+    return delay;
+}
+#endif
+
 /*******************************************************************************/
 /*******************************************************************************/
 
@@ -340,18 +943,17 @@ void fassMsgMgr_exec(void) {
             // Initialize the data msg object that is used to communicate
             // with the data message state machine.
             dataMsgSm_initForNewSession(dataMsgSmP);
+#if (DATA_MSG_QUEUE==1)
+            // The outbound queue is sent after the final assembly message
+            initSessionQueue();
+#endif
 
             // Initialize the data command object in the data object
-            dataMsgSmP->cmdWrite.cmd             = M_COMMAND_SEND_DATA;
             // Only send a final assembly for the first message
             // Otherwise send a checkin message
-            if (msgData.retryCount > 0 ) {
-                dataMsgSmP->cmdWrite.payloadMsgId    = MSG_TYPE_CHECKIN;   /* the payload type */
-            } else {
-                dataMsgSmP->cmdWrite.payloadMsgId    = MSG_TYPE_FA;        /* the payload type */
-            }
-            dataMsgSmP->cmdWrite.payloadP        = payloadP;      /* the payload pointer */
-            dataMsgSmP->cmdWrite.payloadLength   = payloadSize;   /* size of the payload in bytes */
+            setPayload(&dataMsgSmP->cmdWrite,
+                       (msgData.retryCount > 0) ? MSG_TYPE_CHECKIN : MSG_TYPE_FA,
+                       payloadP, payloadSize);
         }
     }
 
@@ -360,6 +962,10 @@ void fassMsgMgr_exec(void) {
     if (msgData.sendFaActive) {
         // Get the pointer to the dataMsg object
         dataMsgSm_t *dataMsgSmP = &msgData.dataMsgSm;
+#if (DATA_MSG_QUEUE==1)
+        // Send the queue after the final assembly message
+        sendNextQueued(dataMsgSmP);
+#endif
         // Run the dataMsg state machine
         dataMsgSm_stateMachine(dataMsgSmP);
         // Check if state machine has completed sending
@@ -373,6 +979,14 @@ void fassMsgMgr_exec(void) {
             } else {
                 msgData.sendFaScheduled = false;
             }
+#if (DATA_MSG_QUEUE==1)
+            // Remove what was sent from the queue.  If the final assembly
+            // message is not repeated, start a session for what is left.
+            queueSessionDone(dataMsgSmP);
+            if (!msgData.sendFaScheduled) {
+                startQueuedSession();
+            }
+#endif
 
             // Update the Application Record after sending the first FA packet.
             // The record is written by the Application and used by the
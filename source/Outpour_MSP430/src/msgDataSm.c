@@ -19,6 +19,10 @@
  *        sequence to complete.
  * \li    DMSG_STATE_WAIT_FOR_LINK:  Wait for the modem to get 
  *        connected to the Network.  
+ * \li    DMSG_STATE_REFRESH_STATUS:  Refresh the modem status if 
+ *        the data was sent without it (lean batch job, MODEM_LEAN_BATCH).
+ * \li    DMSG_STATE_REFRESH_STATUS_WAIT:  Wait for the status 
+ *        refresh to complete.
  * \li    DMSG_STATE_PROCESS_OTA:  Start processing OTA messages 
  *        (if any are present).
  * \li    DMSG_STATE_PROCESS_OTA_WAIT:  wait for OTA message 
@@ -110,6 +114,10 @@ void dataMsgSm_sendAnotherDataMsg(dataMsgSm_t *dataMsgP) {
 *        sequence to complete.
 * \li    DMSG_STATE_WAIT_FOR_LINK:  Wait for the modem to get 
 *        connected to the Network.  
+* \li    DMSG_STATE_REFRESH_STATUS:  Refresh the modem status if 
+*        the data was sent without it (lean batch job, MODEM_LEAN_BATCH).
+* \li    DMSG_STATE_REFRESH_STATUS_WAIT:  Wait for the status 
+*        refresh to complete.
 * \li    DMSG_STATE_PROCESS_OTA:  Start processing OTA messages 
 *        (if any are present).
 * \li    DMSG_STATE_PROCESS_OTA_WAIT:  wait for OTA message 
@@ -125,6 +133,27 @@ void dataMsgSm_sendAnotherDataMsg(dataMsgSm_t *dataMsgP) {
 */
 void dataMsgSm_stateMachine(dataMsgSm_t *dataMsgP) {
     bool continue_processing = false;
+
+#if (MODEM_ENERGY_BUDGET==1)
+    // Cut the session when the modem has been on for the session
+    // budget.  Data sent before the link was up is not known to be
+    // delivered, so it is treated as a comm error (kept for the
+    // next session, no retry).  Event payload 1 is a session cut.
+    if ((dataMsgP->dataMsgState > DMSG_STATE_GRAB) &&
+        (dataMsgP->dataMsgState < DMSG_STATE_RELEASE) &&
+        modemMgr_isSessionBudgetExhausted()) {
+        if (dataMsgP->dataMsgState <= DMSG_STATE_WAIT_FOR_LINK) {
+            dataMsgP->commError = true;
+        }
+        otaMsgMgr_stopOtaProcessing();
+        modemMgr_stopModemCmdBatch();
+#if (RECORD_EVENT_LOG==1)
+        storageMgr_logEvent(EVENT_MODEM_BUDGET, 1);
+#endif
+        dataMsgP->dataMsgState = DMSG_STATE_RELEASE;
+    }
+#endif
+
     do {
         continue_processing = false;
         switch (dataMsgP->dataMsgState) {
@@ -139,13 +168,28 @@ void dataMsgSm_stateMachine(dataMsgSm_t *dataMsgP) {
             break;
         case DMSG_STATE_WAIT_FOR_MODEM_UP:
             if (modemMgr_isModemUp()) {
+#if (MODEM_LEAN_BATCH==1)
+                dataMsgP->cmdWrite.batchProfile = MODEM_BATCH_FULL;
+#endif
                 dataMsgP->dataMsgState = DMSG_STATE_SEND_MSG;
                 continue_processing = true;
             }
             break;
         case DMSG_STATE_SEND_MSG:
-            dataMsgP->cmdWrite.statusOnly = false;
+#if (MODEM_LEAN_BATCH==1)
+            // The first job after the modem power up is a full job.
+            // After that the data is sent alone and modemMgr adds the
+            // status commands when the last status is stale.
+            if (dataMsgP->cmdWrite.batchProfile == MODEM_BATCH_STATUS_ONLY) {
+                dataMsgP->cmdWrite.batchProfile = MODEM_BATCH_DATA_ONLY;
+            }
             modemMgr_sendModemCmdBatch(&dataMsgP->cmdWrite);
+            dataMsgP->cmdWrite.batchProfile = MODEM_BATCH_DATA_ONLY;
+#else
+            // Every data job is a full job
+            dataMsgP->cmdWrite.batchProfile = MODEM_BATCH_FULL;
+            modemMgr_sendModemCmdBatch(&dataMsgP->cmdWrite);
+#endif
             dataMsgP->dataMsgState = DMSG_STATE_SEND_MSG_WAIT;
             break;
         case DMSG_STATE_SEND_MSG_WAIT:
@@ -177,7 +221,11 @@ void dataMsgSm_stateMachine(dataMsgSm_t *dataMsgP) {
                 if (modemMgr_isLinkUp()) {
                     // We are done - message sent correctly.
                     // Move to retrieving any OTA Messages.
+#if (MODEM_LEAN_BATCH==1)
+                    dataMsgP->dataMsgState = DMSG_STATE_REFRESH_STATUS;
+#else
                     dataMsgP->dataMsgState = DMSG_STATE_PROCESS_OTA;
+#endif
                 } else {
                     // modem not connected to network yet.
                     dataMsgP->dataMsgState = DMSG_STATE_WAIT_FOR_LINK;
@@ -201,12 +249,34 @@ void dataMsgSm_stateMachine(dataMsgSm_t *dataMsgP) {
             } else {
                 // While waiting for the modem link to come up,
                 // resend the command to retrieve status only.
-                dataMsgP->cmdWrite.statusOnly = true;
+                dataMsgP->cmdWrite.batchProfile = MODEM_BATCH_STATUS_ONLY;
                 modemMgr_sendModemCmdBatch(&dataMsgP->cmdWrite);
                 dataMsgP->dataMsgState = DMSG_STATE_SEND_MSG_WAIT;
             }
             continue_processing = true;
             break;
+#if (MODEM_LEAN_BATCH==1)
+        case DMSG_STATE_REFRESH_STATUS:
+            // The number of OTA messages is from the last status.  If
+            // the data was sent without it and it is stale, refresh it.
+            if (modemMgr_isStatusStale()) {
+                dataMsgP->cmdWrite.batchProfile = MODEM_BATCH_STATUS_ONLY;
+                modemMgr_sendModemCmdBatch(&dataMsgP->cmdWrite);
+                dataMsgP->dataMsgState = DMSG_STATE_REFRESH_STATUS_WAIT;
+            } else {
+                dataMsgP->dataMsgState = DMSG_STATE_PROCESS_OTA;
+                continue_processing = true;
+            }
+            break;
+        case DMSG_STATE_REFRESH_STATUS_WAIT:
+            // Status commands do not report comm errors, a failed
+            // refresh keeps the last number of OTA messages.
+            if (modemMgr_isModemCmdComplete()) {
+                dataMsgP->dataMsgState = DMSG_STATE_PROCESS_OTA;
+                continue_processing = true;
+            }
+            break;
+#endif
         case DMSG_STATE_PROCESS_OTA:
             if (modemMgr_getNumOtaMsgsPending()) {
                 otaMsgMgr_getAndProcessOtaMsgs();
@@ -7,6 +7,14 @@
  * the ota state machine to retrieve OTA messages from the modem
  * and process them. 
  *  
+ * \note Each OTA message is fetched with one partial read of
+ *       OTA_READ_LENGTH bytes, which holds every message but the
+ *       firmware upgrade (only its header is needed).  The read,
+ *       the reply and the delete are sent as command only modem
+ *       batch jobs - no ping or status per step.  The number of
+ *       messages pending is counted down locally and the message
+ *       status is refreshed once, when the count reaches zero, to
+ *       pick up messages that arrived in the meantime.
  */
 #include "outpour.h"
 
@@ -14,6 +22,21 @@
  * Module Data Definitions
  **************************/
 
+/**
+ * \def OTA_READ_LENGTH
+ * \brief The size of the partial read of an OTA message.  The 
+ *        modem response must fit in the modem cmd receive
+ *        buffer.
+ */
+#define OTA_READ_LENGTH ((uint8_t)(ISR_BUF_SIZE - MODEM_PARTIAL_RESP_OVERHEAD))
+
+/**
+ * \def OTA_MAX_MSGS_PER_SESSION
+ * \brief The most OTA messages processed per session (for 
+ *        protection).
+ */
+#define OTA_MAX_MSGS_PER_SESSION ((uint8_t)50)
+
 /**
  * \typedef otaState_t
  * \brief Specify the states for retrieving an OTA msg from the 
@@ -21,16 +44,15 @@
  */
 typedef enum otaState_e {
     OTA_STATE_IDLE,
-    OTA_STATE_SEND_OTA_CMD_PHASE0,
-    OTA_STATE_OTA_CMD_PHASE0_WAIT,
-    OTA_STATE_PROCESS_OTA_CMD_PHASE0,
-    OTA_STATE_SEND_OTA_CMD_PHASE1,
-    OTA_STATE_OTA_CMD_PHASE1_WAIT,
-    OTA_STATE_PROCESS_OTA_CMD_PHASE1,
+    OTA_STATE_SEND_OTA_READ_CMD,
+    OTA_STATE_OTA_READ_CMD_WAIT,
+    OTA_STATE_PROCESS_OTA_MSG,
     OTA_STATE_SEND_DELETE_OTA_CMD,
     OTA_STATE_DELETE_OTA_CMD_WAIT,
     OTA_STATE_SEND_OTA_ACK,
     OTA_STATE_SEND_OTA_ACK_WAIT,
+    OTA_STATE_SEND_STATUS_CMD,
+    OTA_STATE_STATUS_CMD_WAIT,
     OTA_STATE_DONE,
 } otaState_t;
 
@@ -43,6 +65,7 @@ typedef struct otaData_s {
     bool active;                   /**< Identifies that OTA message processing is in progress  */
     otaState_t otaState;           /**< current state */
     uint8_t totalMsgsProcessed;    /**< count of messages processed per session */
+    uint8_t msgsPending;           /**< messages left in the modem since the last status */
     modemCmdWriteData_t cmdWrite;  /**< A pointer to a modem write cmd bject */
     bool fwUpgradeMessageReceived; /**< Identify the special fw upgrade message */
     uint8_t gmtBinSecondsOffset;   /**< value from gmt update msg candidate */
@@ -70,7 +93,6 @@ otaData_t otaData;
  ************************/
 static void otaMsgMgr_stateMachine(void);
 static bool otaMsgMgr_processOtaMsg(void);
-static uint8_t otaMsgMgr_getOtaLength(void);
 static bool otaMsgMgr_processGmtClocksetPart1(otaResponse_t *otaRespP);
 static void otaMsgMgr_processGmtClocksetPart2(void);
 static bool otaMsgMgr_processLocalOffset(otaResponse_t *otaRespP);
@@ -80,9 +102,18 @@ static bool otaMsgMgr_processActivateDevice(otaResponse_t *otaRespP);
 static bool otaMsgMgr_processSilenceDevice(otaResponse_t *otaRespP);
 static bool otaMsgMgr_processFirmwareUpgrade(otaResponse_t *otaRespP);
 static bool otaMsgMgr_processResetDevice(otaResponse_t *otaRespP);
-static void sendPhase0_OtaCommand(void);
-static void sendPhase1_OtaCommand(uint8_t lengthInBytes);
+#if (MINUTE_FLOW_CAPTURE==1)
+static bool otaMsgMgr_processMinuteCapture(otaResponse_t *otaRespP);
+#endif
+#if (MODEM_ENERGY_BUDGET==1)
+static bool otaMsgMgr_processModemBudget(otaResponse_t *otaRespP);
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+static bool otaMsgMgr_processTransmitSpread(otaResponse_t *otaRespP);
+#endif
+static void sendRead_OtaCommand(void);
 static void sendDelete_OtaCommand(void);
+static void sendStatus_OtaCommand(void);
 
 /***************************
  * Module Public Functions
@@ -122,8 +153,9 @@ void otaMsgMgr_init(void) {
 */
 void otaMsgMgr_getAndProcessOtaMsgs(void) {
     otaData.active = true;
-    otaData.otaState = OTA_STATE_SEND_OTA_CMD_PHASE0;
+    otaData.otaState = OTA_STATE_SEND_OTA_READ_CMD;
     otaData.totalMsgsProcessed = 0;
+    otaData.msgsPending = modemMgr_getNumOtaMsgsPending();
     otaData.lastGmtUpdateMsgId = 0;
     otaData.gmtTimeUpdateCandidate = false;
     otaMsgMgr_stateMachine();
@@ -161,49 +193,44 @@ bool otaMsgMgr_isOtaProcessingDone(void) {
  ************************/
 
 /**
-* \brief Helper function to send a "reconnaissance" get incoming
-*        partial cmd to the modem.  The payloadLength is set to
-*        zero, as we are just interested in finding out how big
-*        the message is before requesting the full message.
+* \brief Helper function to send a get incoming partial cmd to 
+*        the modem to retrieve the OTA Messsage.  The modem
+*        returns the whole message when it is not longer than
+*        OTA_READ_LENGTH.
 */
-static void sendPhase0_OtaCommand(void) {
+static void sendRead_OtaCommand(void) {
+    otaData.totalMsgsProcessed++;
     memset(&otaData.cmdWrite, 0, sizeof(modemCmdWriteData_t));
     otaData.cmdWrite.cmd = M_COMMAND_GET_INCOMING_PARTIAL;
-    otaData.cmdWrite.payloadLength = 0;
+    otaData.cmdWrite.batchProfile = MODEM_BATCH_CMD_ONLY;
+    otaData.cmdWrite.payloadLength = OTA_READ_LENGTH;
     otaData.cmdWrite.payloadOffset = 0;
     modemMgr_sendModemCmdBatch(&otaData.cmdWrite);
 }
 
 /**
-* \brief Helper function to send a get incoming parital cmd to 
-*        the modem to retrieve the OTA Messsage.
+* \brief Helper function to send a delete partial command to the 
+*        modem.
 * 
-* @param lengthInBytes Pre-determined length in bytes of the OTA 
-*                      message as found from the reconnaissance
-*                      get incoming partial message previously sent.
 */
-static void sendPhase1_OtaCommand(uint8_t lengthInBytes) {
-    otaData.totalMsgsProcessed++;
+static void sendDelete_OtaCommand(void) {
     memset(&otaData.cmdWrite, 0, sizeof(modemCmdWriteData_t));
-    otaData.cmdWrite.cmd = M_COMMAND_GET_INCOMING_PARTIAL;
-    otaData.cmdWrite.payloadLength = lengthInBytes;
-    otaData.cmdWrite.payloadOffset = 0;
+    otaData.cmdWrite.cmd = M_COMMAND_DELETE_INCOMING;
+    otaData.cmdWrite.batchProfile = MODEM_BATCH_CMD_ONLY;
     modemMgr_sendModemCmdBatch(&otaData.cmdWrite);
 }
 
 /**
-* \brief Helper function to send a delete partial command to the 
-*        modem.
-* 
+* \brief Helper function to refresh the modem status and message 
+*        status once the messages counted are processed.
 */
-static void sendDelete_OtaCommand(void) {
+static void sendStatus_OtaCommand(void) {
     memset(&otaData.cmdWrite, 0, sizeof(modemCmdWriteData_t));
-    otaData.cmdWrite.cmd = M_COMMAND_DELETE_INCOMING;
+    otaData.cmdWrite.batchProfile = MODEM_BATCH_STATUS_ONLY;
     modemMgr_sendModemCmdBatch(&otaData.cmdWrite);
 }
 
 static void otaMsgMgr_stateMachine(void) {
-    uint8_t otaMsgByteLength = 0;
     bool continue_processing = false;
     do {
         continue_processing = false;
@@ -212,50 +239,27 @@ static void otaMsgMgr_stateMachine(void) {
             break;
 
             /** 
-             * PHASE 0 - send a "reconnaissance" get incoming partial cmd to the modem.
-             * The payloadLength is set to zero, as we are just interested in finding out
-             *  how big the message is before requesting the full message.
+             * Send a get incoming partial cmd to the modem to retrieve the
+             * OTA message (header and payload) in one read.
              */
-        case OTA_STATE_SEND_OTA_CMD_PHASE0:
-            sendPhase0_OtaCommand();
-            otaData.otaState = OTA_STATE_OTA_CMD_PHASE0_WAIT;
+        case OTA_STATE_SEND_OTA_READ_CMD:
+            sendRead_OtaCommand();
+            otaData.otaState = OTA_STATE_OTA_READ_CMD_WAIT;
             break;
-        case OTA_STATE_OTA_CMD_PHASE0_WAIT:
+        case OTA_STATE_OTA_READ_CMD_WAIT:
             if (modemMgr_isModemCmdError()) {
                 otaData.otaState = OTA_STATE_SEND_DELETE_OTA_CMD;
                 continue_processing = true;
             } else if (modemMgr_isModemCmdComplete()) {
-                otaData.otaState = OTA_STATE_PROCESS_OTA_CMD_PHASE0;
+                otaData.otaState = OTA_STATE_PROCESS_OTA_MSG;
                 continue_processing = true;
             }
             break;
-        case OTA_STATE_PROCESS_OTA_CMD_PHASE0:
-            otaMsgByteLength = otaMsgMgr_getOtaLength();
-            otaData.otaState = otaMsgByteLength ?
-                OTA_STATE_SEND_OTA_CMD_PHASE1 : OTA_STATE_SEND_DELETE_OTA_CMD;
-            continue_processing = true;
-            break;
-
-            /**
-             * PHASE 1 - send an incoming partial cmd to the modem to retrieve
-             * the OTA message.  The length was previously determined in phase 0.
-             */
-        case OTA_STATE_SEND_OTA_CMD_PHASE1:
-            sendPhase1_OtaCommand(otaMsgByteLength);
-            otaData.otaState = OTA_STATE_OTA_CMD_PHASE1_WAIT;
-            break;
-        case OTA_STATE_OTA_CMD_PHASE1_WAIT:
-            if (modemMgr_isModemCmdError()) {
-                otaData.otaState = OTA_STATE_SEND_DELETE_OTA_CMD;
-                continue_processing = true;
-            } else if (modemMgr_isModemCmdComplete()) {
-                otaData.otaState = OTA_STATE_PROCESS_OTA_CMD_PHASE1;
-                continue_processing = true;
-            }
-            break;
-        case OTA_STATE_PROCESS_OTA_CMD_PHASE1:
+        case OTA_STATE_PROCESS_OTA_MSG:
             {
-                bool otaMsgSuccess = otaMsgMgr_processOtaMsg();
+                // An empty message is just deleted
+                bool otaMsgSuccess = modemMgr_getLastOtaResponse()->lengthInBytes &&
+                    otaMsgMgr_processOtaMsg();
                 otaData.otaState = otaMsgSuccess ?
                     OTA_STATE_SEND_OTA_ACK : OTA_STATE_SEND_DELETE_OTA_CMD;
                 continue_processing = true;
@@ -266,6 +270,7 @@ static void otaMsgMgr_stateMachine(void) {
              * Send the OTA Reply
              */
         case OTA_STATE_SEND_OTA_ACK:
+            otaData.cmdWrite.batchProfile = MODEM_BATCH_CMD_ONLY;
             modemMgr_sendModemCmdBatch(&otaData.cmdWrite);
             otaData.otaState = OTA_STATE_SEND_OTA_ACK_WAIT;
             break;
@@ -293,17 +298,42 @@ static void otaMsgMgr_stateMachine(void) {
             if (modemMgr_isModemCmdError()) {
                 otaData.otaState = OTA_STATE_DONE;
             } else if (modemMgr_isModemCmdComplete()) {
+                if (otaData.msgsPending) {
+                    otaData.msgsPending--;
+                }
                 // If there is another OTA message, it should be processed
-                // unless we have reached the limit (for protection).
-                if (modemMgr_getNumOtaMsgsPending() && (otaData.totalMsgsProcessed < 50)) {
-                    otaData.otaState = OTA_STATE_SEND_OTA_CMD_PHASE0;
-                } else {
+                // unless we have reached the limit (for protection).  Once
+                // the messages counted are done, refresh the status to pick
+                // up any that arrived since.
+                if (otaData.totalMsgsProcessed >= OTA_MAX_MSGS_PER_SESSION) {
                     otaData.otaState = OTA_STATE_DONE;
+                } else if (otaData.msgsPending) {
+                    otaData.otaState = OTA_STATE_SEND_OTA_READ_CMD;
+                } else {
+                    otaData.otaState = OTA_STATE_SEND_STATUS_CMD;
                 }
                 continue_processing = true;
             }
             break;
 
+            /**
+             * Refresh the message status
+             */
+        case OTA_STATE_SEND_STATUS_CMD:
+            sendStatus_OtaCommand();
+            otaData.otaState = OTA_STATE_STATUS_CMD_WAIT;
+            break;
+        case OTA_STATE_STATUS_CMD_WAIT:
+            if (modemMgr_isModemCmdError()) {
+                otaData.otaState = OTA_STATE_DONE;
+            } else if (modemMgr_isModemCmdComplete()) {
+                otaData.msgsPending = modemMgr_getNumOtaMsgsPending();
+                otaData.otaState = otaData.msgsPending ?
+                    OTA_STATE_SEND_OTA_READ_CMD : OTA_STATE_DONE;
+                continue_processing = true;
+            }
+            break;
+
         case OTA_STATE_DONE:
             otaData.active = false;
             // If there is a GMT update candidate, apply it now.
@@ -367,11 +397,17 @@ static void otaMsgMgr_processGmtClocksetPart2(void) {
     if (!otaData.gmtTimeHasBeenUpdated && otaData.gmtTimeUpdateCandidate) {
 
         // Note - the times are in binary/hex values
+#if (GMT_CLOCKSET_ONE_STEP==0)
         uint16_t i;
+#endif
         uint16_t mask;
 
         // Disable the timer interrupt while we are updating the time.
         mask = getAndDisableSysTimerInterrupt();
+#if (GMT_CLOCKSET_ONE_STEP==1)
+        advanceBinTime(otaData.gmtBinDaysOffset, otaData.gmtBinHoursOffset,
+                       otaData.gmtBinMinutesOffset, otaData.gmtBinSecondsOffset);
+#else
         for (i = 0; i < otaData.gmtBinSecondsOffset; i++) {
             incrementSeconds();
         }
@@ -384,11 +420,17 @@ static void otaMsgMgr_processGmtClocksetPart2(void) {
         for (i = 0; i < otaData.gmtBinDaysOffset; i++) {
             incrementDays();
         }
+#endif
         // Restore timer interrupt
         restoreSysTimerInterrupt(mask);
 
         otaData.gmtTimeHasBeenUpdated = true;
         otaData.gmtTimeUpdateCandidate = false;
+
+#if (RECORD_EVENT_LOG==1)
+        // Payload is the number of days the clock was advanced
+        storageMgr_logEvent(EVENT_GMT_UPDATE, (otaData.gmtBinDaysOffset > 0xFF) ? 0xFF : otaData.gmtBinDaysOffset);
+#endif
     }
 }
 
@@ -506,23 +548,61 @@ static bool otaMsgMgr_processResetDevice(otaResponse_t *otaRespP) {
     return sysExec_startRebootCountdown(&otaRespP->buf[3]);
 }
 
+#if (MINUTE_FLOW_CAPTURE==1)
 /**
-* \brief Get the length of an OTA message. 
+* \brief Process Minute Capture OTA command.  Arms (or stops) 
+*        the minute flow capture: mode, three bytes of hour bits
+*        and the scale.  A request that arms more hours than a
+*        weekly log holds is rejected, nothing is changed.
+* 
+* @param otaRespP Pointer to the response data and other info
+*                 received from the modem.
 *
-* @return uint8_t length in bytes.
+* @return bool True if successful
 */
-static uint8_t otaMsgMgr_getOtaLength(void) {
-    // Get the object that contains the OTA message data and info
-    otaResponse_t *otaRespP = modemMgr_getLastOtaResponse();
-    uint8_t bytes = otaRespP->remainingInBytes;
-    // The only message that is longer than the OTA buffer size
-    // is the upgrade message.  For that, we only need to identify
-    // that we received it.  It will be processed in the bootloader.
-    if (bytes > OTA_PAYLOAD_BUF_LENGTH) {
-        bytes = 16;
-    }
-    return bytes;
+static bool otaMsgMgr_processMinuteCapture(otaResponse_t *otaRespP) {
+    return storageMgr_setMinuteCaptureConfig(&otaRespP->buf[3]);
+}
+#endif
+
+#if (MODEM_ENERGY_BUDGET==1)
+/**
+* \brief Process Modem Budget OTA command.  Sets the modem on 
+*        time budget per session and per rolling day in minutes
+*        and the modem hold time after a session in seconds.
+*        Used from the next session on.
+* 
+* @param otaRespP Pointer to the response data and other info
+*                 received from the modem.
+*
+* @return bool True if successful
+*/
+static bool otaMsgMgr_processModemBudget(otaResponse_t *otaRespP) {
+    return modemMgr_setBudgetConfig(&otaRespP->buf[3]);
+}
+#endif
+
+#if (MODEM_TRANSMIT_SPREAD==1)
+/**
+* \brief Process Transmit Spread OTA command.  Sets the window in 
+*        minutes over which the units spread their scheduled
+*        transmissions (see dataMsgMgr_sendDailyLogs).  Zero
+*        restores the default, 0xFF sends at the storage time.
+*        Used from the next transmission on.
+* 
+* @param otaRespP Pointer to the response data and other info
+*                 received from the modem.
+*
+* @return bool True if successful
+*/
+static bool otaMsgMgr_processTransmitSpread(otaResponse_t *otaRespP) {
+    modemConfig_t config;
+    storageMgr_getModemConfig(&config);
+    config.transmitSpreadMinutes = otaRespP->buf[3];
+    storageMgr_setModemConfig(&config);
+    return true;
 }
+#endif
 
 /**
 * \brief Process OTA commands.  
@@ -561,6 +641,21 @@ static bool otaMsgMgr_processOtaMsg(void) {
     case OTA_OPCODE_RESET_DEVICE:
         success = otaMsgMgr_processResetDevice(otaRespP);
         break;
+#if (MINUTE_FLOW_CAPTURE==1)
+    case OTA_OPCODE_MINUTE_CAPTURE:
+        success = otaMsgMgr_processMinuteCapture(otaRespP);
+        break;
+#endif
+#if (MODEM_ENERGY_BUDGET==1)
+    case OTA_OPCODE_MODEM_BUDGET:
+        success = otaMsgMgr_processModemBudget(otaRespP);
+        break;
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+    case OTA_OPCODE_TRANSMIT_SPREAD:
+        success = otaMsgMgr_processTransmitSpread(otaRespP);
+        break;
+#endif
     default:
         break;
     }
@@ -35,6 +35,208 @@
  */
 #define FW_VERSION_MINOR ((uint8_t)0x01)
 
+/*******************************************************************************
+* Feature Options
+*******************************************************************************/
+// Optional features that do not fit the MSP430G2553 flash together.  Set an
+// option to 1 to build the feature in (measure the link map when doing so).
+// The host simulations override them.
+
+/**
+ * \def RECORD_EVENT_LOG
+ * \brief If set to 1, system events (debugEvents_t) are recorded 
+ *        in the INFO C event log and sent after the daily logs
+ *        (see storageMgr_logEvent).  The log shares INFO C with
+ *        the application record, so events not sent yet are lost
+ *        when the record is erased (upgrade, Dummy_Isr).
+ */
+#ifndef RECORD_EVENT_LOG
+#define RECORD_EVENT_LOG 0
+#endif
+
+/**
+ * \def MINUTE_FLOW_CAPTURE
+ * \brief If set to 1, the flow of each minute of the hours armed 
+ *        OTA is captured in the spare space of the weekly logs
+ *        and sent after the daily logs (see captureLastMinute in
+ *        storage.c).  A weekly log holds two one hour captures.
+ */
+#ifndef MINUTE_FLOW_CAPTURE
+#define MINUTE_FLOW_CAPTURE 0
+#endif
+
+/**
+ * \def DAILY_PACKET_CRC
+ * \brief If set to 1, a CRC of each daily packet is kept while it 
+ *        is written and checked before the send; a daily log that
+ *        fails is sent zeroed with its integrity byte cleared (see
+ *        checkDailyPacket in storage.c).  The CRC and integrity
+ *        bytes are in the daily log either way.
+ */
+#ifndef DAILY_PACKET_CRC
+#define DAILY_PACKET_CRC 0
+#endif
+
+/**
+ * \def DATA_MSG_QUEUE
+ * \brief If set to 1, the daily log and check-in sends are posted 
+ *        to the outbound queue of msgData.c: a send that collides
+ *        with a session is sent by that session, a failed session
+ *        keeps its entries for the retry, and the queue is kept
+ *        across a watchdog or OTA reset.  If set to 0, a send that
+ *        collides with a session is dropped and a retry only
+ *        kicks the modem.  Needed by MODEM_ENERGY_BUDGET and
+ *        MODEM_TRANSMIT_SPREAD.
+ */
+#ifndef DATA_MSG_QUEUE
+#define DATA_MSG_QUEUE 0
+#endif
+
+/**
+ * \def MODEM_ADAPTIVE_TIMEOUT
+ * \brief If set to 1, the send data and partial read modem 
+ *        commands time out on their measured round trip times
+ *        instead of the fixed 10 seconds (see modemCmd.c).
+ */
+#ifndef MODEM_ADAPTIVE_TIMEOUT
+#define MODEM_ADAPTIVE_TIMEOUT 0
+#endif
+
+/**
+ * \def MODEM_COVERAGE_RETRY
+ * \brief If set to 1, the link time of the sessions is kept per 
+ *        hour of the day, a failed connect is retried up to three
+ *        times with backoff toward the hours that connected
+ *        fastest, and the check-in message carries the profile.
+ *        If set to 0, a failed connect is retried once after 12
+ *        hours.
+ */
+#ifndef MODEM_COVERAGE_RETRY
+#define MODEM_COVERAGE_RETRY 0
+#endif
+
+/**
+ * \def MODEM_ENERGY_BUDGET
+ * \brief If set to 1, the modem on time is counted per session 
+ *        and per rolling day against a budget configured OTA: a
+ *        session is cut at the session budget and the scheduled
+ *        sessions are deferred while the day budget is used up
+ *        (see modemMgr_exec).  The check-in message carries the
+ *        budget use.
+ */
+#ifndef MODEM_ENERGY_BUDGET
+#define MODEM_ENERGY_BUDGET 0
+#endif
+
+/**
+ * \def MODEM_KEEP_WARM
+ * \brief If set to 1, a registered modem is kept on after the 
+ *        release for the hold time of the modem budget
+ *        configuration, so that a session that follows reuses it
+ *        (see modemMgr_release).  Needs MODEM_ENERGY_BUDGET.
+ */
+#ifndef MODEM_KEEP_WARM
+#define MODEM_KEEP_WARM 0
+#endif
+#if (MODEM_KEEP_WARM==1) && (MODEM_ENERGY_BUDGET==0)
+#error MODEM_KEEP_WARM needs MODEM_ENERGY_BUDGET
+#endif
+
+/**
+ * \def MODEM_TRANSMIT_SPREAD
+ * \brief If set to 1, the scheduled daily log and check-in 
+ *        sessions start after the transmit offset of the unit in
+ *        the spread window configured OTA, and the first full
+ *        batch job after a reset reads the modem IMEI that sets
+ *        the offset.  If set to 0, they start at the storage time.
+ */
+#ifndef MODEM_TRANSMIT_SPREAD
+#define MODEM_TRANSMIT_SPREAD 0
+#endif
+
+/**
+ * \def MODEM_LEAN_BATCH
+ * \brief If set to 1, a data only or command only batch job 
+ *        leaves out the ping and the status commands while the
+ *        last status is recent (see modemMgr_sendModemCmdBatch).
+ *        If set to 0, they are sent as full jobs.
+ */
+#ifndef MODEM_LEAN_BATCH
+#define MODEM_LEAN_BATCH 0
+#endif
+
+/**
+ * \def MODEM_LINK_FAST_POWER_UP
+ * \brief If set to 1, the modem supplies are sequenced with 
+ *        sub-second timer A1 sleeps and GSM_STATUS ends the power
+ *        up early (see modemLink.c).  If set to 0, the one step per
+ *        second sequence is used (GSM_EN at 4 seconds, modem up at
+ *        15 seconds).
+ */
+#ifndef MODEM_LINK_FAST_POWER_UP
+#define MODEM_LINK_FAST_POWER_UP 0
+#endif
+
+/**
+ * \def DATA_MSG_MULTI_DAY
+ * \brief If set to 1, the daily logs are sent in multi-day 
+ *        messages (MSG_TYPE_MULTI_DAY, see
+ *        storageMgr_getNextMultiDayToTransmit) of up to seven days
+ *        with one shared header, streamed from flash by the modem
+ *        command transmit ISR.  If set to 0, each daily log is
+ *        sent in its own message (MSG_TYPE_DAILY).
+ */
+#ifndef DATA_MSG_MULTI_DAY
+#define DATA_MSG_MULTI_DAY 0
+#endif
+
+/**
+ * \def MODEM_CMD_ISR_CRC
+ * \brief If set to 1, the modem message CRC is computed one byte 
+ *        at a time by the UART ISRs as the bytes are sent and
+ *        received.  If set to 0, it is computed over the command
+ *        before the transmit starts and over the response when it
+ *        is checked.  Needed by DATA_MSG_MULTI_DAY (see
+ *        modemCmd.c).
+ */
+#ifndef MODEM_CMD_ISR_CRC
+#define MODEM_CMD_ISR_CRC 0
+#endif
+
+/**
+ * \def GMT_CLOCKSET_ONE_STEP
+ * \brief If set to 1, the GMT clock set offset is applied to the 
+ *        calendar in one step (see advanceBinTime), in a fixed
+ *        time.  If set to 0, the TI increment routines are called
+ *        once per second, minute, hour and day of the offset.
+ */
+#ifndef GMT_CLOCKSET_ONE_STEP
+#define GMT_CLOCKSET_ONE_STEP 0
+#endif
+
+/**
+ * \def STORAGE_CONFIG_RECORD
+ * \brief Set to 1 by the options that keep OTA settings in the 
+ *        INFO D configuration record (see storageConfig_t in
+ *        storage.c).  Not an option itself.
+ */
+#if (MINUTE_FLOW_CAPTURE==1) || (MODEM_ENERGY_BUDGET==1) || (MODEM_TRANSMIT_SPREAD==1)
+#define STORAGE_CONFIG_RECORD 1
+#else
+#define STORAGE_CONFIG_RECORD 0
+#endif
+
+/**
+ * \def FINE_TICK_TIME
+ * \brief Set to 1 by the options that time in fine ticks (see 
+ *        getFineTicksSinceBoot).  Not an option itself.
+ */
+#if (MODEM_ADAPTIVE_TIMEOUT==1) || (MODEM_COVERAGE_RETRY==1) || (MODEM_LINK_FAST_POWER_UP==1)
+#define FINE_TICK_TIME 1
+#else
+#define FINE_TICK_TIME 0
+#endif
+
 /*******************************************************************************
 * System Tick Access
 *******************************************************************************/
@@ -45,6 +247,17 @@ typedef uint32_t sys_tick_t;
 // Return the number of elapsed seconds
 #define GET_ELAPSED_TIME_IN_SEC(x) (((sys_tick_t)getSecondsSinceBoot())-(sys_tick_t)(x))
 
+// Define the type that a fine grained time value is represented in.
+// A fine tick is 1/1024 second (the seconds since boot plus the
+// timer A1 count).  Wraps after 48 days, so only use differences.
+typedef uint32_t fine_tick_t;
+#define FINE_TICK_SHIFT 10
+#define FINE_TICKS_PER_SEC ((uint16_t)1 << FINE_TICK_SHIFT)
+// Just return the fine grained time value.
+#define GET_FINE_TICK() ((fine_tick_t)getFineTicksSinceBoot())
+// Return the number of elapsed fine ticks
+#define GET_ELAPSED_FINE_TICKS(x) (((fine_tick_t)getFineTicksSinceBoot())-(fine_tick_t)(x))
+
 // Used for testing if running the sys tick at faster then
 // the standard 1 second interval.  For normal operation, set to 1.
 #define TIME_SCALER ((uint8_t)1)
@@ -203,10 +416,27 @@ void sysExec_sendDebugDataToUart(void);
 /*******************************************************************************
 * Utils.c
 *******************************************************************************/
+/**
+ * \def CRC16_INIT_VALUE
+ * \brief Start value of a CRC16 computed with gen_crc16_update.
+ */
+#define CRC16_INIT_VALUE ((unsigned int)0)
+
+/**
+ * \def CRC16_FINAL
+ * \brief Finish a CRC16 computed with gen_crc16_update (the 
+ *        CRC16 has no output xor).
+ */
+#define CRC16_FINAL(crc) (crc)
+
 bool isBcdMinSecValValid(uint8_t bcdVal);
 bool isBcdHour24Valid(uint8_t bcdVal);
+unsigned int gen_crc16_update(unsigned int crc, const unsigned char *data, unsigned int size);
 unsigned int gen_crc16(const unsigned char *data, unsigned int size);
 unsigned int gen_crc16_2buf(const unsigned char *data1, unsigned int size1, const unsigned char *data2, unsigned int size2);
+#if (MODEM_CMD_ISR_CRC==1) || (DAILY_PACKET_CRC==1)
+unsigned int gen_crc16_byte(unsigned int crc, unsigned char data);
+#endif
 void initApplicationRecord(void);
 bool checkForApplicationRecord(void);
 
@@ -214,6 +444,41 @@ bool checkForApplicationRecord(void);
 * modemCmd.h
 *******************************************************************************/
 
+/**
+ * \def ISR_BUF_SIZE 
+ * \brief Define the size of the UART receive buffer. 
+ */
+#define ISR_BUF_SIZE ((uint8_t)48)
+
+/**
+ * \def MODEM_PARTIAL_RESP_OVERHEAD
+ * \brief The bytes of a get incoming partial response beyond 
+ *        the payload: start,cmd,len[4],remaining[4],crc[2],end.
+ */
+#define MODEM_PARTIAL_RESP_OVERHEAD ((uint8_t)13)
+
+/**
+ * \typedef modemBatchProfile_t
+ * \brief Select the commands that modemMgr sends with a batch 
+ *        job.
+ */
+typedef enum modemBatchProfile_e {
+    MODEM_BATCH_FULL,         /**< ping, the command, modem status, message status */
+    MODEM_BATCH_DATA_ONLY,    /**< the command, status only when the last one is stale */
+    MODEM_BATCH_STATUS_ONLY,  /**< modem status and message status - no cmd */
+    MODEM_BATCH_CMD_ONLY,     /**< the command alone - no ping or status */
+} modemBatchProfile_t;
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+ * \typedef modemCmdPayloadFunc_t
+ * \brief Function that returns a segment of a payload that is 
+ *        not in one buffer.  Called by the UART transmit ISR for
+ *        segment 0, 1, ... until it returns zero.
+ */
+typedef uint16_t (*modemCmdPayloadFunc_t)(uint8_t segment, uint8_t **dataPP);
+#endif
+
 /**
  * \typedef modemCmdWriteData_t 
  * \brief Container to pass parmaters to the modem command write 
@@ -223,9 +488,12 @@ typedef struct modemCmdWriteData_s {
     modem_command_t cmd;         /**< the modem command */
     MessageType_t payloadMsgId;  /**< the payload type (Outpour message type) */
     uint8_t *payloadP;           /**< the payload pointer (if any) */
+#if (DATA_MSG_MULTI_DAY==1)
+    modemCmdPayloadFunc_t payloadFuncP; /**< the payload segments instead of payloadP (if not NULL) */
+#endif
     uint16_t payloadLength;      /**< size of the payload in bytes */
     uint16_t payloadOffset;      /**< for receiving partial data */
-    bool statusOnly;             /**< only perform status retrieve from modem - no cmd */
+    modemBatchProfile_t batchProfile; /**< the commands sent with the batch job */
 } modemCmdWriteData_t;
 
 /**
@@ -257,13 +525,39 @@ typedef struct otaResponse_s {
     uint16_t remainingInBytes;            /**< how much remaining of the total OTA */
 }otaResponse_t;
 
+/**
+ * \typedef modemCmdResponseFunc_t
+ * \brief Called when a modem command is done (see 
+ *        modemCmd_setResponseFunc).
+ */
+typedef void (*modemCmdResponseFunc_t)(void);
+
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+/**
+ * \typedef modemCmdRttStats_t
+ * \brief Round trip times (command sent to response validated) 
+ *        of one modem command, in 1/64 second units
+ *        (MODEM_CMD_RTT_SHIFT fine ticks).  All zero if the command
+ *        has not completed yet.
+ */
+typedef struct modemCmdRttStats_s {
+    uint8_t min;                          /**< shortest round trip */
+    uint8_t avg;                          /**< running average round trip */
+    uint8_t max;                          /**< longest round trip */
+} modemCmdRttStats_t;
+#endif
+
 void modemCmd_exec(void);
 void modemCmd_init(void);
-bool modemCmd_write(modemCmdWriteData_t *writeCmdP);
+void modemCmd_setResponseFunc(modemCmdResponseFunc_t responseFuncP);
+bool modemCmd_write(const modemCmdWriteData_t *writeCmdP);
+void modemCmd_flushQueue(void);
 void modemCmd_read(modemCmdReadData_t *readDataP);
-bool modemCmd_isResponseReady(void);
 bool modemCmd_isError(void);
 bool modemCmd_isBusy(void);
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+bool modemCmd_getRttStats(modem_command_t cmd, modemCmdRttStats_t *statsP);
+#endif
 
 /*******************************************************************************
 * modemLink.h
@@ -273,14 +567,33 @@ void modemLink_init(void);
 void modemLink_restart(void);
 void modemLink_shutdownModem(void);
 bool modemLink_isModemUp(void);
+#if (MODEM_KEEP_WARM==1)
+void modemLink_resetUpTime(void);
+#endif
 uint16_t modemLink_getModemUpTimeInSecs(void);
 bool modemLink_isModemUpError(void);
 
 /*******************************************************************************
 * modemMgr.c
 *******************************************************************************/
-void modemMgr_exec(void);
+/**
+ * \typedef modemConfig_t
+ * \brief The modem settings written by the OTA commands.  They 
+ *        are stored in the storage configuration record
+ *        (storageMgr_getModemConfig), zero selects the default of
+ *        the modem modules.
+ */
+typedef struct modemConfig_s {
+    uint8_t sessionMinutes;            /**< modem on time budget per session */
+    uint8_t dayMinutes;                /**< modem on time budget per rolling day */
+    uint8_t keepWarmSecs;              /**< modem hold time after a session, 0 for none */
+    uint8_t transmitSpreadMinutes;     /**< transmit spread window, 0xFF to send at the storage time */
+} modemConfig_t;
+
 void modemMgr_init(void);
+#if (MODEM_ENERGY_BUDGET==1)
+void modemMgr_exec(void);
+#endif
 bool modemMgr_grab(void);
 bool modemMgr_isModemUp(void);
 bool modemMgr_isModemUpError(void);
@@ -296,7 +609,25 @@ otaResponse_t* modemMgr_getLastOtaResponse(void);
 bool modemMgr_isLinkUp(void);
 bool modemMgr_isLinkUpError(void);
 uint8_t modemMgr_getNumOtaMsgsPending(void);
+#if (MODEM_LEAN_BATCH==1)
+bool modemMgr_isStatusStale(void);
+#endif
 uint8_t* modemMgr_getSharedBuffer(void);
+#if (MODEM_ENERGY_BUDGET==1)
+bool modemMgr_isSessionBudgetExhausted(void);
+bool modemMgr_isDayBudgetExhausted(void);
+uint8_t modemMgr_getBudgetReport(uint8_t *bufP);
+#endif
+#if (MODEM_COVERAGE_RETRY==1)
+uint16_t modemMgr_getCoverageRetryDelay(uint16_t minSecs, uint16_t maxSecs);
+uint8_t modemMgr_getCoverageReport(uint8_t *bufP);
+#endif
+#if (MODEM_TRANSMIT_SPREAD==1)
+uint16_t modemMgr_getTransmitOffset(uint16_t windowSecs);
+#endif
+#if (MODEM_ENERGY_BUDGET==1)
+bool modemMgr_setBudgetConfig(uint8_t *dataP);
+#endif
 
 /*******************************************************************************
 * msgData.c
@@ -304,7 +635,8 @@ uint8_t* modemMgr_getSharedBuffer(void);
 void dataMsgMgr_exec(void);
 void dataMsgMgr_init(void);
 bool dataMsgMgr_sendDataMsg(MessageType_t msgId, uint8_t *dataP, uint16_t lengthInBytes);
-bool dataMsgMgr_sendDailyLogs(uint8_t weeklyLogNum);
+bool dataMsgMgr_sendDailyLogs(void);
+bool dataMsgMgr_sendCheckin(void);
 
 /*******************************************************************************
 * msgOta.c
@@ -338,7 +670,8 @@ typedef enum debugEvents_e {
     EVENT_CLOCK_ALIGNMENT,
     EVENT_ACTIVATION,
     EVENT_REDFLAG,
-    EVENT_MODEM_TIMEOUT
+    EVENT_MODEM_TIMEOUT,
+    EVENT_MODEM_BUDGET
 } debugEvents_t;
 
 void dbgMsgMgr_init(void);
@@ -359,6 +692,10 @@ typedef enum dataMsgState_e {
     DMSG_STATE_SEND_MSG,
     DMSG_STATE_SEND_MSG_WAIT,
     DMSG_STATE_WAIT_FOR_LINK,
+#if (MODEM_LEAN_BATCH==1)
+    DMSG_STATE_REFRESH_STATUS,
+    DMSG_STATE_REFRESH_STATUS_WAIT,
+#endif
     DMSG_STATE_PROCESS_OTA,
     DMSG_STATE_PROCESS_OTA_WAIT,
     DMSG_STATE_RELEASE,
@@ -416,8 +753,17 @@ typedef struct  __attribute__((__packed__))timePacket_s {
 void timerA1_init(void);
 timePacket_t* getBinTime(void);
 timePacket_t* getBcdTime(void);
+#if (GMT_CLOCKSET_ONE_STEP==1)
+void advanceBinTime(uint16_t binDays, uint8_t binHours, uint8_t binMinutes, uint8_t binSeconds);
+#endif
 uint8_t bcd_to_char(uint8_t bcdValue);
 uint32_t getSecondsSinceBoot(void);
+#if (FINE_TICK_TIME==1)
+fine_tick_t getFineTicksSinceBoot(void);
+#endif
+#if (MODEM_LINK_FAST_POWER_UP==1)
+void timerA1_sleepFineTicks(uint16_t fineTicks);
+#endif
 #if 0
 void calibrateLoopDelay (void);
 #endif
@@ -435,7 +781,26 @@ void storageMgr_resetWeeklyLogs(void);
 void storageMgr_setStorageAlignmentTime(uint8_t second, uint8_t minute, uint8_t hour);
 void storageMgr_setDailyTransmission(bool enable);
 void storageMgr_setWeeklyTransmission(bool enable);
-uint16_t storageMgr_getNextDailyLogToTransmit(uint8_t **dataPP, uint8_t weeklyLogNum);
+uint16_t storageMgr_getNextDailyLogToTransmit(uint8_t **dataPP, uint16_t *sessionMaskP);
+#if (DATA_MSG_MULTI_DAY==1)
+uint16_t storageMgr_getNextMultiDayToTransmit(uint16_t *sessionMaskP, uint8_t maxDays, uint8_t *numDaysP);
+uint16_t storageMgr_getMultiDaySegment(uint8_t segment, uint8_t **dataPP);
+#endif
+void storageMgr_markDailyLogsAsTransmitted(uint16_t sessionMask);
+#if (MODEM_ENERGY_BUDGET==1) || (MODEM_TRANSMIT_SPREAD==1)
+void storageMgr_setModemConfig(modemConfig_t *configP);
+void storageMgr_getModemConfig(modemConfig_t *configP);
+#endif
+#if (MINUTE_FLOW_CAPTURE==1)
+bool storageMgr_setMinuteCaptureConfig(uint8_t *dataP);
+uint16_t storageMgr_getNextMinuteCaptureToTransmit(uint8_t **dataPP, uint8_t *sessionMaskP);
+void storageMgr_markMinuteCapturesAsTransmitted(uint8_t sessionMask);
+#endif
+#if (RECORD_EVENT_LOG==1)
+void storageMgr_logEvent(debugEvents_t event, uint8_t payload);
+uint16_t storageMgr_getNextEventLogToTransmit(uint8_t **dataPP, uint8_t *countP);
+void storageMgr_markEventLogAsTransmitted(uint8_t count);
+#endif
 uint8_t storageMgr_prepareMsgHeader(uint8_t *dataPtr);
 void storageMgr_sendDebugDataToUart(void);
 
@@ -489,7 +854,21 @@ void msp430flash_test(void);
 #define FLASH_UPGRADE_KEY3 ((uint8_t)0x59)
 #define FLASH_UPGRADE_KEY4 ((uint8_t)0x26)
 
+/**
+ * \def FLASH_ADDR_TO_PTR
+ * \brief Convert a 16 bit flash address to a pointer used to
+ *        read the flash contents.  The host simulation build
+ *        overrides this to read its emulated flash image.
+ */
+#ifndef FLASH_ADDR_TO_PTR
+#define FLASH_ADDR_TO_PTR(a) ((uint8_t *)(a))
+#endif
+
+#define CAL_LOCATION ((uint8_t *)0x10C0)  // INFO A, factory calibration
+#define CAL_LENGTH ((uint16_t)64)
+#define SCR_LOCATION ((uint8_t *)0x1000)  // INFO D
 #define APR_LOCATION ((uint8_t *)0x1040)  // INFO C
+#define EVENT_LOG_LOCATION ((uint8_t *)0x1048)  // INFO C, after the application record
 #define APR_MAGIC1 ((uint16_t)0x1234)
 #define APR_MAGIC2 ((uint16_t)0x5678)
 
@@ -80,6 +80,142 @@
  */
 #define MIN_DAILY_LITERS_TO_SET_REDFLAG_CONDITION ((uint16_t)200)
 
+/**
+ * \def SCR_MAGIC
+ * \brief Identify a valid storage configuration record.
+ */
+#define SCR_MAGIC ((uint16_t)0x5343)
+
+/**
+ * \def SCR_VERSION
+ * \brief Layout version of the storage configuration record. 
+ *        Change it when a field is added, moved or changes
+ *        meaning: a record of another version is not used (the
+ *        defaults are), so a firmware upgrade never reads a field
+ *        of the old layout.
+ */
+#define SCR_VERSION ((uint8_t)2)
+
+#if (MINUTE_FLOW_CAPTURE==1)
+/**
+ * \def MINUTE_CAPTURES_PER_WEEKLY_LOG
+ * \brief Number of one hour minute flow captures that fit in the 
+ *        space left at the end of a weekly log container.
+ */
+#define MINUTE_CAPTURES_PER_WEEKLY_LOG ((uint8_t)2)
+
+/**
+ * \def MINUTE_CAPTURE_FREE
+ * \brief The dayHour of an unused (erased) minute capture.  Also
+ *        marks a minute that was not captured.
+ */
+#define MINUTE_CAPTURE_FREE ((uint8_t)0xFF)
+
+/**
+ * \def MINUTE_CAPTURE_MAX_FLOW
+ * \brief Scaled minute flow is limited so it is never read as
+ *        MINUTE_CAPTURE_FREE.
+ */
+#define MINUTE_CAPTURE_MAX_FLOW ((uint8_t)0xFE)
+
+/**
+ * \def MINUTE_CAPTURE_SCALE_MASK
+ * \brief Control byte: the minute flow is stored in units of
+ *        (1 << scale) mL.
+ */
+#define MINUTE_CAPTURE_SCALE_MASK ((uint8_t)0x0F)
+
+/**
+ * \def MINUTE_CAPTURE_WEEK_SHIFT
+ * \brief Control byte: bits 4-6 hold the storage week (modulo
+ *        8) so the capture can be matched to its daily logs.
+ */
+#define MINUTE_CAPTURE_WEEK_SHIFT ((uint8_t)4)
+
+/**
+ * \def MINUTE_CAPTURE_UNSENT_BIT
+ * \brief Control byte: bit is cleared when the capture was 
+ *        transmitted.
+ */
+#define MINUTE_CAPTURE_UNSENT_BIT ((uint8_t)0x80)
+
+/**
+ * \def MINUTE_CAPTURE_MODE_OFF
+ * \brief Minute capture mode: no minute flow is captured 
+ *        (default).
+ */
+#define MINUTE_CAPTURE_MODE_OFF ((uint8_t)0)
+
+/**
+ * \def MINUTE_CAPTURE_MODE_DAILY
+ * \brief Minute capture mode: the armed hours are captured 
+ *        every day until the captures of the weekly log are
+ *        used up.
+ */
+#define MINUTE_CAPTURE_MODE_DAILY ((uint8_t)1)
+
+/**
+ * \def MINUTE_CAPTURE_MODE_RED_FLAG
+ * \brief Minute capture mode: the armed hours are only captured
+ *        while a red flag condition is set.
+ */
+#define MINUTE_CAPTURE_MODE_RED_FLAG ((uint8_t)2)
+#endif
+
+#if (RECORD_EVENT_LOG==1)
+/**
+ * \def EVENT_LOG_RECORDS
+ * \brief Number of event records in the event log.  The log
+ *        fills the INFO C section after the application record
+ *        (EVENT_LOG_LOCATION).
+ */
+#define EVENT_LOG_RECORDS ((uint8_t)14)
+
+/**
+ * \def EVENT_LOG_RECORDS_PER_MSG
+ * \brief Maximum number of events sent in one event log
+ *        message.  The message is built in the 48 byte shared
+ *        buffer after the 14 byte message header and the 3 byte
+ *        boot stamp.
+ */
+#define EVENT_LOG_RECORDS_PER_MSG ((uint8_t)7)
+
+/**
+ * \def EVENT_LOG_FREE
+ * \brief The code of an unused (erased) event record.
+ */
+#define EVENT_LOG_FREE ((uint8_t)0xFF)
+
+/**
+ * \def EVENT_LOG_UNSENT_BIT
+ * \brief Code byte: bit is cleared when the event was 
+ *        transmitted.
+ */
+#define EVENT_LOG_UNSENT_BIT ((uint8_t)0x80)
+
+/**
+ * \def EVENT_LOG_BOOT_SHIFT
+ * \brief Code byte: bits 4-6 hold the boot number (modulo 8) of
+ *        the event, so the time stamps of different boots can be
+ *        told apart.  Bits 0-3 hold the event code.
+ */
+#define EVENT_LOG_BOOT_SHIFT ((uint8_t)4)
+
+/**
+ * \def EVENT_LOG_CODE_MASK
+ * \brief Code byte: the low bits of the debugEvents_t code.
+ */
+#define EVENT_LOG_CODE_MASK ((uint8_t)0x0F)
+
+/**
+ * \def EVENT_LOG_TIME_SHIFT
+ * \brief Event time stamps are the seconds since the boot of 
+ *        the event in units of 64 seconds (16 bits, about 48
+ *        days).
+ */
+#define EVENT_LOG_TIME_SHIFT ((uint8_t)6)
+#endif
+
 /**
  * \def FLASH_BLOCK_SIZE
  * \brief Define how big a flash block is.  Represents the 
@@ -87,6 +223,66 @@
  */
 #define FLASH_BLOCK_SIZE ((uint16_t)512)
 
+#if (DAILY_PACKET_CRC==1)
+/**
+ * \def DAILY_LOG_INTEGRITY_BAD
+ * \brief Written to the integrity byte of a daily log that 
+ *        failed its CRC check before transmit.  The measurement
+ *        data of the daily log is zeroed.  An erased (0xFF)
+ *        integrity byte means the daily log passed.
+ */
+#define DAILY_LOG_INTEGRITY_BAD ((uint8_t)0x00)
+
+/**
+ * \def DAILY_PACKET_CRC_HEADER_START
+ * \brief First header byte covered by the daily packet CRC (the
+ *        product ID).  The first two bytes are replaced by the
+ *        modem command module.
+ */
+#define DAILY_PACKET_CRC_HEADER_START ((uint8_t)2)
+#endif
+
+/**
+ * \def DAILY_PACKET_CRC_DATA_LENGTH
+ * \brief Number of daily log data bytes covered by the daily 
+ *        packet CRC (up to and including the red flag byte).
+ */
+#define DAILY_PACKET_CRC_DATA_LENGTH ((uint8_t)89)
+
+/**
+ * \def DAILY_LOG_INDEX_WEEK_MASK
+ * \brief The bits of a weekly log index (one bit per day).
+ */
+#define DAILY_LOG_INDEX_WEEK_MASK ((uint8_t)0x7F)
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+ * \def MULTI_DAY_HEADER_LENGTH
+ * \brief Size of the shared header of a multi-day message: the 
+ *        daily packet header of the oldest day, without the two
+ *        bytes replaced by the modem command module.
+ */
+#define MULTI_DAY_HEADER_LENGTH ((uint8_t)14)
+
+/**
+ * \def MULTI_DAY_LOG_LENGTH
+ * \brief Size of the daily log data of a day in a multi-day 
+ *        message: the data covered by the daily packet CRC and
+ *        the integrity byte.  The CRC and the padding are not
+ *        sent (the CRC also covers the header that is not sent
+ *        per day; the integrity byte tells the result of the
+ *        check done before the send).
+ */
+#define MULTI_DAY_LOG_LENGTH ((uint8_t)(DAILY_PACKET_CRC_DATA_LENGTH + 1))
+
+/**
+ * \def MULTI_DAY_SEGMENTS_PER_DAY
+ * \brief Payload segments per day of a multi-day message: the 
+ *        day offset and the daily log data.
+ */
+#define MULTI_DAY_SEGMENTS_PER_DAY ((uint8_t)2)
+#endif
+
 
 /**
  * \typedef dailyHeader_t
@@ -125,6 +321,8 @@ typedef struct __attribute__((__packed__))dailyLog_s {
     uint16_t comparedAverage;
     uint16_t unknowns;
     uint8_t redFlag;
+    uint8_t integrity;   /**< DAILY_LOG_INTEGRITY_BAD if the CRC check failed */
+    uint16_t crc16;      /**< CRC of the daily packet, written when the day is sealed */
 } dailyLog_t;
 
 typedef union packetHeader_s {
@@ -152,18 +350,86 @@ typedef struct dailyPacket_s {
     packetData_t packetData;
 } dailyPacket_t;
 
+#if (MINUTE_FLOW_CAPTURE==1)
+/**
+ * \typedef minuteCapture_t
+ * \brief Define the layout of a one hour minute flow capture in
+ *        flash.  The header is written when the first minute of
+ *        the hour is captured, then one byte per minute.  The
+ *        captures are erased with their weekly log, so the
+ *        weekly logs also make up the capture ring.
+ */
+typedef struct minuteCapture_s {
+    uint8_t dayHour;                     /**< dayOfWeek * 24 + hour, MINUTE_CAPTURE_FREE if unused */
+    uint8_t control;                     /**< scale, week and unsent bit (MINUTE_CAPTURE_xxx) */
+    uint8_t minuteFlow[60];              /**< flow per minute, MINUTE_CAPTURE_FREE if not captured */
+} minuteCapture_t;
+#endif
+
 /**
  * \typedef weeklyLog_t
  * \brief  Define the layout of the weekly log in flash.  It 
  *         currently consists of the 7 daily log packets and
- *         meta data.
+ *         meta data.  The meta data is a bit index with one bit
+ *         per day of the week (bit 0 is day 0).  The bits are
+ *         erased to 1 and cleared (programmed to 0) one at a time,
+ *         so they can be updated in place until the weekly log
+ *         is erased.  With MINUTE_FLOW_CAPTURE the remaining
+ *         space holds the minute flow captures.
  */
 typedef struct weeklyLog_s {
     dailyPacket_t dailyPackets[7];       /**< The seven daily logs of the week */
-    uint8_t clearOnTransmit[7];          /**< Byte cleared for day when log transmitted */
-    uint8_t clearOnReady[7];             /**< Byte cleared for day when log ready to send */
+    uint16_t clearOnTransmitIndex;       /**< Bit cleared for day when log transmitted */
+    uint16_t clearOnReadyIndex;          /**< Bit cleared for day when log ready to send */
+#if (MINUTE_FLOW_CAPTURE==1)
+    minuteCapture_t minuteCaptures[MINUTE_CAPTURES_PER_WEEKLY_LOG]; /**< Fill the container */
+#endif
 } weeklyLog_t;
 
+#if (RECORD_EVENT_LOG==1)
+/**
+ * \typedef eventRecord_t
+ * \brief Define the layout of an event log record in flash.
+ */
+typedef struct eventRecord_s {
+    uint8_t code;                      /**< event code, boot number and EVENT_LOG_UNSENT_BIT */
+    uint8_t payload;                   /**< event specific data */
+    uint16_t time;                     /**< seconds since the boot >> EVENT_LOG_TIME_SHIFT */
+} eventRecord_t;
+#endif
+
+#if (STORAGE_CONFIG_RECORD==1)
+/**
+ * \typedef storageConfig_t
+ * \brief The configuration record written by the OTA commands,
+ *        at the start of the INFO D section (SCR_LOCATION).  If
+ *        the record is not valid or of another SCR_VERSION, the
+ *        defaults are used.  Layout (byte offset):
+ *  
+ *   0  magic (SCR_MAGIC)      2  version (SCR_VERSION)
+ *   3  minute capture: mode, hours (3 bytes), scale
+ *   8  modem (modemMgr, msgData): session budget, day budget,
+ *      keep warm time, transmit spread
+ *  12  crc16 of bytes 0-11
+ *  
+ * \note The modem settings are only stored here: modemMgr reads
+ *       them with storageMgr_getModemConfig and checks them
+ *       itself.  The minute capture bytes are kept without
+ *       MINUTE_FLOW_CAPTURE so the layout does not change.  The
+ *       record owns the INFO D section, so a write rewrites the
+ *       whole record.
+ */
+typedef struct storageConfig_s {
+    uint16_t magic;                    /**< SCR_MAGIC */
+    uint8_t version;                   /**< SCR_VERSION */
+    uint8_t captureMode;               /**< MINUTE_CAPTURE_MODE_xxx */
+    uint8_t captureHours[3];           /**< one bit per storage hour to capture */
+    uint8_t captureScale;              /**< minute flow unit is (1 << scale) mL */
+    modemConfig_t modem;               /**< the modem settings (modemMgr, msgData) */
+    uint16_t crc16;                    /**< crc of the preceding bytes */
+} storageConfig_t;
+#endif
+
 /**
  * \typedef storageData_t 
  * \brief Define a container to hold data for the storage 
@@ -191,7 +457,20 @@ typedef struct storageData_s {
     bool redFlagDataFullyPopulated;    /**< true if redflag init mapping is completed */
     uint16_t redFlagThreshTable[7];    /**< store redFlag compare thresholds */
     uint8_t curWeeklyLogNum;           /**< Current weekly flash log working on */
-    uint8_t prevWeeklyLogNum;          /**< Previous weekly flash log */
+#if (DAILY_PACKET_CRC==1)
+    uint16_t dailyPacketCrc;           /**< Running CRC of the bytes written to today's daily packet */
+#endif
+#if (DATA_MSG_MULTI_DAY==1)
+    uint16_t multiDayMask;             /**< daily logs of the multi-day message (session mask bits) */
+    uint8_t multiDayWeeklyLogNum;      /**< oldest weekly log when the multi-day message was built */
+    uint8_t multiDayOffset;            /**< day offset of the multi-day segment being sent */
+#endif
+#if (RECORD_EVENT_LOG==1)
+    uint8_t eventLogBoot;              /**< boot number of the events (EVENT_LOG_BOOT_SHIFT) */
+#endif
+#if (MINUTE_FLOW_CAPTURE==1)
+    uint8_t captureMode;               /**< capture mode of the valid configuration record */
+#endif
 } storageData_t;
 
 /****************************
@@ -213,6 +492,16 @@ static const weeklyLog_t *weeklyLogAddrTable[] = {
     &week2Log,
 };
 
+/**
+ * \var firstBitTable
+ * \brief Index of the lowest set bit of a nibble (4 if none). 
+ *        Used for the constant time lookup of the first pending
+ *        daily log in a weekly log index.
+ */
+static const uint8_t firstBitTable[16] = {
+    4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+
 /**
  * \var stData 
  * \brief Declare the module data container 
@@ -225,23 +514,42 @@ storageData_t stData;
  *********************/
 
 static void handle_red_flag(void);
+#if (STORAGE_CONFIG_RECORD==1)
+static void getStorageConfig(storageConfig_t *configP);
+static void writeStorageConfig(storageConfig_t *configP);
+#endif
 static bool doesAlignTimeMatch(void);
 static void recordLastMinute(void);
+#if (MINUTE_FLOW_CAPTURE==1)
+static void captureLastMinute(void);
+static minuteCapture_t* getMinuteCaptureAddr(uint8_t weeklyLogNum, uint8_t dayHour, uint8_t control);
+#endif
 static void recordLastHour(void);
-static void recordLastDay(void);
+static bool recordLastDay(void);
 static weeklyLog_t* getWeeklyLogAddr(uint8_t weeklyLogNum);
 static dailyLog_t* getDailyLogAddr(uint8_t weeklyLogNum, uint8_t dayOfTheWeek);
 static dailyHeader_t* getDailyHeaderAddr(uint8_t weeklyLogNum, uint8_t dayOfTheWeek);
 static dailyPacket_t* getDailyPacketAddr(uint8_t weeklyLogNum, uint8_t dayOfTheWeek);
+#if (DATA_MSG_MULTI_DAY==1)
+static dailyPacket_t* getMultiDayPacket(uint8_t index);
+static uint8_t getMultiDayOffset(dailyPacket_t *firstP, dailyPacket_t *dpP);
+static bool isMultiDayMatch(dailyPacket_t *firstP, dailyPacket_t *dpP);
+#endif
 static uint8_t getNextWeeklyLogNum(uint8_t weeklyLogNum);
 static void eraseWeeklyLog(uint8_t weeklyLogNum);
 static void prepareNextWeeklyLog(void);
 static void prepareDailyLog(void);
+static void writeDailyPacketByte(uint8_t *addr, uint8_t val);
+static void writeDailyPacketInt(uint8_t *addr, uint16_t val);
+#if (DAILY_PACKET_CRC==1)
+static uint16_t getDailyPacketCrc(dailyPacket_t *dpP);
+static void checkDailyPacket(dailyPacket_t *dpP);
+#endif
 static void markDailyLogAsReady(uint8_t dayOfTheWeek, uint8_t weeklyLogNum);
-static bool isDailyLogReady(uint8_t dayOfTheWeek, uint8_t weeklyLogNum);
-static void markDailyLogAsTransmitted(uint8_t dayOfTheWeek, uint8_t weeklyLogNum);
-static bool wasDailyLogTransmitted(uint8_t dayOfTheWeek, uint8_t weeklyLogNum);
-static void sendMonthlyCheckin(void);
+static uint8_t getPendingDailyLogs(uint8_t weeklyLogNum);
+static void markDailyLogsAsTransmitted(uint8_t dayMask, uint8_t weeklyLogNum);
+static uint8_t getSessionDailyLogs(uint16_t sessionMask, uint8_t weeklyLogNum);
+static uint8_t getFirstDailyLog(uint8_t dayMask);
 // static void fillDailyLogWithRamp(uint8_t weeklyLogNum);
 // uint16_t getSimulatedDailyLiters(uint8_t weekNum, uint8_t dayOfWeek);
 
@@ -255,7 +563,21 @@ static void sendMonthlyCheckin(void);
 * \ingroup PUBLIC_API
 */
 void storageMgr_init(void) {
+#if (MINUTE_FLOW_CAPTURE==1)
+    storageConfig_t config;
+#endif
     memset(&stData, 0, sizeof(storageData_t));
+#if (MINUTE_FLOW_CAPTURE==1)
+    // Validate the configuration record once; captureLastMinute
+    // only reads the armed hours when the cached mode is on.
+    getStorageConfig(&config);
+    stData.captureMode = config.captureMode;
+#endif
+#if (RECORD_EVENT_LOG==1)
+    // Record the reset in the event log.  The payload holds the
+    // reset flags (watchdog, power on, reset pin).
+    storageMgr_logEvent(EVENT_RESET, IFG1);
+#endif
     storageMgr_resetWeeklyLogs();
     prepareDailyLog();
 }
@@ -266,6 +588,7 @@ void storageMgr_init(void) {
 * \ingroup EXEC_ROUTINE
 */
 void storageMgr_exec(void) {
+    bool sendDailyLogs = false;
 
     // If we are waiting for an alignment event to occur, see if there
     // is a match (GMT time == alignment time).
@@ -277,6 +600,10 @@ void storageMgr_exec(void) {
             stData.alignSafetyCheckInSec--;
         }
         if (doesAlignTimeMatch() || (stData.alignSafetyCheckInSec == 0)) {
+#if (RECORD_EVENT_LOG==1)
+            // Payload is 1 if the alignment time was never seen
+            storageMgr_logEvent(EVENT_CLOCK_ALIGNMENT, (stData.alignSafetyCheckInSec == 0));
+#endif
             // If the current time is equal to the storage offset,
             // then zero storage time and clear storage memory
             stData.alignStorageFlag = false;
@@ -287,6 +614,8 @@ void storageMgr_exec(void) {
             stData.storageTime_week = 0;
             storageMgr_resetWeeklyLogs();
             storageMgr_resetRedFlagAndMap();
+            // The erase removed the daily packet header
+            prepareDailyLog();
         } else {
             // Don't start storing any data until we are officially aligned.
             return;
@@ -313,7 +642,7 @@ void storageMgr_exec(void) {
     }
     if (stData.storageTime_hours == TOTAL_HOURS_IN_A_DAY) {
         // Record Data
-        recordLastDay();
+        sendDailyLogs = recordLastDay();
         // Update Time
         stData.storageTime_dayOfWeek++;
         stData.storageTime_hours = 0;
@@ -342,6 +671,13 @@ void storageMgr_exec(void) {
             stData.daysActivated++;
         }
     }
+
+    // Start transmitting the daily log backlog.  This is done after the
+    // weekly log rollover so that the oldest weekly log is not erased while
+    // its daily logs are being transmitted.
+    if (sendDailyLogs) {
+        dataMsgMgr_sendDailyLogs();
+    }
 }
 
 /**
@@ -410,6 +746,10 @@ void storageMgr_setStorageAlignmentTime(uint8_t bcdSecond, uint8_t bcdMinute, ui
 */
 void storageMgr_overrideUnitActivation(bool flag) {
     stData.daysActivated = flag ? 1 : 0;
+#if (RECORD_EVENT_LOG==1)
+    // Payload is 2 for an override activation, 0 for a deactivation
+    storageMgr_logEvent(EVENT_ACTIVATION, flag ? 2 : 0);
+#endif
 }
 
 /**
@@ -443,6 +783,78 @@ void storageMgr_resetRedFlagAndMap(void) {
     memset(stData.redFlagThreshTable, 0, sizeof(stData.redFlagThreshTable));
 }
 
+#if (MINUTE_FLOW_CAPTURE==1)
+/**
+* \brief Write the minute capture configuration received from 
+*        an OTA message to the INFO D section.  Data is the mode
+*        (MINUTE_CAPTURE_MODE_xxx), three bytes of hour bits (bit
+*        0 of the first byte is storage hour 0) and the scale
+*        (minute flow unit is (1 << scale) mL).  Mode zero stops
+*        capturing.  At most MINUTE_CAPTURES_PER_WEEKLY_LOG hours
+*        can be armed, as that is all a weekly log holds.
+* \ingroup PUBLIC_API
+* 
+* @param dataP A pointer to the configuration received from the 
+*              OTA message.
+* 
+* @return bool False if the configuration is not valid or arms
+*         more hours than a weekly log holds.
+*/
+bool storageMgr_setMinuteCaptureConfig(uint8_t *dataP) {
+    storageConfig_t config;
+    uint8_t armedHours = 0;
+    uint8_t hour;
+    for (hour = 0; hour < TOTAL_HOURS_IN_A_DAY; hour++) {
+        if (dataP[1 + (hour >> 3)] & (1 << (hour & 7))) {
+            armedHours++;
+        }
+    }
+    if ((dataP[0] > MINUTE_CAPTURE_MODE_RED_FLAG) || (dataP[4] > MINUTE_CAPTURE_SCALE_MASK) ||
+        (armedHours > MINUTE_CAPTURES_PER_WEEKLY_LOG)) {
+        return false;
+    }
+    getStorageConfig(&config);
+    config.captureMode = dataP[0];
+    config.captureHours[0] = dataP[1];
+    config.captureHours[1] = dataP[2];
+    config.captureHours[2] = dataP[3];
+    config.captureScale = dataP[4];
+    writeStorageConfig(&config);
+    stData.captureMode = config.captureMode;
+    return true;
+}
+#endif
+
+#if (MODEM_ENERGY_BUDGET==1) || (MODEM_TRANSMIT_SPREAD==1)
+/**
+* \brief Write the modem settings to the configuration record in
+*        the INFO D section.  The values are checked by the modem
+*        modules (see modemMgr_setBudgetConfig).
+* \ingroup PUBLIC_API
+* 
+* @param configP The modem settings
+*/
+void storageMgr_setModemConfig(modemConfig_t *configP) {
+    storageConfig_t config;
+    getStorageConfig(&config);
+    config.modem = *configP;
+    writeStorageConfig(&config);
+}
+
+/**
+* \brief Read the modem settings.  All zero if the configuration 
+*        record is not valid.
+* \ingroup PUBLIC_API
+* 
+* @param configP Filled in with the modem settings
+*/
+void storageMgr_getModemConfig(modemConfig_t *configP) {
+    storageConfig_t config;
+    getStorageConfig(&config);
+    *configP = config.modem;
+}
+#endif
+
 /**
 * \brief Resets flash for all weekly logs.  This erases all 
 *        weekly log containers and resets the current weekly log
@@ -451,7 +863,6 @@ void storageMgr_resetRedFlagAndMap(void) {
 */
 void storageMgr_resetWeeklyLogs(void) {
     int i;
-    stData.prevWeeklyLogNum = WEEKLY_LOG_NUM_MAX - 1;
     stData.curWeeklyLogNum = 0;
     for (i = 0; i < WEEKLY_LOG_NUM_MAX; i++) {
         eraseWeeklyLog(i);
@@ -468,38 +879,51 @@ uint32_t reportLastHour(void) {
 }
 
 /**
- * \brief This function is used to identify the next daily log of
- *        the current week that is ready to transmit.  If there
- *        is a log ready for transmit, the pointer and size are
- *        returned. If no daily log is ready for transmit, the
- *        function returns 0.  If a daily log pointer is
- *        returned, then that daily log is marked as being
- *        transmitted in the weekly info meta data.  The function
- *        starts searching the weekly info meta data for the first
- *        day of the week, and sequentially checks each day until
- *        a daily log is found that has not yet been transmitted.
-* \ingroup PUBLIC_API
+ * \brief This function is used to identify the next daily log 
+ *        of the transmit backlog.  The weekly log indexes are
+ *        checked, oldest weekly log first, for a daily log that
+ *        is ready and has not yet been transmitted.  Daily logs
+ *        already handed out in the current modem session (set in
+ *        the session mask) are skipped.  If a daily log is found,
+ *        its pointer and size are returned and its bit is set in
+ *        the session mask. If no daily log is pending, the
+ *        function returns 0.
+ *  
+ * \note The daily log is not marked as transmitted here.  The 
+ *       caller marks all the daily logs of the session with
+ *       storageMgr_markDailyLogsAsTransmitted once the session
+ *       completed successfully.  Daily logs of a failed session
+ *       stay in the backlog.
+ * \ingroup PUBLIC_API
  * 
  * \param dataPP Pointer to a pointer that is filled in with the
  *               address of the daily log.
- * \param weeklyLogNum  Which weekly log to transmit from.
+ * \param sessionMaskP Pointer to the mask of daily logs already 
+ *        handed out in the current session.  Bit
+ *        (weeklyLogNum * 7 + dayOfTheWeek) represents a daily
+ *        log.
  * 
  * \return uint16_t Size of the daily log to send, otherwise set
  *         to zero if no daily log is ready to transmit
  */
-uint16_t storageMgr_getNextDailyLogToTransmit(uint8_t **dataPP, uint8_t weeklyLogNum) {
-    uint8_t i;
-    uint16_t length = 0;
-    // Loop for each day of the week until a daily log is found
-    // that is ready and has not been transmitted.
-    for (i = 0; i < TOTAL_DAYS_IN_A_WEEK; i++) {
-        // Get the flags to check if daily log is ready
-        // and has not yet been transmitted.
-        bool logReady = isDailyLogReady(i, weeklyLogNum);
-        bool wasTransmitted = wasDailyLogTransmitted(i, weeklyLogNum);
-        if (logReady && !wasTransmitted) {
+uint16_t storageMgr_getNextDailyLogToTransmit(uint8_t **dataPP, uint16_t *sessionMaskP) {
+    uint8_t j;
+    uint8_t dayMask;
+    uint8_t dayOfTheWeek;
+    // Start with the oldest weekly log (the one after the current).
+    uint8_t weeklyLogNum = getNextWeeklyLogNum(stData.curWeeklyLogNum);
+    for (j = 0; j < WEEKLY_LOG_NUM_MAX; j++) {
+        // Daily logs that are ready, not transmitted and not yet
+        // handed out in this session.
+        dayMask = getPendingDailyLogs(weeklyLogNum) & ~getSessionDailyLogs(*sessionMaskP, weeklyLogNum);
+        if (dayMask) {
+            dayOfTheWeek = getFirstDailyLog(dayMask);
             // Get the address of the daily log
-            dailyPacket_t *dpP = getDailyPacketAddr(weeklyLogNum, i);
+            dailyPacket_t *dpP = getDailyPacketAddr(weeklyLogNum, dayOfTheWeek);
+#if (DAILY_PACKET_CRC==1)
+            // Never send data that does not match its CRC
+            checkDailyPacket(dpP);
+#endif
             *dataPP = (uint8_t *)dpP;
             // The daily packet structure is defined so that it will be exactly 128
             // bytes in flash, and 128 bytes when we send it to the server.
@@ -509,15 +933,366 @@ uint16_t storageMgr_getNextDailyLogToTransmit(uint8_t **dataPP, uint8_t weeklyLo
             // for transmission.  We do this by adjusting the pointer ahead by
             // two bytes, and also adjusting the size by two bytes (hence the "- 2").
             *dataPP += 2;
-            length = sizeof(dailyPacket_t) - 2;
-            // Mark this daily log as being transmitted
-            markDailyLogAsTransmitted(i, weeklyLogNum);
-            break;
+            // Track that this daily log was handed out in this session
+            *sessionMaskP |= (uint16_t)1 << ((weeklyLogNum * TOTAL_DAYS_IN_A_WEEK) + dayOfTheWeek);
+            return (sizeof(dailyPacket_t) - 2);
+        }
+        weeklyLogNum = getNextWeeklyLogNum(weeklyLogNum);
+    }
+    return 0;
+}
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+ * \brief Build the next multi-day message (MSG_TYPE_MULTI_DAY) 
+ *        of the transmit backlog: up to maxDays daily logs, oldest
+ *        first, as storageMgr_getNextDailyLogToTransmit hands them
+ *        out.  The payload is read by the modem command module
+ *        with storageMgr_getMultiDaySegment:
+ *
+ * \li The header of the oldest day (14 bytes: product ID, GMT 
+ *     time, firmware version, days activated, weeks, day of the
+ *     week, 0xA5)
+ * \li For each day: the day offset from the oldest day (1 byte), 
+ *     then the daily log data up to the red flag and the
+ *     integrity byte (90 bytes).
+ *
+ * The header fields of each day follow from the oldest day and 
+ * the offset: the days activated (if not zero), the weeks and
+ * day of the week, and the date (the GMT time of a storage day
+ * start is one day after the one before).  A day that does not
+ * follow (other product ID or firmware version, days activated
+ * not counting with the offset) ends the message and starts the
+ * next one.
+ * \note The daily logs are not marked as transmitted here (see 
+ *       storageMgr_getNextDailyLogToTransmit).
+ * \ingroup PUBLIC_API
+ * 
+ * \param sessionMaskP Pointer to the mask of daily logs already 
+ *        handed out in the current session (see
+ *        storageMgr_getNextDailyLogToTransmit).
+ * \param maxDays Maximum number of daily logs to pack
+ * \param numDaysP Filled in with the number of daily logs packed
+ * 
+ * \return uint16_t Size of the multi-day payload, otherwise set 
+ *         to zero if no daily log is ready to transmit
+ */
+uint16_t storageMgr_getNextMultiDayToTransmit(uint16_t *sessionMaskP, uint8_t maxDays, uint8_t *numDaysP) {
+    uint8_t j;
+    uint8_t dayMask;
+    uint8_t dayOfTheWeek;
+    uint8_t numDays = 0;
+    dailyPacket_t *firstP = NULL;
+    // Start with the oldest weekly log (the one after the current).
+    uint8_t weeklyLogNum = getNextWeeklyLogNum(stData.curWeeklyLogNum);
+
+    stData.multiDayMask = 0;
+    stData.multiDayWeeklyLogNum = weeklyLogNum;
+    for (j = 0; j < WEEKLY_LOG_NUM_MAX; j++) {
+        dayMask = getPendingDailyLogs(weeklyLogNum) & ~getSessionDailyLogs(*sessionMaskP, weeklyLogNum);
+        for (dayOfTheWeek = 0; dayMask && (numDays < maxDays); dayOfTheWeek++, dayMask >>= 1) {
+            if (dayMask & 1) {
+                dailyPacket_t *dpP = getDailyPacketAddr(weeklyLogNum, dayOfTheWeek);
+                uint16_t bit = (uint16_t)1 << ((weeklyLogNum * TOTAL_DAYS_IN_A_WEEK) + dayOfTheWeek);
+                if (!firstP) {
+                    firstP = dpP;
+                } else if (!isMultiDayMatch(firstP, dpP)) {
+                    // The day starts the next message
+                    maxDays = numDays;
+                    break;
+                }
+#if (DAILY_PACKET_CRC==1)
+                // Never send data that does not match its CRC
+                checkDailyPacket(dpP);
+#endif
+                stData.multiDayMask |= bit;
+                *sessionMaskP |= bit;
+                numDays++;
+            }
+        }
+        weeklyLogNum = getNextWeeklyLogNum(weeklyLogNum);
+    }
+    *numDaysP = numDays;
+    if (!numDays) {
+        return 0;
+    }
+    return (MULTI_DAY_HEADER_LENGTH + ((uint16_t)numDays * (1 + MULTI_DAY_LOG_LENGTH)));
+}
+
+/**
+ * \brief Return a segment of the multi-day message built by 
+ *        storageMgr_getNextMultiDayToTransmit (the
+ *        modemCmdPayloadFunc_t of the send data command).
+ *        Segment 0 is the shared header, then two segments per
+ *        day: the day offset and the daily log data.
+ * \note Called from the UART transmit ISR.
+ * \ingroup PUBLIC_API
+ * 
+ * \param segment The segment number
+ * \param dataPP Pointer to a pointer that is filled in with the 
+ *               address of the segment.
+ * 
+ * \return uint16_t Size of the segment, zero after the last one
+ */
+uint16_t storageMgr_getMultiDaySegment(uint8_t segment, uint8_t **dataPP) {
+    dailyPacket_t *firstP = getMultiDayPacket(0);
+    dailyPacket_t *dpP;
+
+    if (!firstP) {
+        return 0;
+    }
+    if (segment == 0) {
+        // Skip the two bytes replaced by the modem command module
+        *dataPP = &firstP->packetHeader.bytes[2];
+        return MULTI_DAY_HEADER_LENGTH;
+    }
+    segment--;
+    dpP = getMultiDayPacket(segment / MULTI_DAY_SEGMENTS_PER_DAY);
+    if (!dpP) {
+        return 0;
+    }
+    if ((segment % MULTI_DAY_SEGMENTS_PER_DAY) == 0) {
+        stData.multiDayOffset = getMultiDayOffset(firstP, dpP);
+        *dataPP = &stData.multiDayOffset;
+        return 1;
+    }
+    *dataPP = dpP->packetData.bytes;
+    return MULTI_DAY_LOG_LENGTH;
+}
+#endif
+
+/**
+* \brief Mark the daily logs of a successful modem session as 
+*        transmitted.  The transmit index of each weekly log is
+*        updated with a single flash write.  A daily log that is
+*        no longer ready (its weekly log was erased during the
+*        session) is skipped.
+* \ingroup PUBLIC_API
+* 
+* @param sessionMask Mask of the daily logs sent in the session 
+*        (see storageMgr_getNextDailyLogToTransmit).
+*/
+void storageMgr_markDailyLogsAsTransmitted(uint16_t sessionMask) {
+    uint8_t weeklyLogNum;
+    uint8_t dayMask;
+    for (weeklyLogNum = 0; weeklyLogNum < WEEKLY_LOG_NUM_MAX; weeklyLogNum++) {
+        dayMask = getSessionDailyLogs(sessionMask, weeklyLogNum) & getPendingDailyLogs(weeklyLogNum);
+        if (dayMask) {
+            markDailyLogsAsTransmitted(dayMask, weeklyLogNum);
         }
     }
+}
+
+#if (MINUTE_FLOW_CAPTURE==1)
+/**
+ * \brief Identify the next minute capture to transmit.  The 
+ *        captures of the weekly logs are checked, oldest weekly
+ *        log first, for a capture that was not transmitted and
+ *        not yet handed out in the current modem session.  The
+ *        capture of the current hour is still being written and
+ *        is skipped.
+ * \note The capture is marked as transmitted by 
+ *       storageMgr_markMinuteCapturesAsTransmitted once the
+ *       session completed successfully.
+ * \ingroup PUBLIC_API
+ * 
+ * \param dataPP Pointer to a pointer that is filled in with the
+ *               address of the capture.
+ * \param sessionMaskP Pointer to the mask of captures already 
+ *        handed out in the current session.  Bit
+ *        (weeklyLogNum * MINUTE_CAPTURES_PER_WEEKLY_LOG + index)
+ *        represents a capture.
+ * 
+ * \return uint16_t Size of the capture to send, otherwise set to
+ *         zero if no capture is ready to transmit
+ */
+uint16_t storageMgr_getNextMinuteCaptureToTransmit(uint8_t **dataPP, uint8_t *sessionMaskP) {
+    uint8_t j;
+    uint8_t i;
+    uint8_t bit;
+    uint8_t curDayHour = (stData.storageTime_dayOfWeek * TOTAL_HOURS_IN_A_DAY) + stData.storageTime_hours;
+    uint8_t weeklyLogNum = getNextWeeklyLogNum(stData.curWeeklyLogNum);
+    for (j = 0; j < WEEKLY_LOG_NUM_MAX; j++) {
+        weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
+        for (i = 0; i < MINUTE_CAPTURES_PER_WEEKLY_LOG; i++) {
+            minuteCapture_t *mcP = &wlP->minuteCaptures[i];
+            bit = 1 << ((weeklyLogNum * MINUTE_CAPTURES_PER_WEEKLY_LOG) + i);
+            if ((mcP->dayHour != MINUTE_CAPTURE_FREE) &&
+                (mcP->control & MINUTE_CAPTURE_UNSENT_BIT) &&
+                !(*sessionMaskP & bit) &&
+                !((weeklyLogNum == stData.curWeeklyLogNum) && (mcP->dayHour == curDayHour))) {
+                *sessionMaskP |= bit;
+                *dataPP = (uint8_t *)mcP;
+                return sizeof(minuteCapture_t);
+            }
+        }
+        weeklyLogNum = getNextWeeklyLogNum(weeklyLogNum);
+    }
+    return 0;
+}
+
+/**
+* \brief Mark the minute captures of a successful modem session 
+*        as transmitted by clearing their unsent bit.
+* \ingroup PUBLIC_API
+* 
+* @param sessionMask Mask of the captures sent in the session 
+*        (see storageMgr_getNextMinuteCaptureToTransmit).
+*/
+void storageMgr_markMinuteCapturesAsTransmitted(uint8_t sessionMask) {
+    uint8_t weeklyLogNum;
+    uint8_t i;
+    for (weeklyLogNum = 0; weeklyLogNum < WEEKLY_LOG_NUM_MAX; weeklyLogNum++) {
+        weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
+        for (i = 0; i < MINUTE_CAPTURES_PER_WEEKLY_LOG; i++) {
+            minuteCapture_t *mcP = &wlP->minuteCaptures[i];
+            // Skip captures erased with their weekly log during the session
+            if ((sessionMask & 1) && (mcP->dayHour != MINUTE_CAPTURE_FREE)) {
+                uint8_t control = mcP->control & ~MINUTE_CAPTURE_UNSENT_BIT;
+                msp430Flash_write_bytes(&mcP->control, &control, FLASH_WRITE_ONE_BYTE);
+            }
+            sessionMask >>= 1;
+        }
+    }
+}
+#endif
+
+#if (RECORD_EVENT_LOG==1)
+/**
+* \brief Append an event to the event log in the INFO C 
+*        section.  Records are programmed into the next free
+*        slot, so the segment is only erased when the log is
+*        full and all events were transmitted; then the log
+*        starts over.  A full log with events still to send
+*        keeps the oldest events and drops the new one.  An
+*        EVENT_RESET starts the next boot number.
+*
+* \note The event log shares the segment with the application 
+*       record (APR) only; the configuration records are not
+*       touched.  After the erase the APR is rewritten only if
+*       it was valid: a new application that has not written it
+*       yet must not look proven to the bootloader.  The other
+*       way around, every APR erase (the bootloader after an
+*       upgrade, Dummy_Isr, initApplicationRecord) also erases
+*       the events not sent yet.
+* \ingroup PUBLIC_API
+* 
+* @param event The event code
+* @param payload Event specific data
+*/
+void storageMgr_logEvent(debugEvents_t event, uint8_t payload) {
+    eventRecord_t *erP = (eventRecord_t *)FLASH_ADDR_TO_PTR(EVENT_LOG_LOCATION);
+    eventRecord_t record;
+    uint8_t i = 0;
+
+    while ((i < EVENT_LOG_RECORDS) && (erP[i].code != EVENT_LOG_FREE)) {
+        i++;
+    }
+    if (event == EVENT_RESET) {
+        // One more than the boot of the last event
+        stData.eventLogBoot = i ? (erP[i - 1].code + (1 << EVENT_LOG_BOOT_SHIFT)) : 0;
+    }
+    if (i == EVENT_LOG_RECORDS) {
+        // Events are sent oldest first, so the last record tells if
+        // everything was sent.
+        if (erP[EVENT_LOG_RECORDS - 1].code & EVENT_LOG_UNSENT_BIT) {
+            return;
+        }
+        // Erase the segment and restore the application record
+        // if there was one
+        if (checkForApplicationRecord()) {
+            initApplicationRecord();
+        } else {
+            msp430Flash_erase_segment(APR_LOCATION);
+        }
+        i = 0;
+    }
+    record.code = ((uint8_t)event & EVENT_LOG_CODE_MASK) |
+                  (stData.eventLogBoot & ~(EVENT_LOG_CODE_MASK | EVENT_LOG_UNSENT_BIT)) |
+                  EVENT_LOG_UNSENT_BIT;
+    record.payload = payload;
+    record.time = getSecondsSinceBoot() >> EVENT_LOG_TIME_SHIFT;
+    msp430Flash_write_bytes(EVENT_LOG_LOCATION + (i * sizeof(eventRecord_t)), (uint8_t *)&record, sizeof(eventRecord_t));
+}
+
+/**
+* \brief Get the next batch of events to transmit.  The event log
+*        message is built in the shared buffer: the standard
+*        message header, the boot stamp (the current boot number
+*        in bits 4-6, then the seconds since boot in units of 64
+*        seconds, MSB first), then up to
+*        EVENT_LOG_RECORDS_PER_MSG events (oldest first) of four
+*        bytes each: code (boot number in bits 4-6, see
+*        EVENT_LOG_BOOT_SHIFT), payload and the time since the
+*        boot of the event in units of 64 seconds (MSB first).
+*        The age of an event of the current boot is the boot
+*        stamp time minus the event time; events of earlier boots
+*        are only ordered.
+* \ingroup PUBLIC_API
+* 
+* @param dataPP Pointer to a pointer that is filled in with the 
+*               address of the message.
+* @param countP Pointer to the number of events already handed
+*               out in the current session.  Updated with the
+*               events of the message.
+* 
+* @return uint16_t Size of the message to send, otherwise set to
+*         zero if no events are left to transmit
+*/
+uint16_t storageMgr_getNextEventLogToTransmit(uint8_t **dataPP, uint8_t *countP) {
+    eventRecord_t *erP = (eventRecord_t *)FLASH_ADDR_TO_PTR(EVENT_LOG_LOCATION);
+    uint8_t *bufP = modemMgr_getSharedBuffer();
+    uint8_t skip = *countP;
+    uint8_t length = 0;
+    uint8_t n = 0;
+    uint8_t i;
+
+    for (i = 0; (i < EVENT_LOG_RECORDS) && (n < EVENT_LOG_RECORDS_PER_MSG); i++, erP++) {
+        if ((erP->code != EVENT_LOG_FREE) && (erP->code & EVENT_LOG_UNSENT_BIT)) {
+            if (skip) {
+                skip--;
+            } else {
+                if (!n) {
+                    uint16_t now = getSecondsSinceBoot() >> EVENT_LOG_TIME_SHIFT;
+                    length = storageMgr_prepareMsgHeader(bufP);
+                    bufP[length++] = stData.eventLogBoot & ~(EVENT_LOG_CODE_MASK | EVENT_LOG_UNSENT_BIT);
+                    bufP[length++] = now >> 8;
+                    bufP[length++] = now & 0xFF;
+                }
+                bufP[length++] = erP->code & ~EVENT_LOG_UNSENT_BIT;
+                bufP[length++] = erP->payload;
+                bufP[length++] = erP->time >> 8;
+                bufP[length++] = erP->time & 0xFF;
+                n++;
+            }
+        }
+    }
+    *countP += n;
+    *dataPP = bufP;
     return length;
 }
 
+/**
+* \brief Mark the events of a successful modem session as 
+*        transmitted by clearing their unsent bit.
+* \ingroup PUBLIC_API
+* 
+* @param count Number of events sent in the session (see 
+*        storageMgr_getNextEventLogToTransmit).
+*/
+void storageMgr_markEventLogAsTransmitted(uint8_t count) {
+    eventRecord_t *erP = (eventRecord_t *)FLASH_ADDR_TO_PTR(EVENT_LOG_LOCATION);
+    uint8_t i;
+    for (i = 0; (i < EVENT_LOG_RECORDS) && count; i++, erP++) {
+        if ((erP->code != EVENT_LOG_FREE) && (erP->code & EVENT_LOG_UNSENT_BIT)) {
+            uint8_t code = erP->code & ~EVENT_LOG_UNSENT_BIT;
+            msp430Flash_write_bytes(EVENT_LOG_LOCATION + (i * sizeof(eventRecord_t)), &code, FLASH_WRITE_ONE_BYTE);
+            count--;
+        }
+    }
+}
+#endif
+
 /**
 * \brief Send debug information to the uart.  
 * \ingroup PUBLIC_API
@@ -531,36 +1306,100 @@ void storageMgr_sendDebugDataToUart(void) {
  * Module Private Functions
  ************************/
 
-static void sendMonthlyCheckin(void) {
-    // Prepare the monthly check-in message
-    // Get the shared buffer (we borrow the ota buffer)
-    uint8_t *payloadP = modemMgr_getSharedBuffer();
-    // Fill in the buffer with the standard message header
-    uint8_t payloadSize = storageMgr_prepareMsgHeader(payloadP);
-    // Initiate sending the monthly check-in message
-    dataMsgMgr_sendDataMsg(MSG_TYPE_CHECKIN, payloadP, payloadSize);
-}
-
 /**
  * \brief Maintain the running sum for the hour.  At the end of 
  *        each minute, add currentMinuteML into the hourly
  *        running sum.
  */
 static void recordLastMinute(void) {
+#if (MINUTE_FLOW_CAPTURE==1)
+    captureLastMinute();
+#endif
     stData.currentHourML += stData.currentMinuteML;
     stData.currentMinuteML = 0;
     // At fifteen minutes, start sending the daily logs of the previous week
     // -OR- the monthly check-in message.
     if ((stData.sendData == true) && (stData.storageTime_minutes == 15)) {
         if (stData.daysActivated) {
-            dataMsgMgr_sendDailyLogs(stData.prevWeeklyLogNum);
+            dataMsgMgr_sendDailyLogs();
         } else if ((stData.storageTime_week % 4) == 0) {
-            sendMonthlyCheckin();
+            dataMsgMgr_sendCheckin();
         }
         stData.sendData = false;
     }
 }
 
+#if (MINUTE_FLOW_CAPTURE==1)
+/**
+ * \brief If the minute capture is armed for the current hour, 
+ *        write the scaled flow of the last minute to the
+ *        capture of the hour.  The capture is started on the
+ *        first captured minute of the hour.  If there is no free
+ *        capture left in the current weekly log, nothing is
+ *        captured until the next weekly log.
+ * \note The mode is cached in stData when the record is 
+ *       validated (storageMgr_init, a configuration write), so
+ *       the record is not checked again each minute.
+ */
+static void captureLastMinute(void) {
+    storageConfig_t *scrP = (storageConfig_t *)FLASH_ADDR_TO_PTR(SCR_LOCATION);
+    uint8_t hour = stData.storageTime_hours;
+    uint8_t dayHour;
+    uint8_t control;
+    uint16_t flow;
+    minuteCapture_t *mcP;
+
+    if (!((stData.captureMode == MINUTE_CAPTURE_MODE_DAILY) ||
+          ((stData.captureMode == MINUTE_CAPTURE_MODE_RED_FLAG) && stData.redFlagCondition))) {
+        return;
+    }
+    if (!(scrP->captureHours[hour >> 3] & (1 << (hour & 7)))) {
+        return;
+    }
+    dayHour = (stData.storageTime_dayOfWeek * TOTAL_HOURS_IN_A_DAY) + hour;
+    control = MINUTE_CAPTURE_UNSENT_BIT |
+              ((stData.storageTime_week << MINUTE_CAPTURE_WEEK_SHIFT) & ~MINUTE_CAPTURE_UNSENT_BIT) |
+              scrP->captureScale;
+    mcP = getMinuteCaptureAddr(stData.curWeeklyLogNum, dayHour, control);
+    if (mcP) {
+        flow = stData.currentMinuteML >> (mcP->control & MINUTE_CAPTURE_SCALE_MASK);
+        if (flow > MINUTE_CAPTURE_MAX_FLOW) {
+            flow = MINUTE_CAPTURE_MAX_FLOW;
+        }
+        control = flow;
+        msp430Flash_write_bytes(&mcP->minuteFlow[stData.storageTime_minutes], &control, FLASH_WRITE_ONE_BYTE);
+    }
+}
+
+/**
+* \brief Find the minute capture of an hour in a weekly log.  If
+*        there is none, start one in the first free capture.
+* 
+* @param weeklyLogNum Which weekly log container
+* @param dayHour The hour of the week (dayOfWeek * 24 + hour)
+* @param control The control byte of a new capture
+* 
+* @return minuteCapture_t* The capture, or NULL if there is no 
+*         free capture.
+*/
+static minuteCapture_t* getMinuteCaptureAddr(uint8_t weeklyLogNum, uint8_t dayHour, uint8_t control) {
+    weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
+    uint8_t i;
+    for (i = 0; i < MINUTE_CAPTURES_PER_WEEKLY_LOG; i++) {
+        minuteCapture_t *mcP = &wlP->minuteCaptures[i];
+        if (mcP->dayHour == dayHour) {
+            return mcP;
+        }
+        if (mcP->dayHour == MINUTE_CAPTURE_FREE) {
+            msp430Flash_write_bytes(&mcP->control, &control, FLASH_WRITE_ONE_BYTE);
+            msp430Flash_write_bytes(&mcP->dayHour, &dayHour, FLASH_WRITE_ONE_BYTE);
+            return mcP;
+        }
+    }
+    return NULL;
+}
+#endif
+
 /**
  * \brief Write the total liters for the current hour into 
  *        flash. Update the running sum for the total daily
@@ -579,7 +1418,7 @@ static void recordLastHour(void) {
     // 11 bits of "liter' information, 1/32nd of sub-liter precision
     // Maximum flow per hour is ~1500 Liters, 11 bits gives us 2048 maximum
     litersForThisHour = (stData.currentHourML >> 5) & 0xffff;  // currentHour stored as long, need to shift down into 16 bits
-    msp430Flash_write_int(addr, litersForThisHour);
+    writeDailyPacketInt(addr, litersForThisHour);
 
     // For daily total, remove the .5 decimal and only store whole liters
     stData.dailyLiters += (litersForThisHour >> 5);
@@ -600,8 +1439,12 @@ static void recordLastHour(void) {
 * \brief Write the pad statistics to the daily log.
 * \note If a new redFlag condition has occurred, then send the 
 *       daily logs completed for this week.
+* 
+* @return bool true if the daily log backlog should be 
+*         transmitted.
 */
-static void recordLastDay(void) {
+static bool recordLastDay(void) {
+    bool sendDailyLogs = false;
     uint16_t i = 0;
     uint8_t *addr;
     uint16_t val16;
@@ -611,25 +1454,23 @@ static void recordLastDay(void) {
     // Get pointer to today's dailyLog in flash.
     dailyLog_t *dailyLogsP = getDailyLogAddr(stData.curWeeklyLogNum, stData.storageTime_dayOfWeek);
 
-    // Write per PAD stats to flash
+    // Write per PAD stats to flash.  The daily packet is written in
+    // address order so its CRC can be computed as it is written.
     for (i = 0; i < 6; i++) {
         addr = 	(uint8_t *)&(dailyLogsP->padMax[i]);
         val16 = waterSense_getPadStatsMax((padId_t)i);
-        msp430Flash_write_int(addr, val16);
-
+        writeDailyPacketInt(addr, val16);
+    }
+    for (i = 0; i < 6; i++) {
         addr = 	(uint8_t *)&(dailyLogsP->padMin[i]);
         val16 = waterSense_padStatsMin((padId_t)i);
-        msp430Flash_write_int(addr, val16);
-
+        writeDailyPacketInt(addr, val16);
+    }
+    for (i = 0; i < 6; i++) {
         addr = 	(uint8_t *)&(dailyLogsP->padSubmerged[i]);
         val16 = waterSense_getPadStatsSubmerged((padId_t)i);
-        msp430Flash_write_int(addr, val16);
-
+        writeDailyPacketInt(addr, val16);
     }
-    // Write overall stats to flash
-    addr = 	(uint8_t *)&(dailyLogsP->unknowns);
-    val16 = waterSense_getPadStatsUnknowns();
-    msp430Flash_write_int(addr, val16);
 
 #if 0
     // FIX ME!!!!
@@ -637,27 +1478,41 @@ static void recordLastDay(void) {
     stData.dailyLiters = getSimulatedDailyLiters(stData.storageTime_week, stData.storageTime_dayOfWeek);
 #endif
 
-    // Mark the current daily log as ready in the weekly log meta data.
-    markDailyLogAsReady(stData.storageTime_dayOfWeek, stData.curWeeklyLogNum);
-
     // Process redFlag conditions
     handle_red_flag();
 
+    // Write the red flag threshold value for today to the daily log
+    writeDailyPacketInt((uint8_t *)&(dailyLogsP->comparedAverage), stData.redFlagThreshTable[stData.storageTime_dayOfWeek]);
+
+    // Write overall stats to flash
+    val16 = waterSense_getPadStatsUnknowns();
+    writeDailyPacketInt((uint8_t *)&(dailyLogsP->unknowns), val16);
+
     // Write the redFlag condition to the daily log
-    msp430Flash_write_bytes((uint8_t *)&(dailyLogsP->redFlag), (uint8_t *)&stData.redFlagCondition, FLASH_WRITE_ONE_BYTE);
+    writeDailyPacketByte((uint8_t *)&(dailyLogsP->redFlag), stData.redFlagCondition);
 
-    // Write the red flag threshold value for today to the daily log
-    msp430Flash_write_int((uint8_t *)&(dailyLogsP->comparedAverage), stData.redFlagThreshTable[stData.storageTime_dayOfWeek]);
+#if (DAILY_PACKET_CRC==1)
+    // Seal the daily log with the CRC of everything written to it
+    msp430Flash_write_bytes((uint8_t *)&(dailyLogsP->crc16), (uint8_t *)&stData.dailyPacketCrc, sizeof(uint16_t));
+#endif
+
+    // Mark the current daily log as ready in the weekly log meta data.
+    markDailyLogAsReady(stData.storageTime_dayOfWeek, stData.curWeeklyLogNum);
 
     // Check if this is a new redFlag condition
     if ((prevRedFlag != stData.redFlagCondition) && (stData.redFlagCondition == true)) {
         newRedFlagCondition = true;
     }
+#if (RECORD_EVENT_LOG==1)
+    if (prevRedFlag != stData.redFlagCondition) {
+        storageMgr_logEvent(EVENT_REDFLAG, stData.redFlagCondition);
+    }
+#endif
 
     // If unit is activated, check if we should transmit information
-    // If this is a new red flag event, then send all ready daily logs for this week.
+    // If this is a new red flag event, then send all ready daily logs.
     if (stData.daysActivated && newRedFlagCondition) {
-        dataMsgMgr_sendDailyLogs(stData.curWeeklyLogNum);
+        sendDailyLogs = true;
     }
 
     // Determine if the unit should be activated.
@@ -667,12 +1522,16 @@ static void recordLastDay(void) {
         stData.daysActivated++;
         // We reset the redFlag data when the unit becomes activated
         storageMgr_resetRedFlagAndMap();
+#if (RECORD_EVENT_LOG==1)
+        // Payload is 1 for an activation by water flow
+        storageMgr_logEvent(EVENT_ACTIVATION, 1);
+#endif
     }
 
 #if (SEND_DAILY_LOG==1)
     // If sending dailyLogs on a daily basis, then send it we are activated.
     if (stData.daysActivated) {
-        dataMsgMgr_sendDailyLogs(stData.curWeeklyLogNum);
+        sendDailyLogs = true;
     }
 #endif
 
@@ -681,6 +1540,8 @@ static void recordLastDay(void) {
 
     // Reset the daily liter sum
     stData.dailyLiters = 0;
+
+    return sendDailyLogs;
 }
 
 /**
@@ -747,6 +1608,38 @@ static void handle_red_flag(void) {
     }
 }
 
+#if (STORAGE_CONFIG_RECORD==1)
+/**
+* \brief Get the storage configuration.  Uses the INFO D record 
+*        if valid, otherwise the defaults.
+* 
+* @param configP Filled in with the configuration
+*/
+static void getStorageConfig(storageConfig_t *configP) {
+    storageConfig_t *scrP = (storageConfig_t *)FLASH_ADDR_TO_PTR(SCR_LOCATION);
+    if ((scrP->magic == SCR_MAGIC) && (scrP->version == SCR_VERSION) &&
+        (scrP->crc16 == gen_crc16((uint8_t *)scrP, (sizeof(storageConfig_t) - sizeof(uint16_t))))) {
+        *configP = *scrP;
+    } else {
+        memset(configP, 0, sizeof(storageConfig_t));
+    }
+}
+
+/**
+* \brief Write the storage configuration record to the INFO D 
+*        section.
+* 
+* @param configP The configuration to write
+*/
+static void writeStorageConfig(storageConfig_t *configP) {
+    configP->magic = SCR_MAGIC;
+    configP->version = SCR_VERSION;
+    configP->crc16 = gen_crc16((uint8_t *)configP, (sizeof(storageConfig_t) - sizeof(uint16_t)));
+    msp430Flash_erase_segment(SCR_LOCATION);
+    msp430Flash_write_bytes(SCR_LOCATION, (uint8_t *)configP, sizeof(storageConfig_t));
+}
+#endif
+
 /**
 * \brief Utility routine to check if the alignment time matches 
 *        the current GMT time for seconds, minutes and hours.
@@ -828,6 +1721,75 @@ static dailyPacket_t* getDailyPacketAddr(uint8_t weeklyLogNum, uint8_t dayOfTheW
     return dailyPacketP;
 }
 
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+* \brief Utility function to get a daily packet of the multi-day 
+*        message, in the order they are sent (oldest first).
+* 
+* @param index Which day of the message
+* 
+* @return dailyPacket_t* Pointer to the packet, NULL if the 
+*         message has fewer days.
+*/
+static dailyPacket_t* getMultiDayPacket(uint8_t index) {
+    uint8_t j;
+    uint8_t dayOfTheWeek;
+    uint8_t dayMask;
+    uint8_t weeklyLogNum = stData.multiDayWeeklyLogNum;
+    for (j = 0; j < WEEKLY_LOG_NUM_MAX; j++) {
+        dayMask = getSessionDailyLogs(stData.multiDayMask, weeklyLogNum);
+        for (dayOfTheWeek = 0; dayMask; dayOfTheWeek++, dayMask >>= 1) {
+            if ((dayMask & 1) && (index-- == 0)) {
+                return getDailyPacketAddr(weeklyLogNum, dayOfTheWeek);
+            }
+        }
+        weeklyLogNum = getNextWeeklyLogNum(weeklyLogNum);
+    }
+    return NULL;
+}
+
+/**
+* \brief Utility function to get the storage days from the first 
+*        day of a multi-day message to a daily packet (from the
+*        weeks and day of the week of the headers).
+* 
+* @param firstP The first (oldest) daily packet of the message
+* @param dpP The daily packet
+* 
+* @return uint8_t The day offset
+*/
+static uint8_t getMultiDayOffset(dailyPacket_t *firstP, dailyPacket_t *dpP) {
+    dailyHeader_t *firstHeaderP = &firstP->packetHeader.dailyHeader;
+    dailyHeader_t *headerP = &dpP->packetHeader.dailyHeader;
+    uint8_t weeks = headerP->weeks - firstHeaderP->weeks;
+    return (uint8_t)((weeks * TOTAL_DAYS_IN_A_WEEK) + headerP->reserve2 - firstHeaderP->reserve2);
+}
+
+/**
+* \brief Check that the header of a daily packet follows from 
+*        the first day of a multi-day message and the day offset.
+* 
+* @param firstP The first (oldest) daily packet of the message
+* @param dpP The daily packet
+* 
+* @return bool True if the day can be sent in the message
+*/
+static bool isMultiDayMatch(dailyPacket_t *firstP, dailyPacket_t *dpP) {
+    dailyHeader_t *firstHeaderP = &firstP->packetHeader.dailyHeader;
+    dailyHeader_t *headerP = &dpP->packetHeader.dailyHeader;
+    uint16_t firstDays = (firstHeaderP->daysActivatedMsb << 8) | firstHeaderP->daysActivatedLsb;
+    uint16_t days = (headerP->daysActivatedMsb << 8) | headerP->daysActivatedLsb;
+
+    if (firstDays) {
+        firstDays += getMultiDayOffset(firstP, dpP);
+    }
+    return ((headerP->productId == firstHeaderP->productId) &&
+            (headerP->fwMajor == firstHeaderP->fwMajor) &&
+            (headerP->fwMinor == firstHeaderP->fwMinor) &&
+            (days == firstDays));
+}
+#endif
+
 /**
 * \brief   Utility function to increment to the next weekly log.
 *          Handles rollover condition.
@@ -862,7 +1824,6 @@ static void eraseWeeklyLog(uint8_t weeklyLogNum) {
 static void prepareNextWeeklyLog(void) {
     volatile uint8_t curWeeklyLogNum = stData.curWeeklyLogNum;
     volatile uint8_t nextWeeklyLogNum = getNextWeeklyLogNum(curWeeklyLogNum);
-    stData.prevWeeklyLogNum = curWeeklyLogNum;
     stData.curWeeklyLogNum = nextWeeklyLogNum;
     eraseWeeklyLog(nextWeeklyLogNum);
 }
@@ -873,99 +1834,195 @@ static void prepareNextWeeklyLog(void) {
 static void prepareDailyLog(void) {
     dailyHeader_t *dailyHeaderP = getDailyHeaderAddr(stData.curWeeklyLogNum, stData.storageTime_dayOfWeek);
     timePacket_t *tp = getBinTime();
-    uint8_t temp8;
+
+#if (DAILY_PACKET_CRC==1)
+    // Start the CRC of the new daily packet
+    stData.dailyPacketCrc = 0;
+#endif
 
     // Product ID
-    temp8 = OUTPOUR_PRODUCT_ID;
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->productId), &temp8, FLASH_WRITE_ONE_BYTE);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->productId), OUTPOUR_PRODUCT_ID);
 
     // Time
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->GMTsecond), &tp->second, FLASH_WRITE_ONE_BYTE);
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->GMTminute), &tp->minute, FLASH_WRITE_ONE_BYTE);
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->GMThour),   &tp->hour24, FLASH_WRITE_ONE_BYTE);
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->GMTday),    &tp->day,    FLASH_WRITE_ONE_BYTE);
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->GMTmonth),  &tp->month,  FLASH_WRITE_ONE_BYTE);
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->GMTyear),   &tp->year,   FLASH_WRITE_ONE_BYTE);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->GMTsecond), tp->second);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->GMTminute), tp->minute);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->GMThour),   tp->hour24);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->GMTday),    tp->day);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->GMTmonth),  tp->month);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->GMTyear),   tp->year);
 
     // FW Version
-    temp8 = FW_VERSION_MAJOR;
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->fwMajor), &temp8, FLASH_WRITE_ONE_BYTE);
-    temp8 = FW_VERSION_MINOR;
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->fwMinor), &temp8, FLASH_WRITE_ONE_BYTE);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->fwMajor), FW_VERSION_MAJOR);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->fwMinor), FW_VERSION_MINOR);
 
     // Days Activated
-    msp430Flash_write_int((uint8_t *)&(dailyHeaderP->daysActivatedMsb), stData.daysActivated);
+    writeDailyPacketInt((uint8_t *)&(dailyHeaderP->daysActivatedMsb), stData.daysActivated);
 
     // weeks
-    temp8 = stData.storageTime_week;
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->weeks), &temp8, FLASH_WRITE_ONE_BYTE);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->weeks), stData.storageTime_week);
 
     // day of the week
-    temp8 = stData.storageTime_dayOfWeek;
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->reserve2), &temp8, FLASH_WRITE_ONE_BYTE);
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->reserve2), stData.storageTime_dayOfWeek);
+
+    writeDailyPacketByte((uint8_t *)&(dailyHeaderP->reserve3), 0xA5);
+}
+
+/**
+* \brief Write one byte of today's daily packet to flash and add
+*        it to the running CRC of the packet (DAILY_PACKET_CRC).
+* \note The daily packet must be written in address order.
+* 
+* @param addr The flash address
+* @param val The value to write
+*/
+static void writeDailyPacketByte(uint8_t *addr, uint8_t val) {
+    msp430Flash_write_bytes(addr, &val, FLASH_WRITE_ONE_BYTE);
+#if (DAILY_PACKET_CRC==1)
+    stData.dailyPacketCrc = gen_crc16_byte(stData.dailyPacketCrc, val);
+#endif
+}
 
-    temp8 = 0xA5;
-    msp430Flash_write_bytes((uint8_t *)&(dailyHeaderP->reserve3), &temp8, FLASH_WRITE_ONE_BYTE);
+/**
+* \brief Write a 16 bit value of today's daily packet to flash 
+*        (MSB first, see msp430Flash_write_int) and add it to the
+*        running CRC of the packet (DAILY_PACKET_CRC).
+* 
+* @param addr The flash address
+* @param val The value to write
+*/
+static void writeDailyPacketInt(uint8_t *addr, uint16_t val) {
+    msp430Flash_write_int(addr, val);
+#if (DAILY_PACKET_CRC==1)
+    stData.dailyPacketCrc = gen_crc16_byte(stData.dailyPacketCrc, val >> 8);
+    stData.dailyPacketCrc = gen_crc16_byte(stData.dailyPacketCrc, val & 0xFF);
+#endif
+}
+
+#if (DAILY_PACKET_CRC==1)
+/**
+* \brief Calculate the CRC of a daily packet from flash.  Covers
+*        the same bytes, in the same order, as the running CRC
+*        computed while the packet was written.
+* 
+* @param dpP The daily packet
+* 
+* @return uint16_t The CRC
+*/
+static uint16_t getDailyPacketCrc(dailyPacket_t *dpP) {
+    uint8_t *bP = &dpP->packetHeader.bytes[DAILY_PACKET_CRC_HEADER_START];
+    uint8_t *endP = &dpP->packetData.bytes[DAILY_PACKET_CRC_DATA_LENGTH];
+    uint16_t crc = 0;
+    // The header and the data are contiguous
+    while (bP < endP) {
+        crc = gen_crc16_byte(crc, *bP++);
+    }
+    return crc;
+}
+
+/**
+* \brief Check a daily packet against its CRC before it is 
+*        transmitted.  If the check fails (for example a word
+*        that was not completely programmed), the measurement
+*        data is zeroed and the integrity byte is set so the
+*        daily log is sent flagged instead of with bad numbers.
+*        The header is kept so the day can be identified.
+* 
+* @param dpP The daily packet
+*/
+static void checkDailyPacket(dailyPacket_t *dpP) {
+    dailyLog_t *dlP = &dpP->packetData.dailyLog;
+    uint8_t *bP;
+    uint8_t flag = DAILY_LOG_INTEGRITY_BAD;
+    if ((dlP->integrity == DAILY_LOG_INTEGRITY_BAD) || (dlP->crc16 == getDailyPacketCrc(dpP))) {
+        return;
+    }
+    // Zero bits can always be programmed over any flash contents
+    for (bP = &dpP->packetData.bytes[0]; bP < &dlP->redFlag; bP += sizeof(uint16_t)) {
+        msp430Flash_write_int(bP, 0);
+    }
+    msp430Flash_write_bytes(&dlP->integrity, &flag, FLASH_WRITE_ONE_BYTE);
 }
+#endif
 
 /**
 * \brief Updates the record for tracking that a daily log is
-*        ready for transmit.
+*        ready for transmit.  The day bit is cleared in the
+*        ready index of the weekly log.
 * 
 * @param dayOfTheWeek The day of the week to record
 * @param weeklyLogNum The weekly log container to use
 */
 static void markDailyLogAsReady(uint8_t dayOfTheWeek, uint8_t weeklyLogNum) {
-    uint8_t zeroVal = 0;
+    uint16_t index;
     weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
     if (dayOfTheWeek >= TOTAL_DAYS_IN_A_WEEK) {
         return;
     }
-    uint8_t *entryP = &(wlP->clearOnReady[dayOfTheWeek]);
-    msp430Flash_write_bytes(entryP, &zeroVal, FLASH_WRITE_ONE_BYTE);
+    // Written in native byte order (msp430Flash_write_int writes MSB first)
+    index = wlP->clearOnReadyIndex & ~(1 << dayOfTheWeek);
+    msp430Flash_write_bytes((uint8_t *)&(wlP->clearOnReadyIndex), (uint8_t *)&index, sizeof(index));
 }
 
 /**
-* \brief Utility function to check if a daily log is ready for
-*        transmit.
+* \brief Utility function to get the daily logs of a weekly log 
+*        that are ready for transmit and have not been
+*        transmitted.
 * 
-* @param dayOfTheWeek The day of the week to record
 * @param weeklyLogNum The weekly log container to use
+* 
+* @return uint8_t Bit mask of the pending daily logs (bit 0 is 
+*         day 0).
 */
-static bool isDailyLogReady(uint8_t dayOfTheWeek, uint8_t weeklyLogNum) {
+static uint8_t getPendingDailyLogs(uint8_t weeklyLogNum) {
     weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
-    bool isReady = !wlP->clearOnReady[dayOfTheWeek];
-    return isReady;
+    // A cleared ready bit and a set transmit bit means the daily
+    // log is pending.
+    return (~wlP->clearOnReadyIndex & wlP->clearOnTransmitIndex) & DAILY_LOG_INDEX_WEEK_MASK;
 }
 
 /**
-* \brief Updates the record for tracking that a daily log has 
-*        been transmitted.
+* \brief Updates the record for tracking that daily logs have 
+*        been transmitted.  All the day bits are cleared in the
+*        transmit index of the weekly log with one flash write.
 * 
-* @param dayOfTheWeek The day of the week to record
+* @param dayMask The days of the week to record (bit 0 is day 0)
 * @param weeklyLogNum The weekly log container to use
 */
-static void markDailyLogAsTransmitted(uint8_t dayOfTheWeek, uint8_t weeklyLogNum) {
-    uint8_t zeroVal = 0;
+static void markDailyLogsAsTransmitted(uint8_t dayMask, uint8_t weeklyLogNum) {
     weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
-    uint8_t *entryP = (uint8_t *)&(wlP->clearOnTransmit[dayOfTheWeek]);
-    if (dayOfTheWeek >= TOTAL_DAYS_IN_A_WEEK) {
-        return;
-    }
-    msp430Flash_write_bytes(entryP, &zeroVal, FLASH_WRITE_ONE_BYTE);
+    // Written in native byte order (msp430Flash_write_int writes MSB first)
+    uint16_t index = wlP->clearOnTransmitIndex & ~dayMask;
+    msp430Flash_write_bytes((uint8_t *)&(wlP->clearOnTransmitIndex), (uint8_t *)&index, sizeof(index));
 }
 
 /**
-* \brief Utility function to check if a daily log has been 
-*        transmitted.
+* \brief Utility function to extract the days of a weekly log 
+*        from a session mask.  The session mask is a uint16_t,
+*        so a maximum of 16 daily logs (WEEKLY_LOG_NUM_MAX * 7)
+*        can be tracked.
 * 
-* @param dayOfTheWeek The day of the week to record
-* @param weeklyLogNum The weekly log container to use
+* @param sessionMask Mask of the daily logs of the session
+* @param weeklyLogNum The weekly log container
+* 
+* @return uint8_t Bit mask of the days (bit 0 is day 0)
 */
-static bool wasDailyLogTransmitted(uint8_t dayOfTheWeek, uint8_t weeklyLogNum) {
-    weeklyLog_t *wlP = getWeeklyLogAddr(weeklyLogNum);
-    // If zero, it means we transmitted packet.
-    return (wlP->clearOnTransmit[dayOfTheWeek] ? false : true);
+static uint8_t getSessionDailyLogs(uint16_t sessionMask, uint8_t weeklyLogNum) {
+    return (sessionMask >> (weeklyLogNum * TOTAL_DAYS_IN_A_WEEK)) & DAILY_LOG_INDEX_WEEK_MASK;
+}
+
+/**
+* \brief Utility function to find the first (oldest) day set in 
+*        a day mask.  Uses two nibble table lookups.
+* 
+* @param dayMask Bit mask of the days (must not be zero)
+* 
+* @return uint8_t The day of the week
+*/
+static uint8_t getFirstDailyLog(uint8_t dayMask) {
+    if (dayMask & 0x0F) {
+        return firstBitTable[dayMask & 0x0F];
+    }
+    return 4 + firstBitTable[dayMask >> 4];
 }
 
 /**
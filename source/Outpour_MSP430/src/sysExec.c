@@ -67,6 +67,8 @@ sysExecData_t sysExecData;
 */
 void sysExec_exec(void) {
 
+    uint32_t tick;
+
     memset(&sysExecData, 0, sizeof(sysExecData_t));
 
     // Start the timer interrupt
@@ -107,9 +109,11 @@ void sysExec_exec(void) {
         dataMsgMgr_exec();
         otaMsgMgr_exec();
         fassMsgMgr_exec();
-        modemMgr_exec();
         modemCmd_exec();
         modemLink_exec();
+#if (MODEM_ENERGY_BUDGET==1)
+        modemMgr_exec();
+#endif
 
 #if (SEND_DEBUG_INFO_TO_UART==1)
         // Only send debug data if the modem is not in use.
@@ -118,8 +122,15 @@ void sysExec_exec(void) {
         }
 #endif
 
-        // sleep, wake on Timer1A interrupt
+        // sleep, wake on Timer1A interrupt.  A modem command that is
+        // done between the ticks wakes us up too, to start the next
+        // queued command without waiting for the tick.
+        tick = getSecondsSinceBoot();
         __bis_SR_register(LPM3_bits);
+        while (tick == getSecondsSinceBoot()) {
+            modemCmd_exec();
+            __bis_SR_register(LPM3_bits);
+        }
 
         // If an OTA reset device message has been received, then rebootActive
         // will be true, waiting for the delay time to expire to perform
@@ -21,6 +21,7 @@
 *  Timer allocation/usage for Outpour APPLICATION:
 *    A0, Capture control channel 0 used with capacitance reading (no ISR)
 *    A1, Capture control channel 0 used for system tick (with ISR, vector = 13 @ 0FFFAh)
+*    A1, Capture control channel 1 used for short sleeps, with MODEM_LINK_FAST_POWER_UP (with ISR, vector = 12 @ 0FFF8h)
 *
 *  Timer allocation/usage for Outpour BOOT:
 *    A0, Capture control channel 0 used for system tick (with ISR, vector = 9 @ 0FFF2h)
@@ -62,6 +63,15 @@ static timePacket_t tp;
 */
 static volatile uint32_t seconds_since_boot = 0;
 
+/*********************
+ * Module Prototypes
+ *********************/
+#if (GMT_CLOCKSET_ONE_STEP==1)
+static uint8_t char_to_bcd(uint8_t value);
+static uint32_t daysSinceEpoch(uint16_t year, uint8_t month, uint8_t day);
+static void dateFromEpochDays(uint32_t days, uint16_t *yearP, uint8_t *monthP, uint8_t *dayP);
+#endif
+
 /**
 * \brief Initialize and start timerA1 for the one second system 
 *        tick.  Uses Timer A1, capture/control channel 0, vector
@@ -87,6 +97,99 @@ uint32_t getSecondsSinceBoot(void) {
     return seconds_since_boot;
 }
 
+#if (FINE_TICK_TIME==1)
+/**
+* \brief Retrieve a fine grained time since boot: the seconds 
+*        since boot plus the fraction of the current second
+*        counted by timer A1, in 1/FINE_TICKS_PER_SEC units.  Can
+*        be called from an ISR.
+* \ingroup PUBLIC_API
+* 
+* @return fine_tick_t The time since boot in fine ticks.  Wraps 
+*         after 48 days, use GET_ELAPSED_FINE_TICKS.
+*/
+fine_tick_t getFineTicksSinceBoot(void) {
+    volatile uint16_t contextSaveSR;
+    uint32_t seconds;
+    uint16_t count;
+
+    contextSaveSR = __get_SR_register();
+    __bic_SR_register(GIE);
+
+    // The timer counts ACLK, asynchronous to the CPU clock.  Read the
+    // count until two reads match.
+    do {
+        count = TA1R;
+    } while (count != TA1R);
+    seconds = seconds_since_boot;
+    // If the count wrapped but the tick ISR has not run yet, the
+    // second is not counted yet.
+    if ((TA1CCTL0 & CCIFG) && (count < (TA1CCR0 >> 1))) {
+        seconds++;
+    }
+
+    // If the GIE was set, restore it.
+    if (contextSaveSR & GIE) {
+        __bis_SR_register(GIE);
+    }
+
+    // The count runs 0 to 0x8000 per second
+    return (seconds << FINE_TICK_SHIFT) + (count >> (15 - FINE_TICK_SHIFT));
+}
+#endif
+
+#if (MODEM_LINK_FAST_POWER_UP==1)
+/**
+* \brief Sleep in LPM3 for a fraction of a second.  Uses Timer A1,
+*        capture/control channel 1 to wake up.  Used by the
+*        modem power up to sequence the supplies without waiting
+*        for the next system tick.
+* \ingroup PUBLIC_API
+*
+* \note Must be called with the global interrupt enabled.  Keep
+*       the total sleep time per second short: if the system tick
+*       interrupt happens while sleeping, the main loop misses
+*       that tick.
+*
+* @param fineTicks Time to sleep in fine ticks (less than one
+*                  second)
+*/
+void timerA1_sleepFineTicks(uint16_t fineTicks) {
+    fine_tick_t start = GET_FINE_TICK();
+    fine_tick_t elapsed;
+    uint16_t count;
+
+    while ((elapsed = GET_ELAPSED_FINE_TICKS(start)) < fineTicks) {
+        __bic_SR_register(GIE);
+        do {
+            count = TA1R;
+        } while (count != TA1R);
+        count += (uint16_t)(fineTicks - elapsed) << (15 - FINE_TICK_SHIFT);
+        // Past the end of the second, the system tick wakes us up
+        if (count < TA1CCR0) {
+            TA1CCR1 = count;
+            TA1CCTL1 = CCIE;
+        }
+        // Enter LPM3 and enable the interrupt in one instruction
+        __bis_SR_register(LPM3_bits + GIE);
+        TA1CCTL1 = 0;
+    }
+}
+
+/**
+* \brief Timer ISR. Ends a timerA1_sleepFineTicks sleep. Uses
+*        Timer A1, capture/control channel 1, vector 12, 0xFFF8
+* \ingroup ISR
+*/
+#ifndef FOR_USE_WITH_BOOTLOADER
+#pragma vector=TIMER1_A1_VECTOR
+#endif
+__interrupt void ISR_Timer1_A1(void) {
+    TA1CCTL1 = 0;
+    __bic_SR_register_on_exit(LPM3_bits);
+}
+#endif
+
 /**
 * \brief Timer ISR. Produces the 1HZ system tick interrupt. 
 *        Uses Timer A1, capture/control channel 0, vector 13,
@@ -164,6 +267,61 @@ timePacket_t* getBcdTime(void) {
     return &tp;
 }
 
+#if (GMT_CLOCKSET_ONE_STEP==1)
+/**
+* \brief Advance the TI calendar by a time offset.  The new date 
+*        and time are computed from the count of days since March
+*        1, 2000 and written in one step, so the time taken does
+*        not depend on the offset.  The TI increment routines
+*        take one call per day, which is over three seconds for
+*        the largest offset of the GMT clock set message.
+* \ingroup PUBLIC_API
+* 
+* \note Call with the system timer interrupt disabled.  The 
+*       daylight savings zone is not applied (the application
+*       runs with NO_DAYLIGHT_SAVINGS).  The date must stay in the
+*       range of the TI calendar (2000 to 2399).
+* 
+* @param binDays Days to advance
+* @param binHours Hours to advance
+* @param binMinutes Minutes to advance
+* @param binSeconds Seconds to advance
+*/
+void advanceBinTime(uint16_t binDays, uint8_t binHours, uint8_t binMinutes, uint8_t binSeconds) {
+    uint16_t year = (bcd_to_char(TI_year >> 8) * 100) + bcd_to_char(TI_year & 0xFF);
+    uint32_t days = daysSinceEpoch(year, bcd_to_char(TI_month) + 1, bcd_to_char(TI_day));
+    uint16_t value;
+    uint8_t second;
+    uint8_t minute;
+    uint8_t hour24;
+    uint8_t month;
+    uint8_t day;
+
+    // Carry field by field - all values fit in 16 bits
+    value = bcd_to_char(TI_second) + binSeconds;
+    second = value % 60;
+    value = (value / 60) + bcd_to_char(TI_minute) + binMinutes;
+    minute = value % 60;
+    value = (value / 60) + bcd_to_char(get24Hour()) + binHours;
+    hour24 = value % 24;
+    days += binDays + (value / 24);
+    dateFromEpochDays(days, &year, &month, &day);
+
+    TI_second = char_to_bcd(second);
+    TI_minute = char_to_bcd(minute);
+    // The calendar keeps a 12 hour clock: 12 AM is midnight
+    TI_PM = (hour24 >= 12);
+    hour24 %= 12;
+    TI_hour = char_to_bcd(hour24 ? hour24 : 12);
+    TI_day = char_to_bcd(day);
+    TI_month = char_to_bcd(month - 1); // RTC lib's month is 0-indexed
+    TI_year = (char_to_bcd(year / 100) << 8) | char_to_bcd(year % 100);
+    // March 1, 2000 was a Wednesday
+    TI_dayOfWeek = (days + WEDNESDAY) % 7;
+    testLeap();
+}
+#endif
+
 /**
  * \brief Utility function to convert a byte of bcd data to a 
  *        binary byte.  BCD data represents a value of 0-99,
@@ -181,3 +339,62 @@ uint8_t bcd_to_char(uint8_t bcdValue) {
     uint8_t ones = bcdValue & 0x0f;
     return (tens + ones);
 }
+
+#if (GMT_CLOCKSET_ONE_STEP==1)
+/**
+ * \brief Utility function to convert a binary byte of 0-99 to 
+ *        bcd.
+ * 
+ * @param value binary value of 0-99.
+ * 
+ * @return uint8_t bcd conversion, each nibble is a digit of 0-9.
+ */
+static uint8_t char_to_bcd(uint8_t value) {
+    uint8_t tens = value / 10;
+    return ((tens << 4) | (value - (tens * 10)));
+}
+
+/**
+ * \brief Count the days since March 1, 2000.  Counting the years 
+ *        from March puts the leap day at the end of the year, and
+ *        2000 starts a 400 year leap cycle.
+ * 
+ * @param year 2000 to 2399 (from March 1, 2000)
+ * @param month 1 to 12
+ * @param day 1 to 31
+ * 
+ * @return uint32_t days since March 1, 2000.
+ */
+static uint32_t daysSinceEpoch(uint16_t year, uint8_t month, uint8_t day) {
+    uint16_t years;
+    uint16_t dayOfYear;
+    // January and February are months 13 and 14 of the year before
+    if (month <= 2) {
+        year--;
+        month += 12;
+    }
+    years = year - 2000;
+    dayOfYear = (((153 * (month - 3)) + 2) / 5) + day - 1;
+    return ((uint32_t)years * 365) + (years / 4) - (years / 100) + dayOfYear;
+}
+
+/**
+ * \brief Get the date of a count of days since March 1, 2000 (the
+ *        inverse of daysSinceEpoch).
+ * 
+ * @param days days since March 1, 2000 (less than 146096, the
+ *             400 year cycle)
+ * @param yearP the year
+ * @param monthP the month, 1 to 12
+ * @param dayP the day, 1 to 31
+ */
+static void dateFromEpochDays(uint32_t days, uint16_t *yearP, uint8_t *monthP, uint8_t *dayP) {
+    // Remove the leap days of the 4 and 100 year cycles
+    uint16_t years = (days - (days / 1460) + (days / 36524)) / 365;
+    uint16_t dayOfYear = days - (((uint32_t)years * 365) + (years / 4) - (years / 100));
+    uint8_t monthFromMarch = ((5 * dayOfYear) + 2) / 153;
+    *dayP = dayOfYear - (((153 * monthFromMarch) + 2) / 5) + 1;
+    *monthP = (monthFromMarch < 10) ? (monthFromMarch + 3) : (monthFromMarch - 9);
+    *yearP = 2000 + years + (*monthP <= 2);
+}
+#endif
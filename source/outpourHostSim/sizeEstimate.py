@@ -0,0 +1,142 @@
+#
+# Estimate the MSP430 code size of the application from host (gcc) builds.
+#
+# The TI link map (Outpour_MSP430/Debug/Outpour_MSP430.map) gives the
+# .text/.const size of each object of the tree it was linked from (the
+# base tree).  Each module of the base tree and of the current tree is
+# compiled with gcc -m32 -Os, and the TI size of a module is estimated as
+# its base TI size scaled by the host size ratio (now / base).
+#
+# The estimate is only a guide for a change that can not be linked with
+# CCS: the final numbers come from the link map of the TI build.  The host
+# .bss is printed as is; pointers are 4 bytes on the host and 2 on the
+# MSP430.
+#
+# From the source directory, with the base tree extracted by
+#   git archive <base commit> source | tar -x -C /tmp/base
+#
+#   python3 outpourHostSim/sizeEstimate.py --base /tmp/base/source [-D NAME=VAL ...]
+#
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# The host sim headers include these, which are not in a freestanding
+# 32 bit install.
+STUB_HEADERS = {
+    'string.h': '#include <stddef.h>\n'
+                'void *memset(void *, int, size_t);\n'
+                'void *memcpy(void *, const void *, size_t);\n'
+                'void *memmove(void *, const void *, size_t);\n'
+                'int memcmp(const void *, const void *, size_t);\n',
+    'stdio.h': 'typedef struct _FILE FILE;\n'
+               'extern FILE *stderr;\n'
+               'extern FILE *stdout;\n'
+               'int printf(const char *, ...);\n'
+               'int fprintf(FILE *, const char *, ...);\n',
+}
+
+# Flash is read through FLASH_ADDR_TO_PTR: a call into the emulated image
+# in the host sims (hostFlash.h), a cast on the MSP430.  Size the cast.
+TARGET_DEFINES = ['FLASH_ADDR_TO_PTR(a)=((uint8_t *)(uintptr_t)(a))']
+
+# Touch sense and the calendar are TI sources the host build can not compile
+# or does not have (RTC_Calendar is assembly).
+SKIP = ('CTS_HAL', 'CTS_Layer', 'structure')
+
+
+def ti_sizes(mapFile):
+    """Return {module: bytes} of the .text and .const input sections."""
+    sizes = {}
+    reSection = re.compile(r'^\s+[0-9a-f]{8}\s+([0-9a-f]{8})\s+(\w+)\.obj \((\.text|\.const)[^)]*\)')
+    with open(mapFile) as f:
+        for line in f:
+            m = reSection.match(line)
+            if m:
+                sizes[m.group(2)] = sizes.get(m.group(2), 0) + int(m.group(1), 16)
+    return sizes
+
+
+def host_sizes(srcDir, includeDirs, defines, cc):
+    """Return {module: (text, bss)} of the host -m32 -Os objects."""
+    sizes = {}
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, text in STUB_HEADERS.items():
+            with open(os.path.join(tmp, name), 'w') as f:
+                f.write(text)
+        for fileName in sorted(os.listdir(srcDir)):
+            module, ext = os.path.splitext(fileName)
+            if ext != '.c' or module in SKIP:
+                continue
+            obj = os.path.join(tmp, module + '.o')
+            cmd = [cc, '-m32', '-Os', '-ffreestanding', '-fno-common', '-w', '-std=gnu99',
+                   '-I' + tmp] + ['-I' + d for d in includeDirs] + ['-I' + srcDir] + \
+                  ['-D' + d for d in TARGET_DEFINES + defines] + ['-c', os.path.join(srcDir, fileName), '-o', obj]
+            if subprocess.call(cmd) != 0:
+                sys.exit('compile failed: ' + fileName)
+            text = 0
+            bss = 0
+            out = subprocess.check_output(['size', '-A', obj]).decode()
+            for line in out.splitlines():
+                fields = line.split()
+                if len(fields) < 2 or not fields[1].isdigit():
+                    continue
+                if fields[0].startswith(('.text', '.rodata')):
+                    text += int(fields[1])
+                elif fields[0].startswith(('.bss', '.data')):
+                    bss += int(fields[1])
+            sizes[module] = (text, bss)
+    return sizes
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Estimate the MSP430 application code size.')
+    parser.add_argument('--src', default='Outpour_MSP430/src', help='application source directory')
+    parser.add_argument('--base', help='source directory of the tree the map was linked from')
+    parser.add_argument('--map', default='Outpour_MSP430/Debug/Outpour_MSP430.map', help='TI link map')
+    parser.add_argument('--free', type=lambda x: int(x, 0), default=0x42, help='flash left in the map')
+    parser.add_argument('--cc', default='gcc')
+    parser.add_argument('-D', dest='defines', action='append', default=[], help='NAME=VAL for the current tree')
+    args = parser.parse_args()
+
+    hostDir = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'src')
+    now = host_sizes(args.src, [hostDir], args.defines, args.cc)
+    if not args.base:
+        for module in sorted(now):
+            print('%-20s text %6d  bss %4d' % (module, now[module][0], now[module][1]))
+        return 0
+
+    ti = ti_sizes(args.map)
+    base = host_sizes(os.path.join(args.base, 'Outpour_MSP430/src'), [hostDir], [], args.cc)
+    totals = [0, 0, 0, 0, 0, 0]
+    print('%-16s %8s %10s %10s %8s %8s %10s' % ('module', 'TI base', 'host base', 'host now', 'TI est', 'delta', 'host bss'))
+    for module in sorted(set(now) | set(base)):
+        hb, bb = base.get(module, (0, 0))
+        hn, bn = now.get(module, (0, 0))
+        tb = ti.get(module, 0)
+        # A module that is new or not in the map is scaled by the overall ratio later.
+        est = (tb * hn // hb) if (hb and tb) else None
+        totals[0] += tb
+        totals[1] += hb
+        totals[2] += hn
+        totals[4] += bn - bb
+        if est is None:
+            print('%-16s %8s %10d %10d %8s %8s %5d->%-4d' % (module, '-', hb, hn, '?', '?', bb, bn))
+            totals[5] += hn - hb
+        else:
+            totals[3] += est - tb
+            print('%-16s %8d %10d %10d %8d %+8d %5d->%-4d' % (module, tb, hb, hn, est, est - tb, bb, bn))
+    # Modules without a map entry use the mean ratio
+    ratio = float(totals[0]) / totals[1] if totals[1] else 0
+    delta = totals[3] + int(totals[5] * ratio)
+    print('%-16s %8d %10d %10d %8s %+8d %+9d' % ('total', totals[0], totals[1], totals[2], '', delta, totals[4]))
+    print('estimated flash left: %d bytes (%d in the map)' % (args.free - delta, args.free))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,450 @@
+/**
+ * @file calendarBench.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Check advanceBinTime of time.c (the GMT clock set)
+ *        against the original increment loops over the TI
+ *        calendar and time both.  The TI calendar
+ *        (RTC_Calendar.asm) is ported to C below, without the
+ *        daylight savings (the application runs with
+ *        NO_DAYLIGHT_SAVINGS).
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "outpour.h"
+
+#if (GMT_CLOCKSET_ONE_STEP==0)
+#error calendarBench needs GMT_CLOCKSET_ONE_STEP
+#endif
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def BENCH_RANDOM_CASES
+ * \brief Default number of random start dates and offsets checked
+ *        against the reference.
+ */
+#define BENCH_RANDOM_CASES ((uint32_t)20000)
+
+/**
+ * \def BENCH_SWEEP_FIRST_YEAR, BENCH_SWEEP_LAST_YEAR
+ * \brief Every day of these years is checked as a start date with
+ *        a short random offset.
+ */
+#define BENCH_SWEEP_FIRST_YEAR ((uint16_t)2015)
+#define BENCH_SWEEP_LAST_YEAR  ((uint16_t)2120)
+
+/**
+ * \def BENCH_TIMED_RUNS
+ * \brief Number of worst case runs timed for advanceBinTime (the
+ *        reference is timed over BENCH_TIMED_RUNS / 1000).
+ */
+#define BENCH_TIMED_RUNS ((uint32_t)1000000)
+
+/**
+ * \def TI_INCREMENT_DAYS_CYCLES
+ * \brief Typical cycle count of incrementDays (RTC_Calendar.asm
+ *        header), not counting the call and the loop.
+ */
+#define TI_INCREMENT_DAYS_CYCLES ((uint32_t)37)
+
+/**
+ * \def MCLK_HZ
+ * \brief The MSP430 MCLK (hal.c, calibrated 1 MHz DCO).
+ */
+#define MCLK_HZ ((uint32_t)1000000)
+
+/**
+ * \typedef benchCase_t
+ * \brief A start date and time and a GMT clock set offset.
+ */
+typedef struct benchCase_s {
+    uint16_t year;
+    uint8_t month;          /**< 1 to 12 */
+    uint8_t day;            /**< 1 to 31 */
+    uint8_t hour24;
+    uint8_t minute;
+    uint8_t second;
+    uint16_t offsetDays;
+    uint8_t offsetHours;
+    uint8_t offsetMinutes;
+    uint8_t offsetSeconds;
+} benchCase_t;
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+/**
+* \var TI_*
+* \brief The TI calendar state (RTC_Calendar.h), BCD encoded.
+*/
+char TI_second;
+char TI_minute;
+char TI_hour;
+char TI_day;
+char TI_dayOfWeek;
+char TI_month;
+int  TI_year;
+char TI_PM;
+char TI_FebDays;
+char TI_dayLightZone;
+char TI_dayLightSavings;
+
+/**
+* \var TI_daysInMonth
+* \brief Days per BCD month index (0x00 - 0x11) as in
+*        RTC_Calendar.asm.
+*/
+static const uint8_t TI_daysInMonth[18] = {
+    0x31, 0x28, 0x31, 0x30, 0x31, 0x30, 0x31, 0x31, 0x30, 0x31,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x30, 0x31
+};
+
+/**
+* \var TI_mNumbers
+* \brief Month numbers of the setDate day of week computation.
+*/
+static const uint8_t TI_mNumbers[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+
+/*********************
+ * Module Prototypes
+ *********************/
+
+static uint8_t bench_bcdInc(uint8_t value);
+static uint8_t bench_toBcd(uint8_t value);
+static void bench_setCase(const benchCase_t *caseP);
+static void bench_refAdvance(const benchCase_t *caseP);
+static bool bench_check(const benchCase_t *caseP);
+static uint8_t bench_daysInMonth(uint16_t year, uint8_t month);
+static double bench_nsPerCall(bool reference, uint32_t runs);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Usage: calendarBench [random cases]
+*
+* @return int 0 if all the results match the reference
+*/
+int main(int argc, char *argv[]) {
+    uint32_t cases = (argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_RANDOM_CASES;
+    uint32_t sweepCases = 0;
+    uint32_t errors = 0;
+    uint32_t i;
+    benchCase_t c;
+    double refNs;
+    double newNs;
+    uint32_t refCycles;
+
+    srand(1);
+    TI_dayLightZone = NO_DAYLIGHT_SAVINGS;
+
+    // Random start dates (up to 2200) and offsets of the full range
+    for (i = 0; i < cases; i++) {
+        c.year = 2015 + (rand() % 186);
+        c.month = 1 + (rand() % 12);
+        c.day = 1 + (rand() % bench_daysInMonth(c.year, c.month));
+        c.hour24 = rand() % 24;
+        c.minute = rand() % 60;
+        c.second = rand() % 60;
+        c.offsetDays = rand() & 0xFFFF;
+        c.offsetHours = rand() & 0xFF;
+        c.offsetMinutes = rand() & 0xFF;
+        c.offsetSeconds = rand() & 0xFF;
+        if (!bench_check(&c)) {
+            errors++;
+        }
+    }
+
+    // Every start day of the sweep years, across month and year ends
+    for (c.year = BENCH_SWEEP_FIRST_YEAR; c.year <= BENCH_SWEEP_LAST_YEAR; c.year++) {
+        for (c.month = 1; c.month <= 12; c.month++) {
+            for (c.day = 1; c.day <= bench_daysInMonth(c.year, c.month); c.day++) {
+                c.hour24 = rand() % 24;
+                c.minute = rand() % 60;
+                c.second = rand() % 60;
+                c.offsetDays = rand() % 800;
+                c.offsetHours = rand() & 0xFF;
+                c.offsetMinutes = rand() & 0xFF;
+                c.offsetSeconds = rand() & 0xFF;
+                if (!bench_check(&c)) {
+                    errors++;
+                }
+                sweepCases++;
+            }
+        }
+    }
+    if (errors) {
+        fprintf(stderr, "%u of %u cases do not match the reference\n", errors, cases + sweepCases);
+        return 1;
+    }
+
+    refNs = bench_nsPerCall(true, BENCH_TIMED_RUNS / 1000);
+    newNs = bench_nsPerCall(false, BENCH_TIMED_RUNS);
+    // The days loop alone, without the call and loop overhead
+    refCycles = 0xFFFF * TI_INCREMENT_DAYS_CYCLES;
+    printf("advanceBinTime matches the increment loops: %u random cases, %u sweep cases (%u-%u)\n",
+           cases, sweepCases, BENCH_SWEEP_FIRST_YEAR, BENCH_SWEEP_LAST_YEAR);
+    printf("worst case (65535 days, 255 h/m/s from Jan 1 2015): loops %.0f ns, advanceBinTime %.0f ns (%.0fx)\n",
+           refNs, newNs, refNs / newNs);
+    printf("MSP430 loops: over %u cycles (%u ms at %u MHz) with the tick interrupt disabled\n",
+           refCycles, refCycles / (MCLK_HZ / 1000), MCLK_HZ / 1000000);
+    return 0;
+}
+
+/**
+* \brief TI calendar routines (RTC_Calendar.asm) ported to C.
+*/
+void incrementSeconds(void) {
+    TI_second = bench_bcdInc(TI_second);
+    if ((uint8_t)TI_second == 0x60) {
+        TI_second = 0;
+        incrementMinutes();
+    }
+}
+
+void incrementMinutes(void) {
+    TI_minute = bench_bcdInc(TI_minute);
+    if ((uint8_t)TI_minute == 0x60) {
+        TI_minute = 0;
+        incrementHours();
+    }
+}
+
+void incrementHours(void) {
+    uint8_t hour = bench_bcdInc(TI_hour);
+    if (hour == 0x12) {
+        if (TI_PM) {
+            TI_PM = 0;
+            TI_hour = hour;
+            incrementDays();
+        } else {
+            TI_PM = 1;
+            TI_hour = hour;
+        }
+    } else if (hour == 0x13) {
+        TI_hour = 0x01;
+    } else {
+        TI_hour = hour;
+    }
+}
+
+void incrementDays(void) {
+    uint8_t days;
+    TI_day = bench_bcdInc(TI_day);
+    TI_dayOfWeek = (TI_dayOfWeek >= 6) ? 0 : (TI_dayOfWeek + 1);
+    days = (TI_month == FEBRUARY) ? (uint8_t)TI_FebDays : TI_daysInMonth[(uint8_t)TI_month];
+    if ((uint8_t)TI_day > days) {
+        TI_day = 0x01;
+        incrementMonths();
+    }
+}
+
+void incrementMonths(void) {
+    TI_month = bench_bcdInc(TI_month);
+    if ((uint8_t)TI_month >= 0x12) {
+        TI_month = 0;
+        incrementYears();
+    }
+}
+
+void incrementYears(void) {
+    uint8_t low = bench_bcdInc(TI_year & 0xFF);
+    uint8_t high = (TI_year >> 8) & 0xFF;
+    if (low == 0xA0) {
+        low = 0;
+        high = bench_bcdInc(high);
+    }
+    TI_year = (high << 8) | low;
+    testLeap();
+}
+
+void testLeap(void) {
+    uint8_t year = TI_year & 0xFF;
+    bool leap = false;
+    // 2x00 years are not leap years (the library stops at 2400)
+    if (year) {
+        if (year & 0x10) {
+            leap = ((year & 0x0F) == 0x02) || ((year & 0x0F) == 0x06);
+        } else {
+            leap = ((year & 0x0F) == 0x00) || ((year & 0x0F) == 0x04) || ((year & 0x0F) == 0x08);
+        }
+    }
+    TI_FebDays = leap ? 0x29 : 0x28;
+}
+
+void setDate(int year, char month, char day) {
+    int y = (month < 3) ? (year - 1) : year;
+    TI_dayLightSavings = 1;
+    TI_dayOfWeek = (y + (y / 4) - (y / 100) + (y / 400) + TI_mNumbers[month - 1] + day) % 7;
+    TI_day = bench_toBcd(day);
+    TI_month = bench_toBcd(month - 1);
+    TI_year = (bench_toBcd(year / 100) << 8) | bench_toBcd(year % 100);
+    testLeap();
+}
+
+char get24Hour(void) {
+    if (!TI_PM) {
+        return ((uint8_t)TI_hour == 0x12) ? 0 : TI_hour;
+    }
+    if ((uint8_t)TI_hour == 0x12) {
+        return TI_hour;
+    }
+    // BCD add of 12
+    return bench_toBcd(bcd_to_char(TI_hour) + 12);
+}
+
+/***************************
+ * Module Private Functions
+ **************************/
+
+/**
+* \brief Add one to a BCD byte (dadd.b #0x01).
+*
+* @param value BCD value
+*
+* @return uint8_t BCD value plus one
+*/
+static uint8_t bench_bcdInc(uint8_t value) {
+    return ((value & 0x0F) == 0x09) ? (value + 7) : (value + 1);
+}
+
+/**
+* \brief Convert a binary value of 0-99 to BCD.
+*
+* @param value binary value
+*
+* @return uint8_t BCD value
+*/
+static uint8_t bench_toBcd(uint8_t value) {
+    return ((value / 10) << 4) | (value % 10);
+}
+
+/**
+* \brief Set the TI calendar to the start of a case, as sysExec
+*        sets it at boot (setTime, setDate).
+*
+* @param caseP the case
+*/
+static void bench_setCase(const benchCase_t *caseP) {
+    uint8_t hour12 = caseP->hour24 % 12;
+    setTime(bench_toBcd(hour12 ? hour12 : 12), bench_toBcd(caseP->minute),
+            bench_toBcd(caseP->second), (caseP->hour24 >= 12));
+    setDate(caseP->year, caseP->month, caseP->day);
+}
+
+/**
+* \brief The original GMT clock set of msgOta.c: increment the TI
+*        calendar one second, minute, hour and day at a time.
+*
+* @param caseP the case
+*/
+static void bench_refAdvance(const benchCase_t *caseP) {
+    uint16_t i;
+    for (i = 0; i < caseP->offsetSeconds; i++) {
+        incrementSeconds();
+    }
+    for (i = 0; i < caseP->offsetMinutes; i++) {
+        incrementMinutes();
+    }
+    for (i = 0; i < caseP->offsetHours; i++) {
+        incrementHours();
+    }
+    for (i = 0; i < caseP->offsetDays; i++) {
+        incrementDays();
+    }
+}
+
+/**
+* \brief Run a case through the reference and advanceBinTime and
+*        compare the TI calendar state.
+*
+* @param caseP the case
+*
+* @return bool true if the states match
+*/
+static bool bench_check(const benchCase_t *caseP) {
+    char ref[8];
+    int refYear;
+    bool match;
+
+    bench_setCase(caseP);
+    bench_refAdvance(caseP);
+    ref[0] = TI_second;
+    ref[1] = TI_minute;
+    ref[2] = TI_hour;
+    ref[3] = TI_PM;
+    ref[4] = TI_day;
+    ref[5] = TI_dayOfWeek;
+    ref[6] = TI_month;
+    ref[7] = TI_FebDays;
+    refYear = TI_year;
+
+    bench_setCase(caseP);
+    advanceBinTime(caseP->offsetDays, caseP->offsetHours, caseP->offsetMinutes, caseP->offsetSeconds);
+    match = (ref[0] == TI_second) && (ref[1] == TI_minute) && (ref[2] == TI_hour) &&
+        (ref[3] == TI_PM) && (ref[4] == TI_day) && (ref[5] == TI_dayOfWeek) &&
+        (ref[6] == TI_month) && (ref[7] == TI_FebDays) && (refYear == TI_year);
+    if (!match) {
+        fprintf(stderr, "mismatch: %04u-%02u-%02u %02u:%02u:%02u + %u d %u h %u m %u s\n",
+                caseP->year, caseP->month, caseP->day, caseP->hour24, caseP->minute, caseP->second,
+                caseP->offsetDays, caseP->offsetHours, caseP->offsetMinutes, caseP->offsetSeconds);
+    }
+    return match;
+}
+
+/**
+* \brief Days in a month (Gregorian).
+*
+* @param year the year
+* @param month 1 to 12
+*
+* @return uint8_t number of days
+*/
+static uint8_t bench_daysInMonth(uint16_t year, uint8_t month) {
+    static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+    return ((month == 2) && leap) ? 29 : days[month - 1];
+}
+
+/**
+* \brief Time the worst case GMT clock set: the largest offset
+*        from the boot date (January 1, 2015).  The calendar is
+*        set before each run; the time to set it is measured
+*        separately and subtracted.
+*
+* @param reference true to time the increment loops
+* @param runs number of runs
+*
+* @return double nanoseconds per call
+*/
+static double bench_nsPerCall(bool reference, uint32_t runs) {
+    static const benchCase_t worst = { 2015, 1, 1, 0, 0, 0, 0xFFFF, 0xFF, 0xFF, 0xFF };
+    struct timespec start;
+    struct timespec end;
+    double ns[2];
+    uint32_t pass;
+    uint32_t i;
+    for (pass = 0; pass < 2; pass++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < runs; i++) {
+            bench_setCase(&worst);
+            if (!pass) {
+                // Set only
+            } else if (reference) {
+                bench_refAdvance(&worst);
+            } else {
+                advanceBinTime(worst.offsetDays, worst.offsetHours, worst.offsetMinutes, worst.offsetSeconds);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns[pass] = ((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec);
+    }
+    return (ns[1] - ns[0]) / runs;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file crcBench.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Check the table driven CRC16 of utils.c against the
+ *        original bit at a time implementation and time both.
+ *        Build once with -DCRC16_BYTE_TABLE=0 (nibble table) and
+ *        once with -DCRC16_BYTE_TABLE=1 (byte table).
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "outpour.h"
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def BENCH_IMAGE_SIZE
+ * \brief Size of the timed buffer (a 10 KB application image as
+ *        checked by the bootloader).
+ */
+#define BENCH_IMAGE_SIZE ((uint16_t)10240)
+
+/**
+ * \def BENCH_RUNS
+ * \brief Number of passes over the timed buffer.
+ */
+#define BENCH_RUNS ((uint32_t)200)
+
+/**
+ * \def BENCH_RANDOM_CASES
+ * \brief Number of random buffers checked against the reference.
+ */
+#define BENCH_RANDOM_CASES ((uint32_t)20000)
+
+/**
+ * \def BENCH_CHECK_VALUE
+ * \brief CRC16 (CRC-16/ARC) of the ASCII string "123456789".
+ */
+#define BENCH_CHECK_VALUE ((uint16_t)0xBB3D)
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+/**
+* \var benchImage
+* \brief Random data for the timed runs.
+*/
+static uint8_t benchImage[BENCH_IMAGE_SIZE];
+
+/*********************
+ * Module Prototypes
+ *********************/
+
+static uint16_t bench_refCrc16(const uint8_t *data, uint16_t size);
+static double bench_nsPerByte(bool reference);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Usage: crcBench
+*
+* @return int 0 if all the CRC results match the reference
+*/
+int main(int argc, char *argv[]) {
+    static const uint8_t checkData[9] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    uint8_t buf[300];
+    uint32_t i;
+    uint16_t j;
+    uint32_t errors = 0;
+    double refNs;
+    double tableNs;
+
+    srand(1);
+    if ((gen_crc16(checkData, sizeof(checkData)) != BENCH_CHECK_VALUE) ||
+        (bench_refCrc16(checkData, sizeof(checkData)) != BENCH_CHECK_VALUE)) {
+        fprintf(stderr, "check value mismatch: table 0x%04X reference 0x%04X\n",
+                gen_crc16(checkData, sizeof(checkData)), bench_refCrc16(checkData, sizeof(checkData)));
+        return 1;
+    }
+
+    // Whole buffer, two buffers and byte by byte must all match
+    for (i = 0; i < BENCH_RANDOM_CASES; i++) {
+        uint16_t size = rand() % sizeof(buf);
+        uint16_t split = size ? (rand() % (size + 1)) : 0;
+        uint16_t ref;
+        unsigned int crc = CRC16_INIT_VALUE;
+        for (j = 0; j < size; j++) {
+            buf[j] = rand();
+        }
+        ref = bench_refCrc16(buf, size);
+        for (j = 0; j < size; j++) {
+            crc = gen_crc16_byte(crc, buf[j]);
+        }
+        if ((gen_crc16(buf, size) != ref) ||
+            (gen_crc16_2buf(buf, split, &buf[split], size - split) != ref) ||
+            (CRC16_FINAL(crc) != ref)) {
+            errors++;
+        }
+    }
+    if (errors) {
+        fprintf(stderr, "%u of %u random buffers do not match the reference\n", errors, BENCH_RANDOM_CASES);
+        return 1;
+    }
+
+    for (j = 0; j < BENCH_IMAGE_SIZE; j++) {
+        benchImage[j] = rand();
+    }
+    refNs = bench_nsPerByte(true);
+    tableNs = bench_nsPerByte(false);
+    printf("CRC16 %s table: check value 0x%04X, %u random buffers match the reference\n",
+           CRC16_BYTE_TABLE ? "byte (512 B)" : "nibble (32 B)", BENCH_CHECK_VALUE, BENCH_RANDOM_CASES);
+    printf("bit at a time %.2f ns/byte, table %.2f ns/byte (%.1fx)\n", refNs, tableNs, refNs / tableNs);
+    return 0;
+}
+
+/**
+* \brief Stubs used by utils.c
+*/
+uint8_t bcd_to_char(uint8_t bcdValue) {
+    return ((bcdValue >> 4) * 10) + (bcdValue & 0xF);
+}
+
+/***************************
+ * Module Private Functions
+ **************************/
+
+/**
+* \brief The original bit at a time CRC16 of utils.c, with 16 bit
+*        variables as on the MSP430.
+*
+* @param data the data
+* @param size the size of the data in bytes
+*
+* @return uint16_t the CRC
+*/
+static uint16_t bench_refCrc16(const uint8_t *data, uint16_t size) {
+    volatile uint16_t out = 0;
+    volatile int bits_read = 0;
+    volatile int bit_flag;
+    uint16_t i;
+    uint16_t j;
+    uint16_t crc = 0;
+
+    while (size > 0) {
+        bit_flag = out >> 15;
+        out <<= 1;
+        out |= (*data >> bits_read) & 1;
+        bits_read++;
+        if (bits_read > 7) {
+            bits_read = 0;
+            data++;
+            size--;
+        }
+        if (bit_flag) out ^= 0x8005;
+    }
+    for (i = 0; i < 16; ++i) {
+        bit_flag = out >> 15;
+        out <<= 1;
+        if (bit_flag) out ^= 0x8005;
+    }
+    for (i = 0x8000, j = 0x0001; i != 0; i >>= 1, j <<= 1) {
+        if (i & out) crc |= j;
+    }
+    return crc;
+}
+
+/**
+* \brief Time the CRC of the benchmark image.
+*
+* @param reference true to time the bit at a time reference
+*
+* @return double nanoseconds per byte
+*/
+static double bench_nsPerByte(bool reference) {
+    struct timespec start;
+    struct timespec end;
+    volatile uint16_t sink = 0;
+    uint32_t i;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < BENCH_RUNS; i++) {
+        sink ^= reference ? bench_refCrc16(benchImage, BENCH_IMAGE_SIZE) : gen_crc16(benchImage, BENCH_IMAGE_SIZE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / ((double)BENCH_RUNS * BENCH_IMAGE_SIZE);
+}
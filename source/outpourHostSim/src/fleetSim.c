@@ -0,0 +1,592 @@
+/**
+ * @file fleetSim.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Run the transmit scheduling of a fleet: the data
+ *        message manager (msgData.c) and the modem manager
+ *        (modemMgr.c) of each unit start the daily log session of
+ *        the same storage day start, as all the units of a region
+ *        do.  The session start and the time the data reaches the
+ *        backend (the link time later) are collected over the
+ *        fleet to show the ingest rate profile, with the sessions
+ *        started at the storage time and spread by the transmit
+ *        offset of each unit.
+ *
+ * Each unit first runs a full batch job like the final assembly
+ * session: the stubbed modemCmd answers M_COMMAND_MODEM_INFO with
+ * the IMEI of the unit, which sets the transmit offset
+ * (modemMgr_getTransmitOffset).  The IMEIs are one consecutive
+ * production batch (or random with -i).  With -n the batch job is
+ * skipped, as for a unit whose first session after a reset is the
+ * scheduled one: the offset follows from the factory calibration
+ * in INFO A, which the simulation fills per unit (sim_fillCalibration).
+ * The modem session itself is stubbed (dataMsgSm): it succeeds at
+ * once.  Build with -DMODEM_TRANSMIT_SPREAD=1.
+ */
+
+#include <stdlib.h>
+#include "outpour.h"
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def SIM_MAX_SECONDS
+ * \brief Longest time from the storage day start that is
+ *        simulated (the 254 minute spread window and the link
+ *        time).
+ */
+#define SIM_MAX_SECONDS ((uint32_t)(5 * 60 * 60))
+
+/**
+ * \def SIM_IMEI_TAC
+ * \brief Type allocation code of the simulated modems (first 8
+ *        IMEI digits).
+ */
+#define SIM_IMEI_TAC ((uint64_t)35290611)
+
+/**
+ * \def SIM_LINK_MIN_SECONDS
+ * \brief Shortest time from the session start to the data at
+ *        the backend (modem power up, registration, transfer).
+ */
+#define SIM_LINK_MIN_SECONDS ((uint32_t)25)
+
+/**
+ * \def SIM_LINK_MAX_SECONDS
+ * \brief Longest time from the session start to the data at the
+ *        backend.
+ */
+#define SIM_LINK_MAX_SECONDS ((uint32_t)120)
+
+/**
+ * \def SIM_SPREAD_OFF
+ * \brief Transmit spread configuration that starts the sessions
+ *        at the storage time (see msgData.c).
+ */
+#define SIM_SPREAD_OFF ((uint8_t)0xFF)
+
+/**
+ * \def SIM_CAL_ADDR
+ * \brief INFO A, the factory calibration TLV of the MSP430G2553.
+ */
+#define SIM_CAL_ADDR ((uint16_t)0x10C0)
+
+/**
+ * \typedef simProfile_t
+ * \brief The sessions of the fleet per second from the storage
+ *        day start.
+ */
+typedef struct simProfile_s {
+    const char *nameP;                 /**< name to print */
+    uint8_t spreadConfig;              /**< storageMgr_getModemConfig stub */
+    uint32_t starts[SIM_MAX_SECONDS];  /**< sessions started per second */
+    uint32_t ingest[SIM_MAX_SECONDS];  /**< data at the backend per second */
+    uint32_t late;                     /**< sessions not started in SIM_MAX_SECONDS */
+} simProfile_t;
+
+/**
+ * \typedef simData_t
+ * \brief Module data structure.
+ */
+typedef struct simData_s {
+    uint32_t seconds;           /**< getSecondsSinceBoot stub */
+    uint32_t rng;               /**< random state */
+    uint8_t spreadConfig;       /**< storageMgr_getModemConfig stub */
+    bool sessionStarted;        /**< the unit started its session */
+    uint32_t startSecond;       /**< second the session started */
+    uint64_t imei;              /**< IMEI of the current unit */
+    bool infoRead;              /**< M_COMMAND_MODEM_INFO was sent */
+    bool noInfo;                /**< skip the batch job that reads the IMEI */
+    const modemCmdWriteData_t *cmdQueue[8]; /**< commands written by modemMgr */
+    uint8_t cmdCount;           /**< commands in cmdQueue */
+    uint8_t response[16];       /**< modemCmd_read data */
+    const modemCmdWriteData_t *currentCmdP; /**< command being answered */
+    void (*responseFuncP)(void);/**< modemCmd response function */
+    uint16_t sessionMask;       /**< storageMgr backlog stub */
+    timePacket_t binTime;       /**< getBinTime stub */
+} simData_t;
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+/**
+* \var sData
+* \brief Simulation data.
+*/
+static simData_t sData;
+
+/**
+* \var profiles
+* \brief The ingest profiles: sessions at the storage time, and
+*        spread by the transmit offset.
+*/
+static simProfile_t profiles[2];
+
+/*************************
+ * Module Prototypes
+ ************************/
+
+static void sim_runUnit(simProfile_t *profP, uint64_t imei);
+static void sim_readModemInfo(void);
+static uint64_t sim_imei(uint32_t serial);
+static void sim_fillCalibration(void);
+static void sim_printProfiles(uint32_t units, uint32_t binSecs);
+static float sim_rand(void);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Usage: fleetSim [-u units] [-t spread] [-b binSecs]
+*        [-s seed] [-i] [-n]
+*        -t is the transmit spread configuration (as the OTA
+*        message: minutes, 0 for the firmware default), -b the
+*        width of the printed profile bins and -i draws random
+*        IMEIs instead of a consecutive batch.  -n does not read
+*        the IMEI (the offset follows from INFO A).
+*
+* @return int 0 if the simulation ran
+*/
+int main(int argc, char *argv[]) {
+    uint32_t units = 10000;
+    uint32_t binSecs = 5 * 60;
+    uint8_t spreadConfig = 0;
+    bool randomImei = false;
+    uint32_t firstSerial;
+    uint32_t u;
+    int i;
+
+    sData.rng = 1;
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i")) {
+            randomImei = true;
+        } else if (!strcmp(argv[i], "-n")) {
+            sData.noInfo = true;
+        } else if ((argv[i][0] == '-') && ((i + 1) < argc)) {
+            switch (argv[i][1]) {
+            case 'u': units = strtoul(argv[++i], NULL, 0); break;
+            case 't': spreadConfig = strtoul(argv[++i], NULL, 0); break;
+            case 'b': binSecs = strtoul(argv[++i], NULL, 0); break;
+            case 's': sData.rng = strtoul(argv[++i], NULL, 0) | 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-u units] [-t spread] [-b binSecs] [-s seed] [-i] [-n]\n", argv[0]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [-u units] [-t spread] [-b binSecs] [-s seed] [-i] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!binSecs) {
+        binSecs = 1;
+    }
+    // modemMgr_init reads INFO A
+    hostFlash_open(NULL, true);
+
+    profiles[0].nameP = "storage time";
+    profiles[0].spreadConfig = SIM_SPREAD_OFF;
+    profiles[1].nameP = "spread";
+    profiles[1].spreadConfig = spreadConfig;
+
+    firstSerial = (uint32_t)(sim_rand() * 500000);
+    for (u = 0; u < units; u++) {
+        uint32_t serial = randomImei ? (uint32_t)(sim_rand() * 1000000) : (firstSerial + u);
+        uint64_t imei = sim_imei(serial % 1000000);
+        sim_fillCalibration();
+        sim_runUnit(&profiles[0], imei);
+        sim_runUnit(&profiles[1], imei);
+    }
+    sim_printProfiles(units, binSecs);
+    return 0;
+}
+
+/**
+* \brief Run one unit: reset, read the modem info in the first
+*        session (unless -n), then start the daily log session of a storage
+*        day start (second 0) and run the data message manager
+*        until the session starts.
+*
+* @param profP the profile to add the session to
+* @param imei IMEI of the unit
+*/
+static void sim_runUnit(simProfile_t *profP, uint64_t imei) {
+    uint32_t link;
+
+    sData.imei = imei;
+    sData.spreadConfig = profP->spreadConfig;
+    sData.seconds = 0;
+    sData.sessionStarted = false;
+    dataMsgMgr_init();
+    modemMgr_init();
+    if (!sData.noInfo) {
+        sim_readModemInfo();
+    }
+
+    dataMsgMgr_sendDailyLogs();
+    while (!sData.sessionStarted && (sData.seconds < SIM_MAX_SECONDS)) {
+        sData.seconds++;
+        dataMsgMgr_exec();
+    }
+    if (!sData.sessionStarted) {
+        profP->late++;
+        return;
+    }
+    profP->starts[sData.startSecond]++;
+    link = SIM_LINK_MIN_SECONDS + (uint32_t)(sim_rand() * (SIM_LINK_MAX_SECONDS - SIM_LINK_MIN_SECONDS));
+    if ((sData.startSecond + link) < SIM_MAX_SECONDS) {
+        profP->ingest[sData.startSecond + link]++;
+    } else {
+        profP->late++;
+    }
+}
+
+/**
+* \brief Run a full batch job like the final assembly session
+*        after a reset, answering the commands modemMgr queues.
+*/
+static void sim_readModemInfo(void) {
+    static modemCmdWriteData_t cmdWrite;
+    uint8_t i;
+
+    memset(&cmdWrite, 0, sizeof(cmdWrite));
+    cmdWrite.cmd = M_COMMAND_SEND_DATA;
+    cmdWrite.payloadMsgId = MSG_TYPE_FA;
+    cmdWrite.batchProfile = MODEM_BATCH_FULL;
+    sData.cmdCount = 0;
+    sData.infoRead = false;
+    modemMgr_grab();
+    modemMgr_sendModemCmdBatch(&cmdWrite);
+    for (i = 0; i < sData.cmdCount; i++) {
+        sData.currentCmdP = sData.cmdQueue[i];
+        if (sData.responseFuncP) {
+            sData.responseFuncP();
+        }
+    }
+    modemMgr_release();
+    if (!sData.infoRead) {
+        fprintf(stderr, "the batch job did not read the modem info\n");
+        exit(1);
+    }
+}
+
+/**
+* \brief Build an IMEI of the simulated type allocation code:
+*        TAC, serial number and the Luhn check digit.
+*
+* @param serial the six digit serial number
+*
+* @return uint64_t the IMEI
+*/
+static uint64_t sim_imei(uint32_t serial) {
+    uint64_t body = (SIM_IMEI_TAC * 1000000) + serial;
+    uint64_t digits = body;
+    uint32_t sum = 0;
+    uint8_t pos = 0;
+
+    // Luhn: double every second digit from the right of the body
+    for (pos = 0; pos < 14; pos++) {
+        uint32_t d = digits % 10;
+        digits /= 10;
+        if ((pos & 1) == 0) {
+            d *= 2;
+            if (d > 9) {
+                d -= 9;
+            }
+        }
+        sum += d;
+    }
+    return (body * 10) + ((10 - (sum % 10)) % 10);
+}
+
+/**
+* \brief Fill INFO A with the calibration TLV of a unit: the 
+*        ADC10 words (tag 0x10) and the DCO constants (tag 0x01)
+*        at the G2553 addresses, each some counts off a typical
+*        value, and the checksum.  The spread of the constants
+*        over a production lot is assumed, not measured.
+*/
+static void sim_fillCalibration(void) {
+    static const uint16_t adcTypical[8] = {
+        0x8000, 0x0000, 0x8000, 0x02E0, 0x0350, 0x8000, 0x01C0, 0x0200
+    };
+    static const uint8_t bcsTypical[4] = { 0x8F, 0x8E, 0x8D, 0x86 };
+    uint8_t *calP = hostFlash_addrToPtr(SIM_CAL_ADDR);
+    uint16_t check = 0;
+    uint8_t i;
+
+    memset(calP, 0xFF, 64);
+    calP[0x1A] = 0x10;          // TAG_ADC10_1
+    calP[0x1B] = 0x10;
+    for (i = 0; i < 8; i++) {
+        // gain and reference factors +-512, offset and temperature +-16
+        int32_t span = (adcTypical[i] & 0x8000) ? 512 : 16;
+        uint16_t value = adcTypical[i] + (int32_t)(sim_rand() * (2 * span + 1)) - span;
+        calP[0x1C + (2 * i)] = (uint8_t)value;
+        calP[0x1D + (2 * i)] = (uint8_t)(value >> 8);
+    }
+    calP[0x36] = 0x01;          // TAG_DCO_30
+    calP[0x37] = 0x08;
+    for (i = 0; i < 4; i++) {
+        // DCO and modulation anywhere, the range select +-1
+        calP[0x38 + (2 * i)] = (uint8_t)(sim_rand() * 256);
+        calP[0x39 + (2 * i)] = bcsTypical[i] + (int8_t)(sim_rand() * 3) - 1;
+    }
+    for (i = 2; i < 64; i += 2) {
+        check ^= calP[i] | ((uint16_t)calP[i + 1] << 8);
+    }
+    check = (uint16_t)-check;
+    calP[0] = (uint8_t)check;
+    calP[1] = (uint8_t)(check >> 8);
+}
+
+/**
+* \brief Print the profiles: the session starts and the ingest
+*        per bin from the storage day start, the peak ingest per
+*        minute and per second.
+*
+* @param units units in the fleet
+* @param binSecs width of a printed bin
+*/
+static void sim_printProfiles(uint32_t units, uint32_t binSecs) {
+    uint32_t bins = (SIM_MAX_SECONDS + binSecs - 1) / binSecs;
+    uint32_t lastBin = 0;
+    uint32_t b;
+    uint32_t s;
+    uint8_t p;
+
+    printf("%u units, spread %s (config %u)\n", units,
+           profiles[1].spreadConfig ? "configured" : "default", profiles[1].spreadConfig);
+    for (p = 0; p < 2; p++) {
+        simProfile_t *profP = &profiles[p];
+        uint32_t peakSec = 0;
+        uint32_t peakMin = 0;
+        uint32_t minute = 0;
+        uint32_t first = SIM_MAX_SECONDS;
+        uint32_t last = 0;
+        for (s = 0; s < SIM_MAX_SECONDS; s++) {
+            if (profP->ingest[s] > peakSec) {
+                peakSec = profP->ingest[s];
+            }
+            minute += profP->ingest[s];
+            if (s >= 60) {
+                minute -= profP->ingest[s - 60];
+            }
+            if (minute > peakMin) {
+                peakMin = minute;
+            }
+            if (profP->ingest[s] || profP->starts[s]) {
+                if (s < first) {
+                    first = s;
+                }
+                last = s;
+            }
+        }
+        if (last / binSecs > lastBin) {
+            lastBin = last / binSecs;
+        }
+        printf("%-13s ingest peak %5u/s %6u/min (%.1f%% of the fleet in a minute), "
+               "sessions from %u s to %u s, late %u\n",
+               profP->nameP, peakSec, peakMin, (100.0 * peakMin) / (units ? units : 1),
+               (first < SIM_MAX_SECONDS) ? first : 0, last, profP->late);
+    }
+    printf("\n%-12s %14s %14s\n", "from start", profiles[0].nameP, profiles[1].nameP);
+    printf("%-12s %7s %6s %7s %6s\n", "", "starts", "ingest", "starts", "ingest");
+    for (b = 0; (b <= lastBin) && (b < bins); b++) {
+        uint32_t sum[2][2] = { { 0, 0 }, { 0, 0 } };
+        for (s = b * binSecs; (s < ((b + 1) * binSecs)) && (s < SIM_MAX_SECONDS); s++) {
+            for (p = 0; p < 2; p++) {
+                sum[p][0] += profiles[p].starts[s];
+                sum[p][1] += profiles[p].ingest[s];
+            }
+        }
+        printf("%6u s     %7u %6u %7u %6u\n", b * binSecs, sum[0][0], sum[0][1], sum[1][0], sum[1][1]);
+    }
+}
+
+/**
+* \brief xorshift32 random number in [0,1).
+*
+* @return float the random number
+*/
+static float sim_rand(void) {
+    sData.rng ^= sData.rng << 13;
+    sData.rng ^= sData.rng >> 17;
+    sData.rng ^= sData.rng << 5;
+    return (sData.rng >> 8) / 16777216.0;
+}
+
+/**
+* \brief Data message state machine stubs.  A session succeeds
+*        at once; its start is recorded.
+*/
+void dataMsgSm_initForNewSession(dataMsgSm_t *dataMsgP) {
+    memset(dataMsgP, 0, sizeof(dataMsgSm_t));
+    if (!sData.sessionStarted) {
+        sData.sessionStarted = true;
+        sData.startSecond = sData.seconds;
+    }
+}
+
+void dataMsgSm_sendAnotherDataMsg(dataMsgSm_t *dataMsgP) {
+}
+
+void dataMsgSm_stateMachine(dataMsgSm_t *dataMsgP) {
+    dataMsgP->allDone = true;
+}
+
+/**
+* \brief modemCmd stubs.  The commands written by modemMgr are
+*        answered by sim_readModemInfo; the modem info response
+*        carries the IMEI of the unit (MSB first).
+*/
+void modemCmd_setResponseFunc(void (*responseFuncP)(void)) {
+    sData.responseFuncP = responseFuncP;
+}
+
+bool modemCmd_write(const modemCmdWriteData_t *writeCmdP) {
+    if (sData.cmdCount < (sizeof(sData.cmdQueue) / sizeof(sData.cmdQueue[0]))) {
+        sData.cmdQueue[sData.cmdCount++] = writeCmdP;
+    }
+    return true;
+}
+
+void modemCmd_read(modemCmdReadData_t *readDataP) {
+    uint8_t i;
+    memset(sData.response, 0, sizeof(sData.response));
+    readDataP->modemCmdId = sData.currentCmdP->cmd;
+    readDataP->valid = true;
+    readDataP->dataP = sData.response;
+    readDataP->lengthInBytes = 5;
+    sData.response[1] = sData.currentCmdP->cmd;
+    if (sData.currentCmdP->cmd == M_COMMAND_MODEM_INFO) {
+        // start, cmd, major, minor, imei[8]
+        sData.response[2] = 1;
+        for (i = 0; i < 8; i++) {
+            sData.response[4 + i] = (uint8_t)(sData.imei >> (56 - (8 * i)));
+        }
+        readDataP->lengthInBytes = 15;
+        sData.infoRead = true;
+    }
+}
+
+void modemCmd_flushQueue(void) {
+}
+
+/**
+* \brief modemLink stubs.
+*/
+void modemLink_restart(void) {
+}
+
+void modemLink_shutdownModem(void) {
+}
+
+void modemLink_resetUpTime(void) {
+}
+
+bool modemLink_isModemUp(void) {
+    return false;
+}
+
+bool modemLink_isModemUpError(void) {
+    return false;
+}
+
+uint16_t modemLink_getModemUpTimeInSecs(void) {
+    return 0;
+}
+
+/**
+* \brief Storage manager stubs.  The backlog is one multi-day
+*        message.
+*/
+void storageMgr_getModemConfig(modemConfig_t *configP) {
+    memset(configP, 0, sizeof(modemConfig_t));
+    configP->transmitSpreadMinutes = sData.spreadConfig;
+}
+
+void storageMgr_setModemConfig(modemConfig_t *configP) {
+}
+
+#if (DATA_MSG_MULTI_DAY==1)
+uint16_t storageMgr_getNextMultiDayToTransmit(uint16_t *sessionMaskP, uint8_t maxDays, uint8_t *numDaysP) {
+    if (*sessionMaskP) {
+        return 0;
+    }
+    *sessionMaskP = 1;
+    *numDaysP = 1;
+    return 14 + 91;
+}
+
+uint16_t storageMgr_getMultiDaySegment(uint8_t segment, uint8_t **dataPP) {
+    return 0;
+}
+#else
+uint16_t storageMgr_getNextDailyLogToTransmit(uint8_t **dataPP, uint16_t *sessionMaskP) {
+    static uint8_t dailyLog[126];
+    if (*sessionMaskP) {
+        return 0;
+    }
+    *sessionMaskP = 1;
+    *dataPP = dailyLog;
+    return sizeof(dailyLog);
+}
+#endif
+
+#if (MINUTE_FLOW_CAPTURE==1)
+uint16_t storageMgr_getNextMinuteCaptureToTransmit(uint8_t **dataPP, uint8_t *sessionMaskP) {
+    return 0;
+}
+#endif
+
+uint16_t storageMgr_getNextEventLogToTransmit(uint8_t **dataPP, uint8_t *countP) {
+    return 0;
+}
+
+void storageMgr_markDailyLogsAsTransmitted(uint16_t sessionMask) {
+}
+
+#if (MINUTE_FLOW_CAPTURE==1)
+void storageMgr_markMinuteCapturesAsTransmitted(uint8_t sessionMask) {
+}
+#endif
+
+void storageMgr_markEventLogAsTransmitted(uint8_t count) {
+}
+
+void storageMgr_logEvent(debugEvents_t event, uint8_t payload) {
+}
+
+uint8_t storageMgr_prepareMsgHeader(uint8_t *dataPtr) {
+    memset(dataPtr, 0, 14);
+    return 14;
+}
+
+/**
+* \brief Time stubs.
+*/
+uint8_t bcd_to_char(uint8_t bcdValue) {
+    return ((bcdValue >> 4) * 10) + (bcdValue & 0xF);
+}
+
+uint32_t getSecondsSinceBoot(void) {
+    return sData.seconds;
+}
+
+#if (FINE_TICK_TIME==1)
+fine_tick_t getFineTicksSinceBoot(void) {
+    return (fine_tick_t)(sData.seconds << FINE_TICK_SHIFT);
+}
+#endif
+
+timePacket_t* getBinTime(void) {
+    sData.binTime.hour24 = (sData.seconds / 3600) % 24;
+    sData.binTime.minute = (sData.seconds / 60) % 60;
+    sData.binTime.second = sData.seconds % 60;
+    return &sData.binTime;
+}
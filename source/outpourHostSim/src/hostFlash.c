@@ -0,0 +1,502 @@
+/**
+ * @file hostFlash.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Host implementation of the msp430Flash API (flash.c)
+ *        backed by an mmap'd 64KB image file.  Models NOR flash
+ *        semantics: an erase sets a segment to 0xFF and a write
+ *        can only clear bits.  Erases, writes and modeled
+ *        programming time are accounted per segment and any
+ *        attempt to program a bit from 0 to 1 is flagged.
+ *
+ * Firmware flash objects (for example the week logs in
+ * storage.c) are ordinary host variables.  They are registered
+ * with hostFlash_mapRegion so that writes through host pointers
+ * are translated to the MSP430 address and the image contents
+ * are mirrored back into the host object.  Pointers with a
+ * value below 0x10000 (addresses cast from integers, as done by
+ * the bootloader) are used directly as MSP430 addresses.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "outpour.h"
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def HOST_FLASH_MAX_REGIONS
+ * \brief Max number of host objects that can be mapped onto the
+ *        image.
+ */
+#define HOST_FLASH_MAX_REGIONS ((uint8_t)8)
+
+/**
+ * \def HOST_FLASH_TFTG_US
+ * \brief Flash timing generator period.  The firmware selects
+ *        MCLK (1MHz) divided by 3 (FSSEL_1 | FN1).
+ */
+#define HOST_FLASH_TFTG_US (3.0)
+
+/**
+ * \def HOST_FLASH_PROGRAM_TFTG
+ * \brief Byte or word program time in tFTG cycles.
+ */
+#define HOST_FLASH_PROGRAM_TFTG (30.0)
+
+/**
+ * \def HOST_FLASH_ERASE_TFTG
+ * \brief Segment erase time in tFTG cycles.
+ */
+#define HOST_FLASH_ERASE_TFTG (4819.0)
+
+/**
+ * \def HOST_FLASH_OP_OVERHEAD_US
+ * \brief Driver loop overhead per byte/word operation.  The lab
+ *        measured ~151us per byte with the original byte loop
+ *        against the 90us program time.
+ */
+#define HOST_FLASH_OP_OVERHEAD_US (61.0)
+
+/**
+ * \def HOST_FLASH_MAX_ILLEGAL_REPORTS
+ * \brief Limit the number of illegal write messages printed.
+ */
+#define HOST_FLASH_MAX_ILLEGAL_REPORTS ((uint16_t)10)
+
+/**
+ * \typedef hostFlashRegion_t
+ * \brief A host object that shadows a range of flash.
+ */
+typedef struct hostFlashRegion_s {
+    uint8_t *hostP;         /**< host address of the object */
+    uint16_t flashAddr;     /**< MSP430 address of the object */
+    uint16_t length;        /**< length in bytes */
+} hostFlashRegion_t;
+
+/**
+ * \typedef hostFlashData_t
+ * \brief Module data structure.
+ */
+typedef struct hostFlashData_s {
+    int fd;                                         /**< image file */
+    uint8_t *imageP;                                /**< mmap'd image */
+    bool byteMode;                                  /**< model the byte-by-byte driver */
+    bool strict;                                    /**< abort on an illegal write */
+    uint16_t illegalReports;                        /**< illegal writes printed */
+    uint8_t numRegions;                             /**< mapped host objects */
+    hostFlashRegion_t regions[HOST_FLASH_MAX_REGIONS];
+    hostFlashSegStats_t segStats[HOST_FLASH_NUM_SEGMENTS];
+} hostFlashData_t;
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+// static
+hostFlashData_t hfData;
+
+/*********************
+ * Module Prototypes
+ *********************/
+
+static uint16_t hostFlash_ptrToAddr(const void *p);
+static uint16_t hostFlash_segIndex(uint16_t flashAddr);
+static void hostFlash_mirror(uint16_t flashAddr, uint16_t length);
+static double hostFlash_driverTimeUs(uint16_t flashAddr, uint16_t num_bytes, uint32_t *opsP);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Open (or create) the flash image file and map it.  A
+*        new image starts out erased (all 0xFF).
+* \ingroup PUBLIC_API
+*
+* @param imagePathP path of the image file.  If NULL, an
+*                   anonymous mapping is used.
+* @param erase If true, set the complete image to 0xFF.
+*
+* @return bool true if the image was mapped.
+*/
+bool hostFlash_open(const char *imagePathP, bool erase) {
+    struct stat st;
+    int flags = MAP_SHARED;
+
+    memset(&hfData, 0, sizeof(hostFlashData_t));
+    hfData.fd = -1;
+
+    if (imagePathP) {
+        hfData.fd = open(imagePathP, O_RDWR | O_CREAT, 0644);
+        if (hfData.fd < 0) {
+            return false;
+        }
+        if (fstat(hfData.fd, &st) || (st.st_size != HOST_FLASH_IMAGE_SIZE)) {
+            erase = true;
+            if (ftruncate(hfData.fd, HOST_FLASH_IMAGE_SIZE)) {
+                close(hfData.fd);
+                return false;
+            }
+        }
+    } else {
+        flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        erase = true;
+    }
+
+    hfData.imageP = mmap(NULL, HOST_FLASH_IMAGE_SIZE, PROT_READ | PROT_WRITE, flags, hfData.fd, 0);
+    if (hfData.imageP == MAP_FAILED) {
+        hfData.imageP = NULL;
+        if (hfData.fd >= 0) {
+            close(hfData.fd);
+        }
+        return false;
+    }
+    if (erase) {
+        memset(hfData.imageP, 0xFF, HOST_FLASH_IMAGE_SIZE);
+    }
+    return true;
+}
+
+/**
+* \brief Flush the image to the file and unmap it.  The file can
+*        be inspected after the run (e.g. with xxd).
+* \ingroup PUBLIC_API
+*/
+void hostFlash_close(void) {
+    if (hfData.imageP) {
+        msync(hfData.imageP, HOST_FLASH_IMAGE_SIZE, MS_SYNC);
+        munmap(hfData.imageP, HOST_FLASH_IMAGE_SIZE);
+        hfData.imageP = NULL;
+    }
+    if (hfData.fd >= 0) {
+        close(hfData.fd);
+        hfData.fd = -1;
+    }
+}
+
+/**
+* \brief Register a host object that represents a range of
+*        flash.  The current image contents are copied into the
+*        object.
+* \ingroup PUBLIC_API
+*
+* @param hostP host address of the object
+* @param flashAddr MSP430 address the object is linked at
+* @param length length of the object in bytes
+*/
+void hostFlash_mapRegion(void *hostP, uint16_t flashAddr, uint16_t length) {
+    hostFlashRegion_t *regionP;
+    if (hfData.numRegions >= HOST_FLASH_MAX_REGIONS) {
+        fprintf(stderr, "hostFlash: too many regions\n");
+        exit(1);
+    }
+    regionP = &hfData.regions[hfData.numRegions++];
+    regionP->hostP = (uint8_t *)hostP;
+    regionP->flashAddr = flashAddr;
+    regionP->length = length;
+    memcpy(hostP, &hfData.imageP[flashAddr], length);
+}
+
+/**
+* \brief Get a pointer to read the image at a MSP430 address.
+* \ingroup PUBLIC_API
+*
+* @param flashAddr MSP430 address
+*
+* @return uint8_t* host pointer into the image
+*/
+uint8_t *hostFlash_addrToPtr(uint16_t flashAddr) {
+    return &hfData.imageP[flashAddr];
+}
+
+/**
+* \brief Select whether the programming time is modeled with the
+*        byte-by-byte driver (the bootloader flash.c) instead of
+*        the word mode driver of the application flash.c.
+* \ingroup PUBLIC_API
+*
+* @param enable true to model byte writes
+*/
+void hostFlash_setByteMode(bool enable) {
+    hfData.byteMode = enable;
+}
+
+/**
+* \brief Select whether an illegal 0->1 write aborts the run.
+* \ingroup PUBLIC_API
+*
+* @param strict true to abort
+*/
+void hostFlash_setStrict(bool strict) {
+    hfData.strict = strict;
+}
+
+/**
+* \brief Clear all the per segment accounting.
+* \ingroup PUBLIC_API
+*/
+void hostFlash_resetStats(void) {
+    memset(hfData.segStats, 0, sizeof(hfData.segStats));
+    hfData.illegalReports = 0;
+}
+
+/**
+* \brief Get the accounting for one segment.
+* \ingroup PUBLIC_API
+*
+* @param segIndex 0-127 for the main segments, 128-131 for INFO
+*                 D, C, B, A.
+*
+* @return hostFlashSegStats_t* segment accounting
+*/
+hostFlashSegStats_t *hostFlash_getSegStats(uint16_t segIndex) {
+    return &hfData.segStats[segIndex];
+}
+
+/**
+* \brief Get the MSP430 start address of a segment.
+* \ingroup PUBLIC_API
+*
+* @param segIndex segment index
+*
+* @return uint16_t MSP430 start address
+*/
+uint16_t hostFlash_getSegAddr(uint16_t segIndex) {
+    if (segIndex >= 128) {
+        return 0x1000 + ((segIndex - 128) * HOST_FLASH_INFO_SEGMENT_SIZE);
+    }
+    return segIndex * HOST_FLASH_MAIN_SEGMENT_SIZE;
+}
+
+/**
+* \brief Sum the accounting over all segments.
+* \ingroup PUBLIC_API
+*
+* @param totalsP where to store the totals
+*/
+void hostFlash_getTotals(hostFlashSegStats_t *totalsP) {
+    uint16_t i;
+    memset(totalsP, 0, sizeof(hostFlashSegStats_t));
+    for (i = 0; i < HOST_FLASH_NUM_SEGMENTS; i++) {
+        hostFlashSegStats_t *sP = &hfData.segStats[i];
+        totalsP->erases += sP->erases;
+        totalsP->writeCalls += sP->writeCalls;
+        totalsP->bytesWritten += sP->bytesWritten;
+        totalsP->programOps += sP->programOps;
+        totalsP->illegalWrites += sP->illegalWrites;
+        totalsP->progTimeUs += sP->progTimeUs;
+        totalsP->byteModeTimeUs += sP->byteModeTimeUs;
+    }
+}
+
+/**
+* \brief Print the accounting for every segment that was used.
+* \ingroup PUBLIC_API
+*
+* @param fP output stream
+*/
+void hostFlash_printStats(FILE *fP) {
+    uint16_t i;
+    hostFlashSegStats_t totals;
+    fprintf(fP, "segment  erases     writes      bytes       ops  illegal   prog_ms  bytemode_ms\n");
+    for (i = 0; i < HOST_FLASH_NUM_SEGMENTS; i++) {
+        hostFlashSegStats_t *sP = &hfData.segStats[i];
+        if (sP->erases || sP->writeCalls) {
+            fprintf(fP, "0x%04X %8u %10u %10u %9u %8u %9.1f %12.1f\n",
+                    hostFlash_getSegAddr(i), sP->erases, sP->writeCalls,
+                    sP->bytesWritten, sP->programOps, sP->illegalWrites,
+                    sP->progTimeUs / 1000.0, sP->byteModeTimeUs / 1000.0);
+        }
+    }
+    hostFlash_getTotals(&totals);
+    fprintf(fP, "total  %8u %10u %10u %9u %8u %9.1f %12.1f\n",
+            totals.erases, totals.writeCalls, totals.bytesWritten,
+            totals.programOps, totals.illegalWrites,
+            totals.progTimeUs / 1000.0, totals.byteModeTimeUs / 1000.0);
+}
+
+/**
+* \brief Erase one segment of flash.  Sets the segment to 0xFF.
+* \ingroup PUBLIC_API
+*
+* @param flashSegmentAddrP any address in the segment
+*/
+void msp430Flash_erase_segment(uint8_t *flashSegmentAddrP) {
+    uint16_t addr = hostFlash_ptrToAddr(flashSegmentAddrP);
+    uint16_t segIndex = hostFlash_segIndex(addr);
+    uint16_t segAddr = hostFlash_getSegAddr(segIndex);
+    uint16_t segSize = (segIndex >= 128) ? HOST_FLASH_INFO_SEGMENT_SIZE : HOST_FLASH_MAIN_SEGMENT_SIZE;
+    hostFlashSegStats_t *sP = &hfData.segStats[segIndex];
+
+    memset(&hfData.imageP[segAddr], 0xFF, segSize);
+    hostFlash_mirror(segAddr, segSize);
+
+    sP->erases++;
+    sP->progTimeUs += HOST_FLASH_ERASE_TFTG * HOST_FLASH_TFTG_US;
+    sP->byteModeTimeUs += HOST_FLASH_ERASE_TFTG * HOST_FLASH_TFTG_US;
+}
+
+/**
+* \brief Write data bytes to flash.  Only bits that are 1 in
+*        flash can be cleared; a 0->1 request is flagged and
+*        the bit stays 0, as on the real part.
+* \ingroup PUBLIC_API
+*
+* @param flashP  starting flash addr to write to
+* @param srcP starting addr where data is read from
+* @param num_bytes number of bytes to write
+*/
+void msp430Flash_write_bytes(uint8_t *flashP, uint8_t *srcP, uint16_t num_bytes) {
+    uint16_t addr = hostFlash_ptrToAddr(flashP);
+    uint16_t i;
+    uint32_t ops = 0;
+    hostFlashSegStats_t *sP;
+
+    if (((uint32_t)addr + num_bytes) > HOST_FLASH_IMAGE_SIZE) {
+        fprintf(stderr, "hostFlash: write past end of flash 0x%04X len %u\n", addr, num_bytes);
+        exit(1);
+    }
+
+    for (i = 0; i < num_bytes; i++) {
+        uint8_t *cellP = &hfData.imageP[addr + i];
+        if (srcP[i] & ~(*cellP)) {
+            sP = &hfData.segStats[hostFlash_segIndex(addr + i)];
+            sP->illegalWrites++;
+            if (hfData.illegalReports < HOST_FLASH_MAX_ILLEGAL_REPORTS) {
+                hfData.illegalReports++;
+                fprintf(stderr, "hostFlash: illegal 0->1 write at 0x%04X (flash 0x%02X data 0x%02X)\n",
+                        addr + i, *cellP, srcP[i]);
+            }
+            if (hfData.strict) {
+                exit(1);
+            }
+        }
+        *cellP &= srcP[i];
+    }
+    hostFlash_mirror(addr, num_bytes);
+
+    // Account the write to the segment of the first byte
+    sP = &hfData.segStats[hostFlash_segIndex(addr)];
+    sP->writeCalls++;
+    sP->bytesWritten += num_bytes;
+    sP->progTimeUs += hostFlash_driverTimeUs(addr, num_bytes, &ops);
+    sP->programOps += ops;
+    sP->byteModeTimeUs += num_bytes * ((HOST_FLASH_PROGRAM_TFTG * HOST_FLASH_TFTG_US) + HOST_FLASH_OP_OVERHEAD_US);
+}
+
+/**
+* \brief Write one 16 bit value to flash, MSB first (same as the
+*        firmware flash.c).
+* \ingroup PUBLIC_API
+*
+* @param flashP  starting flash addr to write to
+* @param val16 16 bit value to write
+*/
+void msp430Flash_write_int(uint8_t *flashP, uint16_t val16) {
+    uint8_t bytes[2];
+    bytes[0] = (val16 >> 8) & 0xff;
+    bytes[1] =  val16 & 0xff;
+    msp430Flash_write_bytes(flashP, &bytes[0], ((uint16_t)2));
+}
+
+/***************************
+ * Module Private Functions
+ **************************/
+
+/**
+* \brief Translate a firmware flash pointer to the MSP430
+*        address.
+*
+* @param p firmware pointer
+*
+* @return uint16_t MSP430 address
+*/
+static uint16_t hostFlash_ptrToAddr(const void *p) {
+    const uint8_t *bP = (const uint8_t *)p;
+    uint8_t i;
+    if ((bP >= hfData.imageP) && (bP < (hfData.imageP + HOST_FLASH_IMAGE_SIZE))) {
+        return (uint16_t)(bP - hfData.imageP);
+    }
+    for (i = 0; i < hfData.numRegions; i++) {
+        hostFlashRegion_t *regionP = &hfData.regions[i];
+        if ((bP >= regionP->hostP) && (bP < (regionP->hostP + regionP->length))) {
+            return regionP->flashAddr + (uint16_t)(bP - regionP->hostP);
+        }
+    }
+    if ((uintptr_t)p < HOST_FLASH_IMAGE_SIZE) {
+        return (uint16_t)(uintptr_t)p;
+    }
+    fprintf(stderr, "hostFlash: pointer %p is not mapped to flash\n", p);
+    exit(1);
+}
+
+/**
+* \brief Get the segment index for a MSP430 address.
+*
+* @param flashAddr MSP430 address
+*
+* @return uint16_t segment index
+*/
+static uint16_t hostFlash_segIndex(uint16_t flashAddr) {
+    if ((flashAddr >= 0x1000) && (flashAddr < 0x1100)) {
+        return 128 + ((flashAddr - 0x1000) / HOST_FLASH_INFO_SEGMENT_SIZE);
+    }
+    return flashAddr / HOST_FLASH_MAIN_SEGMENT_SIZE;
+}
+
+/**
+* \brief Copy a range of the image to any host object that
+*        shadows it.
+*
+* @param flashAddr MSP430 address
+* @param length length in bytes
+*/
+static void hostFlash_mirror(uint16_t flashAddr, uint16_t length) {
+    uint8_t i;
+    uint32_t start = flashAddr;
+    uint32_t end = start + length;
+    for (i = 0; i < hfData.numRegions; i++) {
+        hostFlashRegion_t *regionP = &hfData.regions[i];
+        uint32_t rStart = regionP->flashAddr;
+        uint32_t rEnd = rStart + regionP->length;
+        uint32_t lo = (start > rStart) ? start : rStart;
+        uint32_t hi = (end < rEnd) ? end : rEnd;
+        if (lo < hi) {
+            memcpy(&regionP->hostP[lo - rStart], &hfData.imageP[lo], hi - lo);
+        }
+    }
+}
+
+/**
+* \brief Model the time flash.c takes for one write call: a
+*        leading odd byte, words, then a trailing byte (or one
+*        byte at a time in byte mode).
+*
+* @param flashAddr MSP430 address
+* @param num_bytes number of bytes
+* @param opsP returns the number of program operations
+*
+* @return double time in microseconds
+*/
+static double hostFlash_driverTimeUs(uint16_t flashAddr, uint16_t num_bytes, uint32_t *opsP) {
+    double opUs = (HOST_FLASH_PROGRAM_TFTG * HOST_FLASH_TFTG_US) + HOST_FLASH_OP_OVERHEAD_US;
+    double timeUs = 0;
+    uint8_t step;
+
+    while (num_bytes) {
+        step = (hfData.byteMode || (flashAddr & 0x1) || (num_bytes == 1)) ? 1 : 2;
+        timeUs += opUs;
+        (*opsP)++;
+        flashAddr += step;
+        num_bytes -= step;
+    }
+    return timeUs;
+}
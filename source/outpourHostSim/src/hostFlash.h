@@ -0,0 +1,76 @@
+/**
+ * @file hostFlash.h
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Host flash emulation.  Replaces flash.c in host builds.
+ *        The MSP430 flash is modeled by a file backed (mmap'd)
+ *        64KB image indexed by the MSP430 address.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * \def HOST_FLASH_IMAGE_SIZE
+ * \brief The image covers the full 16 bit MSP430 address space.
+ */
+#define HOST_FLASH_IMAGE_SIZE ((uint32_t)0x10000)
+
+/**
+ * \def HOST_FLASH_MAIN_SEGMENT_SIZE
+ * \brief Size of a main flash segment (erase unit).
+ */
+#define HOST_FLASH_MAIN_SEGMENT_SIZE ((uint16_t)512)
+
+/**
+ * \def HOST_FLASH_INFO_SEGMENT_SIZE
+ * \brief Size of an info flash segment (INFO A-D at
+ *        0x1000-0x10FF).
+ */
+#define HOST_FLASH_INFO_SEGMENT_SIZE ((uint16_t)64)
+
+/**
+ * \def HOST_FLASH_NUM_SEGMENTS
+ * \brief The 128 main segments followed by the 4 info segments.
+ */
+#define HOST_FLASH_NUM_SEGMENTS ((uint16_t)(128+4))
+
+/**
+ * \def FLASH_ADDR_TO_PTR
+ * \brief Firmware that reads flash through a 16 bit address
+ *        reads from the emulated image in host builds.  The size
+ *        estimate (sizeEstimate.py) defines the target cast.
+ */
+#ifndef FLASH_ADDR_TO_PTR
+#define FLASH_ADDR_TO_PTR(a) (hostFlash_addrToPtr((uint16_t)(uintptr_t)(a)))
+#endif
+
+/**
+ * \typedef hostFlashSegStats_t
+ * \brief Wear and timing accounting for one flash segment.
+ */
+typedef struct hostFlashSegStats_s {
+    uint32_t erases;        /**< number of segment erases */
+    uint32_t writeCalls;    /**< number of msp430Flash_write calls */
+    uint32_t bytesWritten;  /**< number of bytes programmed */
+    uint32_t programOps;    /**< byte/word program operations (30 tFTG each) */
+    uint32_t illegalWrites; /**< writes that tried to set a bit 0->1 */
+    double progTimeUs;      /**< modeled erase and program time */
+    double byteModeTimeUs;  /**< same data if programmed one byte at a time */
+} hostFlashSegStats_t;
+
+bool hostFlash_open(const char *imagePathP, bool erase);
+void hostFlash_close(void);
+void hostFlash_mapRegion(void *hostP, uint16_t flashAddr, uint16_t length);
+uint8_t *hostFlash_addrToPtr(uint16_t flashAddr);
+void hostFlash_setByteMode(bool enable);
+void hostFlash_setStrict(bool strict);
+void hostFlash_resetStats(void);
+hostFlashSegStats_t *hostFlash_getSegStats(uint16_t segIndex);
+uint16_t hostFlash_getSegAddr(uint16_t segIndex);
+void hostFlash_getTotals(hostFlashSegStats_t *totalsP);
+void hostFlash_printStats(FILE *fP);
@@ -0,0 +1,67 @@
+/**
+ * @file hostMsp430.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Host storage for the MSP430 registers declared in the
+ *        host msp430g2553.h stand-in.
+ */
+
+#include "msp430.h"
+
+volatile uint16_t hostSR = GIE;
+volatile uint8_t IE1;
+volatile uint8_t IFG1;
+volatile uint8_t IE2;
+volatile uint8_t IFG2;
+volatile uint8_t DCOCTL;
+volatile uint8_t BCSCTL1;
+volatile uint8_t BCSCTL2;
+volatile uint8_t BCSCTL3;
+volatile uint16_t FCTL1;
+volatile uint16_t FCTL2;
+volatile uint16_t FCTL3;
+volatile uint16_t WDTCTL;
+volatile uint8_t P1IN;
+volatile uint8_t P1OUT;
+volatile uint8_t P1DIR;
+volatile uint8_t P1IFG;
+volatile uint8_t P1IES;
+volatile uint8_t P1IE;
+volatile uint8_t P1SEL;
+volatile uint8_t P1SEL2;
+volatile uint8_t P1REN;
+volatile uint8_t P2IN;
+volatile uint8_t P2OUT;
+volatile uint8_t P2DIR;
+volatile uint8_t P2SEL;
+volatile uint8_t P2SEL2;
+volatile uint8_t P3OUT;
+volatile uint8_t P3DIR;
+volatile uint16_t TA0CTL;
+volatile uint16_t TA0R;
+volatile uint16_t TA0CCTL0;
+volatile uint16_t TA0CCTL1;
+volatile uint16_t TA0CCTL2;
+volatile uint16_t TA0CCR0;
+volatile uint16_t TA0CCR1;
+volatile uint16_t TA0CCR2;
+volatile uint16_t TA1CTL;
+volatile uint16_t TA1R;
+volatile uint16_t TA1CCTL0;
+volatile uint16_t TA1CCTL1;
+volatile uint16_t TA1CCTL2;
+volatile uint16_t TA1CCR0;
+volatile uint16_t TA1CCR1;
+volatile uint16_t TA1CCR2;
+volatile uint8_t UCA0CTL0;
+volatile uint8_t UCA0CTL1;
+volatile uint8_t UCA0BR0;
+volatile uint8_t UCA0BR1;
+volatile uint8_t UCA0MCTL;
+volatile uint8_t UCA0STAT;
+volatile uint8_t UCA0RXBUF;
+volatile uint16_t UCA0TXBUF;
+volatile uint16_t ADC10CTL0;
+volatile uint16_t ADC10CTL1;
+volatile uint16_t ADC10MEM;
@@ -0,0 +1,1260 @@
+/**
+ * @file modemSim.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Run the application modem stack (modemLink.c, modemCmd.c,
+ *        modemMgr.c, msgDataSm.c and msgOta.c) against an emulated
+ *        modem in virtual time, with UART fault injection.
+ *
+ * The emulator speaks the modem protocol: a command frame is the
+ * start byte (0x3C), the command, its header and payload, the
+ * CRC16 of the command, header and payload, and the end byte
+ * (0x3B).  A response is framed the same way with the response
+ * start byte (0x3E).  It answers PING, MODEM_STATUS,
+ * MESSAGE_STATUS, SEND_DATA, GET_INCOMING_PARTIAL,
+ * DELETE_INCOMING and POWER_OFF, and keeps a queue of incoming OTA
+ * messages that is loaded at the start of each session.
+ *
+ * The UART is modeled byte by byte at 9600 baud.  The transmit ISR
+ * is called whenever its interrupt is enabled and the transmit
+ * buffer is free (double buffered, as the USCI), and a byte the
+ * ISR loads is received by the emulator when its stop bit is on
+ * the wire.  The response bytes are passed to the receive ISR
+ * when the receive interrupt is enabled (lost otherwise, as an
+ * overrun).  Between the bytes, the execs run on the one second
+ * tick in the order of the sysExec main loop, and modemCmd_exec
+ * runs when a UART ISR wakes up the main loop.
+ *
+ * A scenario sets the modem response time, the link state
+ * sequence and the faults: bytes dropped on the wire (each
+ * direction), responses with a bad CRC and commands the modem
+ * ignores.  The modem drops a partial frame after 20 ms without a
+ * byte.  Each session sends daily logs, processes the OTA queue
+ * and releases the modem; the session time, modem on time and the
+ * bytes on the wire are reported per scenario.
+ */
+
+#include <stdlib.h>
+#include "outpour.h"
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def SIM_BYTE_US
+ * \brief Time of one byte on the wire (start, 8 data, stop bits at
+ *        9600 baud) in microseconds.
+ */
+#define SIM_BYTE_US ((uint64_t)1042)
+
+/**
+ * \def SIM_US_PER_SEC
+ * \brief For clarity in the code
+ */
+#define SIM_US_PER_SEC ((uint64_t)1000000)
+
+/**
+ * \def SIM_FRAME_GAP_US
+ * \brief The modem drops a partial command frame after this long
+ *        without a byte.
+ */
+#define SIM_FRAME_GAP_US ((uint64_t)20000)
+
+/**
+ * \def SIM_MODEM_BOOT_SEC
+ * \brief Default seconds from power on (LS_VCC and GSM_DCDC set)
+ *        before the modem answers on the UART and raises GSM_STATUS.
+ */
+#define SIM_MODEM_BOOT_SEC ((uint32_t)10)
+
+/**
+ * \def SIM_MAX_SESSION_SEC
+ * \brief A session that has not released the modem after this long
+ *        is stopped and counted as hung.
+ */
+#define SIM_MAX_SESSION_SEC ((uint32_t)1800)
+
+/**
+ * \def SIM_MAX_FRAME
+ * \brief Largest command or response frame handled by the emulator.
+ */
+#define SIM_MAX_FRAME ((uint16_t)768)
+
+/**
+ * \def SIM_MAX_WIRE
+ * \brief Bytes that can be in flight to the emulator or queued for
+ *        the MCU.
+ */
+#define SIM_MAX_WIRE ((uint16_t)1024)
+
+/**
+ * \def SIM_MAX_OTA_MSGS
+ * \brief Size of the incoming OTA queue.
+ */
+#define SIM_MAX_OTA_MSGS ((uint8_t)32)
+
+/**
+ * \def SIM_DATA_PAYLOAD_BYTES
+ * \brief Size of a daily log send (the 128 byte daily packet less
+ *        the two bytes added by modemCmd).
+ */
+#define SIM_DATA_PAYLOAD_BYTES ((uint16_t)126)
+
+/**
+ * \def SIM_MULTI_DAY_*
+ * \brief Layout of a multi-day message (MSG_TYPE_MULTI_DAY): the 
+ *        shared 14 byte header, then per day the day offset and
+ *        the 90 bytes of daily log data.  The daily log data is
+ *        the sent daily log after its header.
+ */
+#define SIM_MULTI_DAY_HEADER_BYTES ((uint16_t)14)
+#define SIM_MULTI_DAY_LOG_BYTES    ((uint16_t)90)
+#define SIM_MULTI_DAY_MAX_DAYS     ((uint8_t)7)
+
+/**
+ * \def SIM_TXBUF_EMPTY
+ * \brief Value written to UCA0TXBUF before calling the transmit
+ *        ISR, to tell whether the ISR loaded a byte (the host
+ *        UCA0TXBUF is 16 bits wide for this).
+ */
+#define SIM_TXBUF_EMPTY ((uint16_t)0xFFFF)
+
+/**
+ * \def SIM_MSG_HEADER_BYTES
+ * \brief Size of the message header (storageMgr_prepareMsgHeader).
+ */
+#define SIM_MSG_HEADER_BYTES ((uint8_t)14)
+
+/**
+ * \typedef simScenario_t
+ * \brief Modem behavior and faults of a scenario.
+ */
+typedef struct simScenario_s {
+    const char *nameP;          /**< scenario name */
+    uint16_t respDelayMs;       /**< modem processing time before a response */
+    uint16_t jitterMs;          /**< random extra processing time (0 to jitter) */
+    uint16_t connectSec;        /**< link state CONNECTED this long after power on */
+    uint8_t errorState;         /**< state reported instead of CONNECTED (0 for none) */
+    float dropRate;             /**< chance to drop a byte on the wire (each direction) */
+    float badCrcRate;           /**< chance of a response with a bad CRC */
+    float ignoreRate;           /**< chance the modem ignores a good command */
+} simScenario_t;
+
+/**
+ * \typedef simOtaMsg_t
+ * \brief An incoming OTA message.
+ */
+typedef struct simOtaMsg_s {
+    uint8_t length;             /**< message length in bytes */
+    uint8_t data[255];          /**< message */
+} simOtaMsg_t;
+
+/**
+ * \typedef simWireByte_t
+ * \brief A byte on the wire and the time it is received.
+ */
+typedef struct simWireByte_s {
+    uint64_t timeUs;            /**< time the stop bit is received */
+    uint8_t value;              /**< the byte */
+} simWireByte_t;
+
+/**
+ * \typedef simStats_t
+ * \brief Results of one session, or the sum over the sessions of a
+ *        scenario.
+ */
+typedef struct simStats_s {
+    uint32_t sessions;          /**< sessions run */
+    uint64_t sessionUs;         /**< time from start to modem release */
+    uint64_t maxSessionUs;      /**< longest session */
+    uint64_t modemOnUs;         /**< time the modem was powered */
+    uint32_t txBytes;           /**< bytes sent by the MCU (wire) */
+    uint32_t rxBytes;           /**< bytes sent by the modem (wire) */
+    uint32_t dropped;           /**< bytes dropped by fault injection */
+    uint32_t overruns;          /**< bytes sent while the MCU receive was off */
+    uint32_t commands;          /**< good command frames */
+    uint32_t badFrames;         /**< bad or partial command frames */
+    uint32_t ignored;           /**< good commands ignored by fault injection */
+    uint32_t badCrcs;           /**< responses sent with a bad CRC */
+    uint32_t dataSent;          /**< daily logs received by the modem */
+    uint32_t badData;           /**< data messages received with a bad payload */
+    uint32_t otaReplies;        /**< OTA replies received by the modem */
+    uint32_t otaDeleted;        /**< OTA messages deleted from the queue */
+    uint32_t otaLeft;           /**< OTA messages left in the queue */
+    uint32_t powerCycles;       /**< modem power ups */
+    uint32_t commErrors;        /**< sessions that ended with a comm error */
+    uint32_t connectTimeouts;   /**< sessions without a network link */
+    uint32_t hung;              /**< sessions stopped at SIM_MAX_SESSION_SEC */
+    uint32_t budgetCuts;        /**< sessions cut at the modem session budget */
+    uint32_t warmStarts;        /**< sessions started with the modem held on */
+} simStats_t;
+
+/**
+ * \typedef simData_t
+ * \brief Module data structure.
+ */
+typedef struct simData_s {
+    uint64_t nowUs;             /**< virtual time */
+    uint32_t seconds;           /**< getSecondsSinceBoot stub */
+    const simScenario_t *scenP; /**< current scenario */
+    uint32_t rng;               /**< fault injection random state */
+    bool quiet;                 /**< only print the scenario summaries */
+    uint8_t budget[3];          /**< modem session and day budget in minutes (0 for the default), hold time */
+    uint32_t gapSec;            /**< time from the end of a session to the next */
+    bool noStatusPin;           /**< the modem does not drive GSM_STATUS */
+    uint32_t bootSec;           /**< modem boot time */
+
+    uint64_t txBufFreeUs;       /**< MCU UART transmit buffer free */
+    uint64_t txWireFreeUs;      /**< MCU to modem wire free */
+    simWireByte_t toModem[SIM_MAX_WIRE]; /**< bytes in flight to the modem */
+    uint16_t toModemHead;       /**< next byte to receive */
+    uint16_t toModemCount;      /**< bytes in flight */
+    simWireByte_t toMcu[SIM_MAX_WIRE];   /**< bytes queued by the modem */
+    uint16_t toMcuHead;         /**< next byte to deliver */
+    uint16_t toMcuCount;        /**< bytes queued */
+    uint64_t toMcuWireFreeUs;   /**< modem to MCU wire free */
+
+    bool powered;               /**< modem supply on */
+    uint64_t powerOnUs;         /**< time the supply came on */
+    uint64_t onCountUs;         /**< modem on time counted up to here */
+    bool modemOff;              /**< POWER_OFF received (until a power cycle) */
+    uint8_t frame[SIM_MAX_FRAME]; /**< command frame being received (after the start byte) */
+    uint16_t frameIndex;        /**< bytes received, 0 if waiting for a start byte */
+    bool inFrame;               /**< start byte received */
+    uint64_t lastByteUs;        /**< time of the last command byte */
+
+    simOtaMsg_t ota[SIM_MAX_OTA_MSGS]; /**< OTA messages loaded per session */
+    uint8_t numOta;             /**< OTA messages loaded per session */
+    simOtaMsg_t queue[SIM_MAX_OTA_MSGS]; /**< modem incoming queue */
+    uint8_t queueCount;         /**< messages in the incoming queue */
+
+    dataMsgSm_t session;        /**< the data message session */
+    uint8_t packetsLeft;        /**< daily logs still to send */
+    uint8_t daysPerMsg;         /**< daily logs per multi-day message (-m, 0 for one per message) */
+    uint8_t msgDays;            /**< daily logs in the multi-day message being sent */
+    uint8_t dataPayload[SIM_DATA_PAYLOAD_BYTES]; /**< daily log sent */
+    simStats_t stats;           /**< current session results */
+    simStats_t total;           /**< scenario results */
+} simData_t;
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+/**
+* \var scenarios
+* \brief The built in scenarios.
+*/
+static const simScenario_t scenarios[] = {
+    { "clean",               20,  10,  30, 0,                          0,     0,    0    },
+    { "slow modem",         400, 300,  30, 0,                          0,     0,    0    },
+    { "late link (5 min)",   20,  10, 300, 0,                          0,     0,    0    },
+    { "register error",      20,  10,  60, MODEM_STATE_ERROR_REGISTER, 0,     0,    0    },
+    { "drop 0.1% bytes",     20,  10,  30, 0,                          0.001, 0,    0    },
+    { "drop 1% bytes",       20,  10,  30, 0,                          0.01,  0,    0    },
+    { "bad crc 5%",          20,  10,  30, 0,                          0,     0.05, 0    },
+    { "ignore 10% cmds",     20,  10,  30, 0,                          0,     0,    0.10 },
+    { "no network",          20,  10, 0xFFFF, 0,                       0,     0,    0    },
+};
+
+/**
+* \var defaultOta
+* \brief The OTA queue if no OTA file is given: a GMT clock set (no
+*        offset), a local offset and an activate device message.
+*/
+static const uint8_t defaultOta[][8] = {
+    { OTA_OPCODE_GMT_CLOCKSET,    0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { OTA_OPCODE_LOCAL_OFFSET,    0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { OTA_OPCODE_ACTIVATE_DEVICE, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 },
+};
+
+// static
+simData_t sData;
+
+/**
+* \var USCI0TX_ISR, USCI0RX_ISR
+* \brief The UART ISRs of modemCmd.c
+*/
+extern __interrupt void USCI0TX_ISR(void);
+extern __interrupt void USCI0RX_ISR(void);
+
+/*********************
+ * Module Prototypes
+ *********************/
+
+static void sim_runScenario(const simScenario_t *scenP, uint32_t sessions, uint8_t packets);
+static void sim_runSession(uint8_t packets);
+static void sim_nextDataMsg(modemCmdWriteData_t *cmdWriteP);
+#if (DATA_MSG_MULTI_DAY==1)
+static uint16_t sim_getMultiDaySegment(uint8_t segment, uint8_t **dataPP);
+#endif
+static void sim_tick(void);
+static void sim_runUart(uint64_t untilUs);
+static void sim_txIsr(void);
+static void sim_checkWake(void);
+static void sim_checkPower(void);
+static void sim_modemRxByte(uint8_t value, uint64_t timeUs);
+static void sim_modemCommand(uint16_t headerLength, uint64_t timeUs);
+static void sim_modemRespond(const uint8_t *dataP, uint16_t length, uint64_t timeUs);
+static uint8_t sim_linkState(uint64_t timeUs);
+static void sim_printStats(const char *nameP, simStats_t *statsP);
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+static void sim_printRtt(void);
+#endif
+static void sim_addStats(simStats_t *sumP, const simStats_t *statsP);
+static uint32_t sim_loadOta(const char *fileNameP);
+static uint32_t sim_get32(const uint8_t *dataP);
+static void sim_put32(uint8_t *dataP, uint32_t value);
+static float sim_rand(void);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Usage: modemSim [-n sessions] [-p packets] [-s seed]
+*        [-q] [-d delayMs,jitterMs] [-c connectSec] [-e state]
+*        [-x drop rate] [-b bad crc rate] [-i ignore rate]
+*        [-g sessionMin,dayMin[,holdSec]] [-a gapSec]
+*        [-w bootSec] [-t statusPin] [-m days] [ota file]
+*        Without a fault or timing option, the built in
+*        scenarios are run.  With one, a single scenario is run
+*        with the given values (the others as in "clean").  The
+*        ota file has one OTA message per line as hex bytes
+*        (opcode, msgId[2], data); lines starting with '#' are
+*        ignored.  -g sets the modem energy budget and hold time
+*        (as the OTA message does), -a the time between two
+*        sessions (60 s).  -w sets the modem boot time and -t 0
+*        emulates a modem that does not drive GSM_STATUS.  -m
+*        sends the daily logs in multi-day messages of up to
+*        days daily logs, read segment by segment by the
+*        transmit ISR.
+*
+* @return int 0 if the simulation ran
+*/
+int main(int argc, char *argv[]) {
+    simScenario_t custom = scenarios[0];
+    bool useCustom = false;
+    uint32_t sessions = 20;
+    uint8_t packets = 1;
+    const char *otaFileP = NULL;
+    uint32_t i;
+
+    sData.rng = 1;
+    sData.bootSec = SIM_MODEM_BOOT_SEC;
+    // modemMgr_init reads INFO A with MODEM_TRANSMIT_SPREAD
+    hostFlash_open(NULL, true);
+    sData.gapSec = 60;
+    for (i = 1; i < (uint32_t)argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            sData.quiet = true;
+        } else if ((argv[i][0] == '-') && ((i + 1) < (uint32_t)argc)) {
+            switch (argv[i][1]) {
+            case 'n': sessions = strtoul(argv[++i], NULL, 0); break;
+            case 'p': packets = strtoul(argv[++i], NULL, 0); break;
+            case 's': sData.rng = strtoul(argv[++i], NULL, 0) | 1; break;
+            case 'c': custom.connectSec = strtoul(argv[++i], NULL, 0); useCustom = true; break;
+            case 'e': custom.errorState = strtoul(argv[++i], NULL, 0); useCustom = true; break;
+            case 'x': custom.dropRate = atof(argv[++i]); useCustom = true; break;
+            case 'b': custom.badCrcRate = atof(argv[++i]); useCustom = true; break;
+            case 'i': custom.ignoreRate = atof(argv[++i]); useCustom = true; break;
+            case 'a': sData.gapSec = strtoul(argv[++i], NULL, 0); break;
+            case 'w': sData.bootSec = strtoul(argv[++i], NULL, 0); break;
+            case 't': sData.noStatusPin = !strtoul(argv[++i], NULL, 0); break;
+            case 'm':
+#if (DATA_MSG_MULTI_DAY==1)
+                sData.daysPerMsg = strtoul(argv[++i], NULL, 0);
+                if (sData.daysPerMsg > SIM_MULTI_DAY_MAX_DAYS) {
+                    sData.daysPerMsg = SIM_MULTI_DAY_MAX_DAYS;
+                }
+                break;
+#else
+                fprintf(stderr, "-m needs the multi-day messages (DATA_MSG_MULTI_DAY=1)\n");
+                return 1;
+#endif
+            case 'd': {
+                unsigned int delayMs, jitterMs;
+                if (sscanf(argv[++i], "%u,%u", &delayMs, &jitterMs) != 2) {
+                    fprintf(stderr, "-d needs delayMs,jitterMs\n");
+                    return 1;
+                }
+                custom.respDelayMs = delayMs;
+                custom.jitterMs = jitterMs;
+                useCustom = true;
+                break;
+            }
+            case 'g': {
+                unsigned int sessionMin, dayMin, holdSec = 0;
+                if (sscanf(argv[++i], "%u,%u,%u", &sessionMin, &dayMin, &holdSec) < 2) {
+                    fprintf(stderr, "-g needs sessionMin,dayMin[,holdSec]\n");
+                    return 1;
+                }
+                sData.budget[0] = sessionMin;
+                sData.budget[1] = dayMin;
+                sData.budget[2] = holdSec;
+                break;
+            }
+            default:
+                fprintf(stderr, "usage: %s [-n sessions] [-p packets] [-s seed] [-q] [-d delayMs,jitterMs] [-c connectSec] [-e state] [-x drop rate] [-b bad crc rate] [-i ignore rate] [-g sessionMin,dayMin[,holdSec]] [-a gapSec] [-w bootSec] [-t statusPin] [-m days] [ota file]\n", argv[0]);
+                return 1;
+            }
+        } else {
+            otaFileP = argv[i];
+        }
+    }
+
+    if (otaFileP) {
+        if (!sim_loadOta(otaFileP)) {
+            fprintf(stderr, "could not load %s\n", otaFileP);
+            return 1;
+        }
+    } else {
+        for (i = 0; i < (sizeof(defaultOta) / sizeof(defaultOta[0])); i++) {
+            sData.ota[i].length = sizeof(defaultOta[0]);
+            memcpy(sData.ota[i].data, defaultOta[i], sizeof(defaultOta[0]));
+        }
+        sData.numOta = i;
+    }
+    for (i = 0; i < SIM_DATA_PAYLOAD_BYTES; i++) {
+        sData.dataPayload[i] = i;
+    }
+
+    printf("%u sessions per scenario, %u daily log(s) and %u OTA message(s) per session\n",
+           sessions, packets, sData.numOta);
+    if (useCustom) {
+        custom.nameP = "custom";
+        sim_runScenario(&custom, sessions, packets);
+    } else {
+        for (i = 0; i < (sizeof(scenarios) / sizeof(scenarios[0])); i++) {
+            sim_runScenario(&scenarios[i], sessions, packets);
+        }
+    }
+    return 0;
+}
+
+/**
+* \brief Time stubs (time.c is not linked)
+*/
+uint32_t getSecondsSinceBoot(void) {
+    return sData.seconds;
+}
+
+fine_tick_t getFineTicksSinceBoot(void) {
+    return (fine_tick_t)((sData.nowUs * FINE_TICKS_PER_SEC) / SIM_US_PER_SEC);
+}
+
+#if (MODEM_LINK_FAST_POWER_UP==1)
+void timerA1_sleepFineTicks(uint16_t fineTicks) {
+    sim_checkPower();
+    sData.nowUs += ((uint64_t)fineTicks * SIM_US_PER_SEC) / FINE_TICKS_PER_SEC;
+}
+#endif
+
+timePacket_t* getBinTime(void) {
+    static timePacket_t tp;
+    uint32_t seconds = sData.seconds;
+    tp.second = seconds % 60;
+    tp.minute = (seconds / 60) % 60;
+    tp.hour24 = (seconds / 3600) % 24;
+    return &tp;
+}
+
+#if (GMT_CLOCKSET_ONE_STEP==1)
+void advanceBinTime(uint16_t binDays, uint8_t binHours, uint8_t binMinutes, uint8_t binSeconds) {
+}
+#else
+void incrementSeconds(void) {
+}
+
+void incrementMinutes(void) {
+}
+
+void incrementHours(void) {
+}
+
+void incrementDays(void) {
+}
+#endif
+
+uint8_t bcd_to_char(uint8_t bcdValue) {
+    return ((bcdValue >> 4) * 10) + (bcdValue & 0xF);
+}
+
+/**
+* \brief modemLink_isModemUpError is declared in outpour.h and used
+*        by modemMgr.c, but modemLink.c does not implement it.
+*/
+bool modemLink_isModemUpError(void) {
+    return false;
+}
+
+/**
+* \brief Storage and system stubs used by msgOta.c, modemMgr.c and
+*        msgDataSm.c
+*/
+void storageMgr_logEvent(debugEvents_t event, uint8_t payload) {
+    if ((event == EVENT_MODEM_BUDGET) && payload) {
+        sData.stats.budgetCuts++;
+    }
+}
+
+void storageMgr_getModemConfig(modemConfig_t *configP) {
+    memset(configP, 0, sizeof(modemConfig_t));
+    configP->sessionMinutes = sData.budget[0];
+    configP->dayMinutes = sData.budget[1];
+    configP->keepWarmSecs = sData.budget[2];
+}
+
+void storageMgr_setModemConfig(modemConfig_t *configP) {
+    sData.budget[0] = configP->sessionMinutes;
+    sData.budget[1] = configP->dayMinutes;
+}
+
+void storageMgr_setStorageAlignmentTime(uint8_t alignSecond, uint8_t alignMinute, uint8_t alignHour24) {
+}
+
+void storageMgr_overrideUnitActivation(bool flag) {
+}
+
+void storageMgr_resetRedFlagAndMap(void) {
+}
+
+void storageMgr_resetWeeklyLogs(void) {
+}
+
+void storageMgr_resetRedFlag(void) {
+}
+
+#if (MINUTE_FLOW_CAPTURE==1)
+bool storageMgr_setMinuteCaptureConfig(uint8_t *configP) {
+    return true;
+}
+#endif
+
+
+uint8_t storageMgr_prepareMsgHeader(uint8_t *dataPtr) {
+    memset(dataPtr, 0, SIM_MSG_HEADER_BYTES);
+    return SIM_MSG_HEADER_BYTES;
+}
+
+bool sysExec_startRebootCountdown(uint8_t *keysP) {
+    return true;
+}
+
+void sysError(void) {
+    fprintf(stderr, "sysError at %.6f s\n", (double)sData.nowUs / SIM_US_PER_SEC);
+    exit(1);
+}
+
+/***************************
+ * Module Private Functions
+ **************************/
+
+/**
+* \brief Run the sessions of a scenario and print the results.
+*        The firmware modules are initialized at the start of the
+*        scenario (the round trip times are kept over its
+*        sessions, as on a unit).
+*
+* @param scenP the scenario
+* @param sessions number of sessions
+* @param packets daily logs per session
+*/
+static void sim_runScenario(const simScenario_t *scenP, uint32_t sessions, uint8_t packets) {
+    uint32_t i;
+
+    sData.scenP = scenP;
+    memset(&sData.total, 0, sizeof(simStats_t));
+    // Start with the modem off (it may be held from the last scenario)
+    modemLink_shutdownModem();
+    sim_checkPower();
+    modemLink_init();
+    modemCmd_init();
+    modemMgr_init();
+    dataMsgSm_init();
+    otaMsgMgr_init();
+    for (i = 0; i < sessions; i++) {
+        sim_runSession(packets);
+        if (!sData.quiet) {
+            char name[32];
+            snprintf(name, sizeof(name), "  session %u", i);
+            sim_printStats(name, &sData.stats);
+        }
+        sim_addStats(&sData.total, &sData.stats);
+    }
+    sim_printStats(scenP->nameP, &sData.total);
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+    sim_printRtt();
+#endif
+}
+
+/**
+* \brief Run one session: send the daily logs, process the OTA
+*        queue and release the modem, as dataMsgMgr_exec does.
+*
+* @param packets daily logs to send
+*/
+static void sim_runSession(uint8_t packets) {
+    uint64_t startUs;
+    uint32_t i;
+    dataMsgSm_t *sessionP = &sData.session;
+
+    memset(&sData.stats, 0, sizeof(simStats_t));
+    sData.stats.sessions = 1;
+    sData.stats.warmStarts = sData.powered ? 1 : 0;
+    memcpy(sData.queue, sData.ota, sizeof(sData.ota));
+    sData.queueCount = sData.numOta;
+
+    // Start on a tick, with the modem off
+    sData.nowUs = (uint64_t)sData.seconds * SIM_US_PER_SEC;
+    startUs = sData.nowUs;
+    dataMsgSm_initForNewSession(sessionP);
+    sData.packetsLeft = packets;
+    if (sData.packetsLeft) {
+        sessionP->cmdWrite.cmd = M_COMMAND_SEND_DATA;
+        sim_nextDataMsg(&sessionP->cmdWrite);
+    } else {
+        sessionP->cmdWrite.batchProfile = MODEM_BATCH_STATUS_ONLY;
+    }
+
+    while (!sessionP->allDone) {
+        if ((sData.nowUs - startUs) >= (SIM_MAX_SESSION_SEC * SIM_US_PER_SEC)) {
+            sData.stats.hung = 1;
+            otaMsgMgr_stopOtaProcessing();
+            modemMgr_release();
+            break;
+        }
+        sim_tick();
+        sim_runUart((uint64_t)(sData.seconds + 1) * SIM_US_PER_SEC);
+        sData.seconds++;
+        sData.nowUs = (uint64_t)sData.seconds * SIM_US_PER_SEC;
+    }
+    sim_checkPower();
+
+    sData.stats.sessionUs = sData.nowUs - startUs;
+    sData.stats.maxSessionUs = sData.stats.sessionUs;
+    sData.stats.commErrors = sessionP->commError;
+    sData.stats.connectTimeouts = sessionP->connectTimeout;
+    sData.stats.otaLeft = sData.queueCount;
+
+    // Let the modem finish and drop what is left on the wire
+    sData.toModemCount = 0;
+    sData.toMcuCount = 0;
+    sData.inFrame = false;
+
+    // The gap to the next session.  A modem held on after the release
+    // is shut down by modemMgr_exec; its on time counts for this session.
+    for (i = 0; i < sData.gapSec; i++) {
+        sData.seconds++;
+        sData.nowUs = (uint64_t)sData.seconds * SIM_US_PER_SEC;
+        sim_checkPower();
+        modemLink_exec();
+#if (MODEM_ENERGY_BUDGET==1)
+        modemMgr_exec();
+#endif
+        sim_checkPower();
+    }
+    if (sData.powered) {
+        sData.stats.modemOnUs += sData.nowUs - sData.onCountUs;
+        sData.onCountUs = sData.nowUs;
+    }
+}
+
+/**
+* \brief Set up the next data message of the session: one daily 
+*        log, or with -m a multi-day message of the next daily
+*        logs (the payload is read with sim_getMultiDaySegment,
+*        as dataMsgMgr reads it from storageMgr).
+*
+* @param cmdWriteP the session command to set up
+*/
+static void sim_nextDataMsg(modemCmdWriteData_t *cmdWriteP) {
+#if (DATA_MSG_MULTI_DAY==1)
+    if (sData.daysPerMsg) {
+        sData.msgDays = (sData.packetsLeft < sData.daysPerMsg) ? sData.packetsLeft : sData.daysPerMsg;
+        sData.packetsLeft -= sData.msgDays;
+        cmdWriteP->payloadMsgId = MSG_TYPE_MULTI_DAY;
+        cmdWriteP->payloadP = NULL;
+        cmdWriteP->payloadFuncP = sim_getMultiDaySegment;
+        cmdWriteP->payloadLength = SIM_MULTI_DAY_HEADER_BYTES + (sData.msgDays * (1 + SIM_MULTI_DAY_LOG_BYTES));
+        return;
+    }
+    cmdWriteP->payloadFuncP = NULL;
+#endif
+    sData.packetsLeft--;
+    cmdWriteP->payloadMsgId = MSG_TYPE_DAILY;
+    cmdWriteP->payloadP = sData.dataPayload;
+    cmdWriteP->payloadLength = SIM_DATA_PAYLOAD_BYTES;
+}
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+* \brief Multi-day payload segments (modemCmdPayloadFunc_t) laid 
+*        out like storageMgr_getMultiDaySegment: the header of the
+*        daily log, then per day the day offset and the daily log
+*        data.
+*
+* @param segment segment number
+* @param dataPP set to the segment data
+*
+* @return uint16_t segment length, 0 after the last segment
+*/
+static uint16_t sim_getMultiDaySegment(uint8_t segment, uint8_t **dataPP) {
+    static uint8_t offset;
+    if (segment == 0) {
+        *dataPP = sData.dataPayload;
+        return SIM_MULTI_DAY_HEADER_BYTES;
+    }
+    if (segment > (sData.msgDays * 2)) {
+        return 0;
+    }
+    if (segment & 1) {
+        offset = (segment - 1) / 2;
+        *dataPP = &offset;
+        return 1;
+    }
+    *dataPP = &sData.dataPayload[SIM_MULTI_DAY_HEADER_BYTES];
+    return SIM_MULTI_DAY_LOG_BYTES;
+}
+#endif
+
+/**
+* \brief The one second tick: run the communication execs in the
+*        order of the sysExec main loop.
+*/
+static void sim_tick(void) {
+    dataMsgSm_t *sessionP = &sData.session;
+
+    sim_checkPower();
+    modemCmd_exec();
+    // dataMsgMgr_exec: send the next daily log when the last is done
+    if (sData.packetsLeft && sessionP->sendCmdDone) {
+        sim_nextDataMsg(&sessionP->cmdWrite);
+        dataMsgSm_sendAnotherDataMsg(sessionP);
+    }
+    dataMsgSm_stateMachine(sessionP);
+    otaMsgMgr_exec();
+    modemCmd_exec();
+    modemLink_exec();
+#if (MODEM_ENERGY_BUDGET==1)
+    modemMgr_exec();
+#endif
+    sim_checkPower();
+}
+
+/**
+* \brief Run the UART and the modem emulator up to a time.
+*        Handles the next transmit ISR, modem receive and MCU
+*        receive event in time order.
+*
+* @param untilUs the end time
+*/
+static void sim_runUart(uint64_t untilUs) {
+    // The main loop sleeps until the tick
+    hostSR |= LPM3_bits;
+    while (1) {
+        uint64_t txUs = UINT64_MAX;
+        uint64_t toModemUs = UINT64_MAX;
+        uint64_t toMcuUs = UINT64_MAX;
+
+        if (UC0IE & UCA0TXIE) {
+            txUs = (sData.txBufFreeUs > sData.nowUs) ? sData.txBufFreeUs : sData.nowUs;
+        }
+        if (sData.toModemCount) {
+            toModemUs = sData.toModem[sData.toModemHead].timeUs;
+        }
+        if (sData.toMcuCount) {
+            toMcuUs = sData.toMcu[sData.toMcuHead].timeUs;
+        }
+
+        if ((txUs <= toModemUs) && (txUs <= toMcuUs) && (txUs < untilUs)) {
+            sData.nowUs = txUs;
+            sim_txIsr();
+            sim_checkWake();
+        } else if ((toModemUs <= toMcuUs) && (toModemUs < untilUs)) {
+            simWireByte_t *byteP = &sData.toModem[sData.toModemHead];
+            sData.nowUs = toModemUs;
+            sData.toModemHead = (sData.toModemHead + 1) % SIM_MAX_WIRE;
+            sData.toModemCount--;
+            sim_modemRxByte(byteP->value, byteP->timeUs);
+        } else if (toMcuUs < untilUs) {
+            simWireByte_t *byteP = &sData.toMcu[sData.toMcuHead];
+            sData.nowUs = toMcuUs;
+            sData.toMcuHead = (sData.toMcuHead + 1) % SIM_MAX_WIRE;
+            sData.toMcuCount--;
+            if (sim_rand() < sData.scenP->dropRate) {
+                sData.stats.dropped++;
+            } else if (UC0IE & UCA0RXIE) {
+                UCA0RXBUF = byteP->value;
+                USCI0RX_ISR();
+                sim_checkWake();
+            } else {
+                sData.stats.overruns++;
+            }
+        } else {
+            break;
+        }
+    }
+}
+
+/**
+* \brief The main loop between the ticks (see sysExec_exec): if 
+*        a UART ISR woke it up, run modemCmd_exec and sleep again.
+*/
+static void sim_checkWake(void) {
+    if (!(hostSR & CPUOFF)) {
+        modemCmd_exec();
+        hostSR |= LPM3_bits;
+    }
+}
+
+/**
+* \brief Call the transmit ISR.  A byte loaded by the ISR starts
+*        on the wire when the wire is free; the transmit buffer
+*        is free again as soon as it starts (double buffered).
+*/
+static void sim_txIsr(void) {
+    uint64_t startUs;
+    uint64_t endUs;
+
+    UCA0TXBUF = SIM_TXBUF_EMPTY;
+    USCI0TX_ISR();
+    if (UCA0TXBUF == SIM_TXBUF_EMPTY) {
+        // The ISR only disabled itself (end of the message)
+        if (UC0IE & UCA0TXIE) {
+            sData.txBufFreeUs = sData.nowUs + SIM_BYTE_US;
+        }
+        return;
+    }
+
+    startUs = (sData.txWireFreeUs > sData.nowUs) ? sData.txWireFreeUs : sData.nowUs;
+    endUs = startUs + SIM_BYTE_US;
+    sData.txWireFreeUs = endUs;
+    sData.txBufFreeUs = startUs;
+    sData.stats.txBytes++;
+    if (sim_rand() < sData.scenP->dropRate) {
+        sData.stats.dropped++;
+    } else if (sData.toModemCount < SIM_MAX_WIRE) {
+        simWireByte_t *byteP = &sData.toModem[(sData.toModemHead + sData.toModemCount) % SIM_MAX_WIRE];
+        byteP->timeUs = endUs;
+        byteP->value = (uint8_t)UCA0TXBUF;
+        sData.toModemCount++;
+    }
+}
+
+/**
+* \brief Follow the modem supply pins set by modemLink.c and drive
+*        GSM_STATUS.
+*/
+static void sim_checkPower(void) {
+    bool powered = ((P1OUT & GSM_DCDC) && (P1OUT & LS_VCC)) ? true : false;
+    if (powered && !sData.powered) {
+        sData.powerOnUs = sData.nowUs;
+        sData.onCountUs = sData.nowUs;
+        sData.stats.powerCycles++;
+        sData.modemOff = false;
+    } else if (!powered && sData.powered) {
+        sData.stats.modemOnUs += sData.nowUs - sData.onCountUs;
+        sData.inFrame = false;
+        sData.toMcuCount = 0;
+    }
+    sData.powered = powered;
+    P1IN &= ~GSM_STATUS;
+    if (powered && !sData.modemOff && !sData.noStatusPin &&
+        ((sData.nowUs - sData.powerOnUs) >= ((uint64_t)sData.bootSec * SIM_US_PER_SEC))) {
+        P1IN |= GSM_STATUS;
+    }
+}
+
+/**
+* \brief The modem receives a byte.  Collects a command frame and
+*        handles it when complete.
+*
+* @param value the byte
+* @param timeUs time the byte was received
+*/
+static void sim_modemRxByte(uint8_t value, uint64_t timeUs) {
+    uint16_t headerLength = 0;
+
+    if (!sData.powered || sData.modemOff ||
+        ((timeUs - sData.powerOnUs) < ((uint64_t)sData.bootSec * SIM_US_PER_SEC))) {
+        return;
+    }
+    if (sData.inFrame && ((timeUs - sData.lastByteUs) > SIM_FRAME_GAP_US)) {
+        sData.stats.badFrames++;
+        sData.inFrame = false;
+    }
+    sData.lastByteUs = timeUs;
+    if (!sData.inFrame) {
+        if (value == 0x3C) {
+            sData.inFrame = true;
+            sData.frameIndex = 0;
+        }
+        return;
+    }
+    sData.frame[sData.frameIndex++] = value;
+
+    // The command header (and payload) length
+    switch (sData.frame[0]) {
+    case M_COMMAND_PING:
+    case M_COMMAND_MODEM_INFO:
+    case M_COMMAND_MODEM_STATUS:
+    case M_COMMAND_MESSAGE_STATUS:
+    case M_COMMAND_DELETE_INCOMING:
+    case M_COMMAND_POWER_OFF:
+        headerLength = 1;
+        break;
+    case M_COMMAND_GET_INCOMING_PARTIAL:
+        headerLength = 9;
+        break;
+    case M_COMMAND_SEND_TEST:
+    case M_COMMAND_SEND_DATA:
+    case M_COMMAND_SEND_DEBUG_DATA:
+        if (sData.frameIndex < 5) {
+            return;
+        }
+        headerLength = 5 + sim_get32(&sData.frame[1]);
+        break;
+    default:
+        sData.stats.badFrames++;
+        sData.inFrame = false;
+        return;
+    }
+    if ((headerLength + 3) > SIM_MAX_FRAME) {
+        sData.stats.badFrames++;
+        sData.inFrame = false;
+        return;
+    }
+
+    // Wait for the crc[2] and the end byte
+    if (sData.frameIndex == (headerLength + 3)) {
+        uint16_t crc = (sData.frame[headerLength] << 8) | sData.frame[headerLength + 1];
+        sData.inFrame = false;
+        if ((sData.frame[headerLength + 2] != 0x3B) || (crc != gen_crc16(sData.frame, headerLength))) {
+            sData.stats.badFrames++;
+        } else if (sim_rand() < sData.scenP->ignoreRate) {
+            sData.stats.ignored++;
+        } else {
+            sData.stats.commands++;
+            sim_modemCommand(headerLength, timeUs);
+        }
+    }
+}
+
+/**
+* \brief Handle a good command frame.
+*
+* @param headerLength length of the command, header and payload
+* @param timeUs time the end byte was received
+*/
+static void sim_modemCommand(uint16_t headerLength, uint64_t timeUs) {
+    uint8_t resp[SIM_MAX_FRAME];
+    uint16_t length = 1;
+    uint8_t i;
+
+    resp[0] = sData.frame[0];
+    switch (sData.frame[0]) {
+    case M_COMMAND_MODEM_INFO:
+        // major, minor, imei[8] (MSB first)
+        memset(&resp[1], 0, 10);
+        resp[1] = 1;
+        {
+            uint64_t imei = 352906110000017ULL;
+            for (i = 0; i < 8; i++) {
+                resp[3 + i] = (uint8_t)(imei >> (56 - (8 * i)));
+            }
+        }
+        length += 10;
+        break;
+    case M_COMMAND_MODEM_STATUS:
+        // state, voltage[2], adc[2], rssi, signal, provisioned, temperature, spare
+        memset(&resp[1], 0, 10);
+        resp[1] = sim_linkState(timeUs);
+        resp[2] = 3900 >> 8;
+        resp[3] = 3900 & 0xFF;
+        resp[6] = 75;
+        resp[7] = 60;
+        resp[8] = 1;
+        resp[9] = 25;
+        length += 10;
+        break;
+    case M_COMMAND_MESSAGE_STATUS:
+        // incoming, test and data: count[2], size[4]
+        memset(&resp[1], 0, 18);
+        resp[1] = sData.queueCount >> 8;
+        resp[2] = sData.queueCount & 0xFF;
+        {
+            uint32_t size = 0;
+            for (i = 0; i < sData.queueCount; i++) {
+                size += sData.queue[i].length;
+            }
+            sim_put32(&resp[3], size);
+        }
+        length += 18;
+        break;
+    case M_COMMAND_SEND_DATA:
+        // payload: start byte 0x01, message type, data
+        if (sData.frame[6] == MSG_TYPE_OTAREPLY) {
+            sData.stats.otaReplies++;
+        } else if (sData.frame[6] == MSG_TYPE_MULTI_DAY) {
+            // Shared header, then the day offset and data of each day
+            uint32_t dataLength = sim_get32(&sData.frame[1]) - 2;
+            uint8_t *dataP = &sData.frame[7];
+            uint32_t days = (dataLength - SIM_MULTI_DAY_HEADER_BYTES) / (1 + SIM_MULTI_DAY_LOG_BYTES);
+            bool good = ((dataLength - SIM_MULTI_DAY_HEADER_BYTES) % (1 + SIM_MULTI_DAY_LOG_BYTES)) == 0;
+            good = good && !memcmp(dataP, sData.dataPayload, SIM_MULTI_DAY_HEADER_BYTES);
+            dataP += SIM_MULTI_DAY_HEADER_BYTES;
+            for (i = 0; good && (i < days); i++) {
+                good = (dataP[0] == i) && !memcmp(&dataP[1], &sData.dataPayload[SIM_MULTI_DAY_HEADER_BYTES], SIM_MULTI_DAY_LOG_BYTES);
+                dataP += 1 + SIM_MULTI_DAY_LOG_BYTES;
+            }
+            if (good) {
+                sData.stats.dataSent += days;
+            } else {
+                sData.stats.badData++;
+            }
+        } else {
+            sData.stats.dataSent++;
+        }
+        break;
+    case M_COMMAND_SEND_DEBUG_DATA:
+        // No response
+        return;
+    case M_COMMAND_GET_INCOMING_PARTIAL:
+        {
+            uint32_t offset = sim_get32(&sData.frame[1]);
+            uint32_t size = sim_get32(&sData.frame[5]);
+            uint32_t available = 0;
+            if (sData.queueCount && (offset < sData.queue[0].length)) {
+                available = sData.queue[0].length - offset;
+            }
+            if (size > available) {
+                size = available;
+            }
+            if (size > (SIM_MAX_FRAME - 13)) {
+                size = SIM_MAX_FRAME - 13;
+            }
+            sim_put32(&resp[1], size);
+            sim_put32(&resp[5], available - size);
+            if (size) {
+                memcpy(&resp[9], &sData.queue[0].data[offset], size);
+            }
+            length += 8 + size;
+        }
+        break;
+    case M_COMMAND_DELETE_INCOMING:
+        if (sData.queueCount) {
+            sData.queueCount--;
+            memmove(&sData.queue[0], &sData.queue[1], sData.queueCount * sizeof(simOtaMsg_t));
+            sData.stats.otaDeleted++;
+        }
+        break;
+    case M_COMMAND_POWER_OFF:
+        sData.modemOff = true;
+        break;
+    default:
+        break;
+    }
+    sim_modemRespond(resp, length, timeUs);
+}
+
+/**
+* \brief Frame a response and queue it for the MCU after the modem
+*        processing time.
+*
+* @param dataP the response command and data
+* @param length length of the response command and data
+* @param timeUs time the command was received
+*/
+static void sim_modemRespond(const uint8_t *dataP, uint16_t length, uint64_t timeUs) {
+    uint8_t frame[SIM_MAX_FRAME];
+    uint16_t crc = gen_crc16(dataP, length);
+    uint64_t sendUs;
+    uint16_t i;
+
+    frame[0] = 0x3E;
+    memcpy(&frame[1], dataP, length);
+    if (sim_rand() < sData.scenP->badCrcRate) {
+        crc ^= 0x0001;
+        sData.stats.badCrcs++;
+    }
+    frame[length + 1] = crc >> 8;
+    frame[length + 2] = crc & 0xFF;
+    frame[length + 3] = 0x3B;
+
+    sendUs = timeUs + ((uint64_t)sData.scenP->respDelayMs * 1000) +
+             (uint64_t)(sim_rand() * sData.scenP->jitterMs * 1000);
+    if (sData.toMcuCount && (sData.toMcuWireFreeUs > sendUs)) {
+        sendUs = sData.toMcuWireFreeUs;
+    }
+    for (i = 0; (i < (length + 4)) && (sData.toMcuCount < SIM_MAX_WIRE); i++) {
+        simWireByte_t *byteP = &sData.toMcu[(sData.toMcuHead + sData.toMcuCount) % SIM_MAX_WIRE];
+        sendUs += SIM_BYTE_US;
+        byteP->timeUs = sendUs;
+        byteP->value = frame[i];
+        sData.toMcuCount++;
+        sData.stats.rxBytes++;
+    }
+    sData.toMcuWireFreeUs = sendUs;
+}
+
+/**
+* \brief The network state reported by the modem: registering,
+*        connecting, then connected (or the error state of the
+*        scenario) at connectSec after power on.
+*
+* @param timeUs current time
+*
+* @return uint8_t the modem_state_t value
+*/
+static uint8_t sim_linkState(uint64_t timeUs) {
+    uint64_t onUs = timeUs - sData.powerOnUs;
+    uint64_t connectUs = (uint64_t)sData.scenP->connectSec * SIM_US_PER_SEC;
+    if (onUs >= connectUs) {
+        return sData.scenP->errorState ? sData.scenP->errorState : MODEM_STATE_CONNECTED;
+    }
+    return (onUs < (connectUs / 2)) ? MODEM_STATE_REGISTERING : MODEM_STATE_CONNECTING;
+}
+
+/**
+* \brief Print the results of a session or a scenario (averaged
+*        over its sessions).
+*
+* @param nameP name to print
+* @param statsP the results
+*/
+static void sim_printStats(const char *nameP, simStats_t *statsP) {
+    double n = statsP->sessions ? statsP->sessions : 1;
+    printf("%-20s session %6.1f s (max %6.1f)  modem on %6.1f s  wire tx %6.0f rx %6.0f bytes  "
+           "data %u/%u (bad %u)  ota %u deleted %u left  cmds %u  bad frames %u  ignored %u  bad crc %u  "
+           "dropped %u  overruns %u  power ups %u  comm errors %u  no link %u  hung %u  budget cuts %u  warm starts %u\n",
+           nameP, statsP->sessionUs / (n * SIM_US_PER_SEC), (double)statsP->maxSessionUs / SIM_US_PER_SEC,
+           statsP->modemOnUs / (n * SIM_US_PER_SEC), statsP->txBytes / n, statsP->rxBytes / n,
+           statsP->dataSent, statsP->sessions, statsP->badData, statsP->otaDeleted, statsP->otaLeft, statsP->commands,
+           statsP->badFrames, statsP->ignored, statsP->badCrcs, statsP->dropped, statsP->overruns,
+           statsP->powerCycles, statsP->commErrors, statsP->connectTimeouts, statsP->hung, statsP->budgetCuts,
+           statsP->warmStarts);
+}
+
+#if (MODEM_ADAPTIVE_TIMEOUT==1)
+/**
+* \brief Print the round trip times measured by modemCmd.c.
+*/
+static void sim_printRtt(void) {
+    static const modem_command_t cmds[] = { M_COMMAND_SEND_DATA, M_COMMAND_GET_INCOMING_PARTIAL };
+    static const char *namesP[] = { "send", "partial" };
+    modemCmdRttStats_t rtt;
+    uint8_t i;
+
+    printf("%-20s rtt ms (min/avg/max):", "");
+    for (i = 0; i < (sizeof(cmds) / sizeof(cmds[0])); i++) {
+        if (modemCmd_getRttStats(cmds[i], &rtt)) {
+            printf("  %s %.0f/%.0f/%.0f", namesP[i], rtt.min * 15.625, rtt.avg * 15.625, rtt.max * 15.625);
+        }
+    }
+    printf("\n");
+}
+#endif
+
+/**
+* \brief Add the results of a session to the scenario results.
+*
+* @param sumP the scenario results
+* @param statsP the session results
+*/
+static void sim_addStats(simStats_t *sumP, const simStats_t *statsP) {
+    sumP->sessions += statsP->sessions;
+    sumP->sessionUs += statsP->sessionUs;
+    if (statsP->maxSessionUs > sumP->maxSessionUs) {
+        sumP->maxSessionUs = statsP->maxSessionUs;
+    }
+    sumP->modemOnUs += statsP->modemOnUs;
+    sumP->txBytes += statsP->txBytes;
+    sumP->rxBytes += statsP->rxBytes;
+    sumP->dropped += statsP->dropped;
+    sumP->overruns += statsP->overruns;
+    sumP->commands += statsP->commands;
+    sumP->badFrames += statsP->badFrames;
+    sumP->ignored += statsP->ignored;
+    sumP->badCrcs += statsP->badCrcs;
+    sumP->dataSent += statsP->dataSent;
+    sumP->badData += statsP->badData;
+    sumP->otaReplies += statsP->otaReplies;
+    sumP->otaDeleted += statsP->otaDeleted;
+    sumP->otaLeft += statsP->otaLeft;
+    sumP->powerCycles += statsP->powerCycles;
+    sumP->commErrors += statsP->commErrors;
+    sumP->connectTimeouts += statsP->connectTimeouts;
+    sumP->hung += statsP->hung;
+    sumP->budgetCuts += statsP->budgetCuts;
+    sumP->warmStarts += statsP->warmStarts;
+}
+
+/**
+* \brief Load the OTA queue: one message per line as hex bytes.
+*
+* @param fileNameP the file
+*
+* @return uint32_t number of messages loaded (0 on error)
+*/
+static uint32_t sim_loadOta(const char *fileNameP) {
+    FILE *fileP = fopen(fileNameP, "r");
+    char line[1024];
+
+    if (!fileP) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fileP) && (sData.numOta < SIM_MAX_OTA_MSGS)) {
+        simOtaMsg_t *msgP = &sData.ota[sData.numOta];
+        char *p = line;
+        char *endP;
+        if (line[0] == '#') {
+            continue;
+        }
+        msgP->length = 0;
+        while (msgP->length < sizeof(msgP->data)) {
+            unsigned long value = strtoul(p, &endP, 16);
+            if (endP == p) {
+                break;
+            }
+            msgP->data[msgP->length++] = value;
+            p = endP;
+        }
+        if (msgP->length) {
+            sData.numOta++;
+        }
+    }
+    fclose(fileP);
+    return sData.numOta;
+}
+
+/**
+* \brief Read a 32 bit value, MSB first.
+*/
+static uint32_t sim_get32(const uint8_t *dataP) {
+    return ((uint32_t)dataP[0] << 24) | ((uint32_t)dataP[1] << 16) | ((uint32_t)dataP[2] << 8) | dataP[3];
+}
+
+/**
+* \brief Write a 32 bit value, MSB first.
+*/
+static void sim_put32(uint8_t *dataP, uint32_t value) {
+    dataP[0] = value >> 24;
+    dataP[1] = value >> 16;
+    dataP[2] = value >> 8;
+    dataP[3] = value;
+}
+
+/**
+* \brief xorshift32 random number.
+*
+* @return float in [0, 1)
+*/
+static float sim_rand(void) {
+    sData.rng ^= sData.rng << 13;
+    sData.rng ^= sData.rng >> 17;
+    sData.rng ^= sData.rng << 5;
+    return (sData.rng >> 8) / 16777216.0;
+}
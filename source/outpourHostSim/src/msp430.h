@@ -0,0 +1,16 @@
+/** 
+ * @file msp430.h
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ * 
+ * \brief Host stand-in for the TI msp430.h header.  Allows the 
+ *        firmware modules to be compiled with a host compiler
+ *        (gcc) for simulation and benchmarking.  The peripheral
+ *        registers are plain memory and the intrinsics are
+ *        no-ops.
+ */
+
+#pragma once
+
+#include "msp430g2553.h"
+#include "hostFlash.h"
@@ -0,0 +1,237 @@
+/** 
+ * @file msp430g2553.h
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ * 
+ * \brief Host stand-in for the TI msp430g2553.h device header. 
+ *        Only the registers, bits and intrinsics referenced by
+ *        the Outpour firmware modules built on the host are
+ *        defined.  The registers are defined in hostMsp430.c.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/***************************
+ * Compiler Keywords
+ **************************/
+
+#define __interrupt
+#define __no_init
+
+#define __get_SR_register()             (hostSR)
+#define _BIS_SR(x)                      (hostSR |= (x))
+#define _BIC_SR(x)                      (hostSR &= ~(x))
+#define __bic_SR_register(x)            (hostSR &= ~(x))
+#define __bis_SR_register(x)            (hostSR |= (x))
+#define __bic_SR_register_on_exit(x)    (hostSR &= ~(x))
+#define __bis_SR_register_on_exit(x)    (hostSR |= (x))
+#define __enable_interrupt()            (hostSR |= GIE)
+#define __disable_interrupt()           (hostSR &= ~GIE)
+#define __no_operation()
+#define _delay_cycles(x)
+#define __delay_cycles(x)
+#define __even_in_range(x, y)           (x)
+
+/***************************
+ * Status Register Bits
+ **************************/
+
+#define GIE                 (0x0008)
+#define CPUOFF              (0x0010)
+#define OSCOFF              (0x0020)
+#define SCG0                (0x0040)
+#define SCG1                (0x0080)
+#define LPM0_bits           (CPUOFF)
+#define LPM3_bits           (SCG1+SCG0+CPUOFF)
+#define LPM3                (hostSR |= LPM3_bits)
+
+/***************************
+ * Port Bits
+ **************************/
+
+#define BIT0                (0x0001)
+#define BIT1                (0x0002)
+#define BIT2                (0x0004)
+#define BIT3                (0x0008)
+#define BIT4                (0x0010)
+#define BIT5                (0x0020)
+#define BIT6                (0x0040)
+#define BIT7                (0x0080)
+
+/***************************
+ * Flash Controller Bits
+ **************************/
+
+#define FWKEY               (0xA500)
+#define ERASE               (0x0002)
+#define MERAS               (0x0004)
+#define WRT                 (0x0040)
+#define BLKWRT              (0x0080)
+#define BUSY                (0x0001)
+#define KEYV                (0x0002)
+#define ACCVIFG             (0x0004)
+#define WAIT                (0x0008)
+#define LOCK                (0x0010)
+#define FN1                 (0x0002)
+#define FSSEL_1             (0x0040)
+
+/***************************
+ * Watchdog Bits
+ **************************/
+
+#define WDTPW               (0x5A00)
+#define WDTHOLD             (0x0080)
+#define WDTCNTCL            (0x0008)
+#define WDTSSEL             (0x0004)
+#define WDTTMSEL            (0x0010)
+#define WDT_ARST_1000       (WDTPW+WDTCNTCL+WDTSSEL)
+
+/***************************
+ * Clock Bits
+ **************************/
+
+#define DIVA_0              (0x00)
+#define XCAP_2              (0x08)
+#define LFXT1S_0            (0x00)
+#define CALBC1_1MHZ         (0x86)
+#define CALDCO_1MHZ         (0xB6)
+
+/***************************
+ * Special Function Bits
+ **************************/
+
+#define WDTIE               (0x01)
+#define OFIFG               (0x02)
+#define NMIIFG              (0x10)
+#define UCA0RXIE            (0x01)
+#define UCA0TXIE            (0x02)
+#define UCA0RXIFG           (0x01)
+#define UCA0TXIFG           (0x02)
+#define UC0IE               IE2
+#define UC0IFG              IFG2
+
+/***************************
+ * Timer A Bits
+ **************************/
+
+#define TASSEL_1            (0x0100)
+#define TASSEL_2            (0x0200)
+#define TASSEL_3            (0x0300)
+#define ID_0                (0x0000)
+#define ID_3                (0x00C0)
+#define MC_0                (0x0000)
+#define MC_1                (0x0010)
+#define MC_2                (0x0020)
+#define TACLR               (0x0004)
+#define TAIE                (0x0002)
+#define TAIFG               (0x0001)
+#define CCIE                (0x0010)
+#define CCIFG               (0x0001)
+
+/***************************
+ * USCI Bits
+ **************************/
+
+#define UCSWRST             (0x01)
+#define UCSSEL_1            (0x40)
+#define UCSSEL_2            (0x80)
+#define UCBRS0              (0x02)
+#define UCBRS1              (0x04)
+
+/***************************
+ * ADC10 Bits
+ **************************/
+
+#define ADC10SC             (0x0001)
+#define ENC                 (0x0002)
+#define ADC10IFG            (0x0004)
+#define ADC10IE             (0x0008)
+#define ADC10ON             (0x0010)
+#define REFON               (0x0020)
+#define ADC10SHT_3          (0x1800)
+#define SREF_1              (0x2000)
+#define INCH_10             (0xA000)
+#define ADC10DIV_3          (0x0060)
+
+/***************************
+ * Watchdog Interval Bits
+ **************************/
+
+#define WDT_MDLY_32         (WDTPW+WDTTMSEL+WDTCNTCL)
+
+/***************************
+ * Interrupt Vectors
+ **************************/
+
+#define TIMER0_A1_VECTOR    (8 * 2u)
+#define TIMER0_A0_VECTOR    (9 * 2u)
+#define WDT_VECTOR          (10 * 2u)
+#define USCIAB0TX_VECTOR    (6 * 2u)
+#define USCIAB0RX_VECTOR    (7 * 2u)
+#define TIMER1_A1_VECTOR    (12 * 2u)
+#define TIMER1_A0_VECTOR    (13 * 2u)
+
+/***************************
+ * Registers
+ **************************/
+
+extern volatile uint16_t hostSR;
+extern volatile uint8_t IE1;
+extern volatile uint8_t IFG1;
+extern volatile uint8_t IE2;
+extern volatile uint8_t IFG2;
+extern volatile uint8_t DCOCTL;
+extern volatile uint8_t BCSCTL1;
+extern volatile uint8_t BCSCTL2;
+extern volatile uint8_t BCSCTL3;
+extern volatile uint16_t FCTL1;
+extern volatile uint16_t FCTL2;
+extern volatile uint16_t FCTL3;
+extern volatile uint16_t WDTCTL;
+extern volatile uint8_t P1IN;
+extern volatile uint8_t P1OUT;
+extern volatile uint8_t P1DIR;
+extern volatile uint8_t P1IFG;
+extern volatile uint8_t P1IES;
+extern volatile uint8_t P1IE;
+extern volatile uint8_t P1SEL;
+extern volatile uint8_t P1SEL2;
+extern volatile uint8_t P1REN;
+extern volatile uint8_t P2IN;
+extern volatile uint8_t P2OUT;
+extern volatile uint8_t P2DIR;
+extern volatile uint8_t P2SEL;
+extern volatile uint8_t P2SEL2;
+extern volatile uint8_t P3OUT;
+extern volatile uint8_t P3DIR;
+extern volatile uint16_t TA0CTL;
+extern volatile uint16_t TA0R;
+extern volatile uint16_t TA0CCTL0;
+extern volatile uint16_t TA0CCTL1;
+extern volatile uint16_t TA0CCTL2;
+extern volatile uint16_t TA0CCR0;
+extern volatile uint16_t TA0CCR1;
+extern volatile uint16_t TA0CCR2;
+extern volatile uint16_t TA1CTL;
+extern volatile uint16_t TA1R;
+extern volatile uint16_t TA1CCTL0;
+extern volatile uint16_t TA1CCTL1;
+extern volatile uint16_t TA1CCTL2;
+extern volatile uint16_t TA1CCR0;
+extern volatile uint16_t TA1CCR1;
+extern volatile uint16_t TA1CCR2;
+extern volatile uint8_t UCA0CTL0;
+extern volatile uint8_t UCA0CTL1;
+extern volatile uint8_t UCA0BR0;
+extern volatile uint8_t UCA0BR1;
+extern volatile uint8_t UCA0MCTL;
+extern volatile uint8_t UCA0STAT;
+extern volatile uint8_t UCA0RXBUF;
+// 16 bits wide on the host so a harness can tell if the transmit ISR
+// loaded a byte (see modemSim.c)
+extern volatile uint16_t UCA0TXBUF;
+extern volatile uint16_t ADC10CTL0;
+extern volatile uint16_t ADC10CTL1;
+extern volatile uint16_t ADC10MEM;
@@ -0,0 +1,238 @@
+/**
+ * @file otaFlashBench.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Run the bootloader firmware upgrade (msgOta.c) against
+ *        the emulated flash and report the flash wear and the
+ *        modeled programming time.  The modem manager is stubbed
+ *        and serves an upgrade message created by
+ *        outpourRomToMsg.py (text file of hex bytes).
+ */
+
+#include <stdlib.h>
+#include "outpour.h"
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def BENCH_MAX_MSG_SIZE
+ * \brief Largest upgrade message that can be loaded.
+ */
+#define BENCH_MAX_MSG_SIZE ((uint16_t)0x4000)
+
+/**
+ * \def BENCH_MAX_EXEC_LOOPS
+ * \brief Abort a run that does not complete.
+ */
+#define BENCH_MAX_EXEC_LOOPS ((uint32_t)1000000)
+
+/**
+ * \typedef benchData_t
+ * \brief Module data structure.
+ */
+typedef struct benchData_s {
+    uint8_t msg[BENCH_MAX_MSG_SIZE];    /**< the upgrade message */
+    uint16_t msgLength;                 /**< upgrade message length */
+    bool msgDeleted;                    /**< modem message was deleted */
+    bool cmdError;                      /**< report a modem error */
+    otaResponse_t otaResponse;          /**< last partial response */
+    uint8_t otaBuf[OTA_PAYLOAD_BUF_LENGTH];
+    uint32_t partialReads;              /**< GET_INCOMING_PARTIAL count */
+} benchData_t;
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+// static
+benchData_t bData;
+
+/**
+* \var hostAppLength
+* \brief Host storage for the linker value _App_Length (aliased
+*        with --defsym, see readme.txt).
+*/
+uint16_t hostAppLength = 0x3000;
+
+/*********************
+ * Module Prototypes
+ *********************/
+
+static bool bench_loadMsg(const char *fileNameP);
+static bool bench_runUpgrade(void);
+static bool bench_verifyImage(void);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Usage: otaFlashBench <msg file> [image file] [runs]
+*
+* @return int 0 if all the upgrades succeeded
+*/
+int main(int argc, char *argv[]) {
+    const char *imageP = (argc > 2) ? argv[2] : "ota_flash.img";
+    uint32_t runs = (argc > 3) ? strtoul(argv[3], NULL, 0) : 1;
+    uint32_t i;
+    hostFlashSegStats_t totals;
+
+    if ((argc < 2) || !bench_loadMsg(argv[1])) {
+        fprintf(stderr, "usage: %s <msg file> [image file] [runs]\n", argv[0]);
+        return 1;
+    }
+    if (!hostFlash_open(imageP, true)) {
+        fprintf(stderr, "could not open %s\n", imageP);
+        return 1;
+    }
+    // The bootloader flash.c writes one byte at a time
+    hostFlash_setByteMode(true);
+    hostFlash_setStrict(true);
+
+    for (i = 0; i < runs; i++) {
+        if (!bench_runUpgrade() || !bench_verifyImage()) {
+            fprintf(stderr, "upgrade %u failed\n", i);
+            hostFlash_close();
+            return 1;
+        }
+    }
+
+    hostFlash_getTotals(&totals);
+    printf("upgrades: %u  message: %u bytes  partial reads: %u\n", runs, bData.msgLength, bData.partialReads);
+    hostFlash_printStats(stdout);
+    printf("programming time per upgrade: %.1f ms (byte mode %.1f ms, %.2fx)\n",
+           totals.progTimeUs / runs / 1000.0, totals.byteModeTimeUs / runs / 1000.0,
+           totals.byteModeTimeUs / totals.progTimeUs);
+    hostFlash_close();
+    return 0;
+}
+
+/**
+* \brief Modem manager stubs used by msgOta.c
+*/
+bool modemMgr_grab(void) {
+    return true;
+}
+
+bool modemMgr_isModemUp(void) {
+    return true;
+}
+
+void modemMgr_sendModemCmdBatch(modemCmdWriteData_t *cmdWriteP) {
+    bData.cmdError = false;
+    if (cmdWriteP->statusOnly) {
+        return;
+    }
+    if (cmdWriteP->cmd == M_COMMAND_GET_INCOMING_PARTIAL) {
+        uint16_t offset = cmdWriteP->payloadOffset;
+        uint16_t length = cmdWriteP->payloadLength;
+        bData.partialReads++;
+        if (offset > bData.msgLength) {
+            offset = bData.msgLength;
+        }
+        if ((offset + length) > bData.msgLength) {
+            length = bData.msgLength - offset;
+        }
+        if (length > OTA_PAYLOAD_BUF_LENGTH) {
+            length = 0;
+        }
+        memcpy(bData.otaBuf, &bData.msg[offset], length);
+        bData.otaResponse.lengthInBytes = length;
+        bData.otaResponse.remainingInBytes = bData.msgLength - offset - length;
+    } else if (cmdWriteP->cmd == M_COMMAND_DELETE_INCOMING) {
+        bData.msgDeleted = true;
+    }
+}
+
+bool modemMgr_isModemCmdComplete(void) {
+    return true;
+}
+
+bool modemMgr_isModemCmdError(void) {
+    return bData.cmdError;
+}
+
+void modemMgr_release(void) {
+}
+
+otaResponse_t *modemMgr_getLastOtaResponse(void) {
+    return &bData.otaResponse;
+}
+
+bool modemMgr_isLinkUp(void) {
+    return true;
+}
+
+bool modemMgr_isLinkUpError(void) {
+    return false;
+}
+
+uint8_t modemMgr_getNumOtaMsgsPending(void) {
+    return bData.msgDeleted ? 0 : 1;
+}
+
+uint16_t modemMgr_getSizeOfOtaMsgsPending(void) {
+    return bData.msgDeleted ? 0 : bData.msgLength;
+}
+
+uint16_t modemLink_getModemUpTimeInSysTicks(void) {
+    return 0;
+}
+
+/***************************
+ * Module Private Functions
+ **************************/
+
+/**
+* \brief Load the upgrade message (text file of hex bytes).
+*
+* @param fileNameP message file
+*
+* @return bool true if a message was loaded
+*/
+static bool bench_loadMsg(const char *fileNameP) {
+    FILE *fP = fopen(fileNameP, "r");
+    unsigned int val;
+    if (!fP) {
+        return false;
+    }
+    bData.msgLength = 0;
+    while ((bData.msgLength < BENCH_MAX_MSG_SIZE) && (fscanf(fP, "%x", &val) == 1)) {
+        bData.msg[bData.msgLength++] = (uint8_t)val;
+    }
+    fclose(fP);
+    bData.otaResponse.buf = bData.otaBuf;
+    return bData.msgLength > 16;
+}
+
+/**
+* \brief Run one firmware upgrade through the OTA state
+*        machine.
+*
+* @return bool true if the upgrade completed successfully
+*/
+static bool bench_runUpgrade(void) {
+    uint32_t loops = 0;
+    bData.msgDeleted = false;
+    otaMsgMgr_init();
+    otaMsgMgr_getAndProcessOtaMsgs(false);
+    while (!otaMsgMgr_isOtaProcessingDone() && (loops++ < BENCH_MAX_EXEC_LOOPS)) {
+        otaMsgMgr_exec();
+    }
+    return otaMsgMgr_getFwUpdateResult() == RESULT_DONE_SUCCESS;
+}
+
+/**
+* \brief Check the section data in the flash image against the
+*        upgrade message.
+*
+* @return bool true if the image matches
+*/
+static bool bench_verifyImage(void) {
+    uint16_t addr = (bData.msg[10] << 8) | bData.msg[11];
+    uint16_t length = (bData.msg[12] << 8) | bData.msg[13];
+    return memcmp(hostFlash_addrToPtr(addr), &bData.msg[16], length) == 0;
+}
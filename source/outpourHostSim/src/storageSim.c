@@ -0,0 +1,979 @@
+/**
+ * @file storageSim.c
+ * \n Source File
+ * \n Outpour MSP430 Host Simulation
+ *
+ * \brief Run the application storage manager (storage.c) in
+ *        virtual time against the emulated flash.  The water
+ *        sensor is stubbed and returns the flow of a synthetic
+ *        or recorded usage profile.  storageMgr_exec is called
+ *        once per simulated second, as the firmware does from
+ *        the one second main loop tick.
+ *
+ * The daily logs are "transmitted" by the dataMsgMgr stub (a
+ * successful modem session: the backlog is read in multi-day
+ * messages with storageMgr_getNextMultiDayToTransmit and marked
+ * with storageMgr_markDailyLogsAsTransmitted) and decoded as the
+ * cloud would decode them.  Each decoded day is checked against
+ * the daily log storageMgr_getNextDailyLogToTransmit returns.
+ * Built without -DDATA_MSG_MULTI_DAY=1, the daily logs are
+ * decoded one per message.
+ * Red flag set/clear events are taken from the redFlag field of
+ * the transmitted daily logs.
+ *
+ * Recorded profiles are text files with one day per line and
+ * 24 hourly liter values per day (as found in the daily logs).
+ * An optional 25th value marks a day the pump was known to be
+ * broken (for example from maintenance records); without it a
+ * day with no flow is taken as broken.  Lines starting with '#'
+ * are ignored.  Each file is one unit.
+ *
+ * The red flag detector is evaluated against the broken days:
+ * an outage (consecutive broken days) is detected if the red
+ * flag is set on one of its days, the detection delay is the
+ * number of days from the start of the outage, and a red flag
+ * set on a day that is not broken is a false alarm.
+ * Build with -DRECORD_EVENT_LOG=1 to decode the event log.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "outpour.h"
+
+/***************************
+ * Module Data Definitions
+ **************************/
+
+/**
+ * \def SIM_WEEKLY_LOG_BYTES
+ * \brief sizeof(weeklyLog_t) in storage.c: 7 daily packets of
+ *        128 bytes, the two 16 bit transmit indexes and, with
+ *        MINUTE_FLOW_CAPTURE, two minute captures of 62 bytes.
+ */
+#if (MINUTE_FLOW_CAPTURE==1)
+#define SIM_WEEKLY_LOG_BYTES ((uint16_t)((7 * 128) + 4 + (2 * 62)))
+#else
+#define SIM_WEEKLY_LOG_BYTES ((uint16_t)((7 * 128) + 4))
+#endif
+
+/**
+ * \def SIM_WEEK1_LOG_ADDR
+ * \brief Flash address of .week1Data (lnk_msp430g2553.cmd).
+ */
+#define SIM_WEEK1_LOG_ADDR ((uint16_t)0xC000)
+
+/**
+ * \def SIM_WEEK2_LOG_ADDR
+ * \brief Flash address of .week2Data (lnk_msp430g2553.cmd).
+ */
+#define SIM_WEEK2_LOG_ADDR ((uint16_t)0xC400)
+
+/**
+ * \def SIM_SECONDS_IN_A_HOUR
+ * \brief For clarity in the code
+ */
+#define SIM_SECONDS_IN_A_HOUR ((uint32_t)3600)
+
+/**
+ * \def SIM_HOURS_IN_A_DAY
+ * \brief For clarity in the code
+ */
+#define SIM_HOURS_IN_A_DAY ((uint8_t)24)
+
+/**
+ * \def SIM_MAX_PROFILE_DAYS
+ * \brief Largest recorded profile that can be loaded.
+ */
+#define SIM_MAX_PROFILE_DAYS ((uint32_t)(20 * 366))
+
+/**
+ * \def SIM_DAY_BROKEN
+ * \brief Day flag: the pump was broken (ground truth).
+ */
+#define SIM_DAY_BROKEN ((uint8_t)0x01)
+
+/**
+ * \def SIM_DAY_RED_FLAG_SET
+ * \brief Day flag: a red flag was set for the day.
+ */
+#define SIM_DAY_RED_FLAG_SET ((uint8_t)0x02)
+
+/**
+ * \def SIM_PKT_*
+ * \brief Offsets in a transmitted daily log (the daily packet
+ *        without the first two bytes, see
+ *        storageMgr_getNextDailyLogToTransmit).  16 bit values
+ *        are stored MSB first (msp430Flash_write_int).
+ */
+#define SIM_PKT_DAYS_ACTIVATED   ((uint8_t)9)
+#define SIM_PKT_WEEKS            ((uint8_t)11)
+#define SIM_PKT_DAY_OF_WEEK      ((uint8_t)12)
+#define SIM_PKT_LITERS           ((uint8_t)14)
+#define SIM_PKT_COMPARED_AVERAGE ((uint8_t)98)
+#define SIM_PKT_RED_FLAG         ((uint8_t)102)
+#define SIM_PKT_INTEGRITY        ((uint8_t)103)
+
+/**
+ * \def SIM_MSG_HEADER_BYTES
+ * \brief Size of the message header (storageMgr_prepareMsgHeader)
+ *        at the start of an event log message.
+ */
+#define SIM_MSG_HEADER_BYTES ((uint8_t)14)
+
+/**
+ * \def SIM_WEEKLY_LOG_INDEX_OFFSET
+ * \brief Offset of the transmit index (followed by the ready
+ *        index) in a weekly log.
+ */
+#define SIM_WEEKLY_LOG_INDEX_OFFSET ((uint16_t)(7 * 128))
+
+/**
+ * \def SIM_PACKET_CRC_BYTES
+ * \brief Daily log data bytes covered by the daily packet CRC.
+ */
+#define SIM_PACKET_CRC_BYTES ((uint8_t)89)
+
+/**
+ * \def SIM_MULTI_DAY_*
+ * \brief Layout of a multi-day message (MSG_TYPE_MULTI_DAY): the 
+ *        shared header (the transmitted daily log header of the
+ *        oldest day), then per day the day offset and the daily
+ *        log data up to the integrity byte.
+ */
+#define SIM_MULTI_DAY_HEADER_BYTES ((uint8_t)14)
+#define SIM_MULTI_DAY_LOG_BYTES    ((uint8_t)(SIM_PACKET_CRC_BYTES + 1))
+#define SIM_MULTI_DAY_MAX_DAYS     ((uint8_t)7)
+#define SIM_MULTI_DAY_MAX_BYTES    ((uint16_t)(SIM_MULTI_DAY_HEADER_BYTES + (SIM_MULTI_DAY_MAX_DAYS * (1 + SIM_MULTI_DAY_LOG_BYTES))))
+
+/**
+ * \def SIM_SEND_DATA_FRAME_BYTES
+ * \brief Bytes a send data frame adds to the payload (start, 
+ *        command, size[4], payload start, message type, crc[2],
+ *        end).
+ */
+#define SIM_SEND_DATA_FRAME_BYTES ((uint8_t)11)
+
+/**
+ * \def SIM_DAILY_LOG_BYTES
+ * \brief Size of a daily log message payload (MSG_TYPE_DAILY).
+ */
+#define SIM_DAILY_LOG_BYTES ((uint8_t)126)
+
+/**
+ * \typedef simUnitStats_t
+ * \brief Results of one simulated unit.
+ */
+typedef struct simUnitStats_s {
+    uint32_t days;              /**< days simulated */
+    int32_t activationDay;      /**< day the unit activated (-1 if never) */
+    uint32_t sessions;          /**< daily log send requests */
+    uint32_t packets;           /**< daily logs transmitted */
+    uint32_t multiDayMsgs;      /**< multi-day messages transmitted */
+    uint32_t multiDayBytes;     /**< send data frame bytes of the multi-day messages */
+    uint32_t checkins;          /**< monthly check-ins sent */
+    uint32_t minuteCaptures;    /**< minute flow captures sent */
+    uint32_t corruptedPackets;  /**< daily logs corrupted by -x before transmit */
+    uint32_t flaggedPackets;    /**< daily logs received with the integrity flag */
+    uint32_t events;            /**< event log records sent */
+    uint32_t redFlagEvents;     /**< red flag set events */
+    uint32_t redFlagDays;       /**< transmitted days with the red flag set */
+    uint32_t brokenDays;        /**< days the pump was broken */
+    uint32_t outages;           /**< outages (consecutive broken days) */
+    uint32_t detected;          /**< outages with a red flag */
+    uint32_t delaySum;          /**< sum of the detection delays in days */
+    uint32_t falseAlarms;       /**< red flags set on a day that was not broken */
+} simUnitStats_t;
+
+/**
+ * \typedef simData_t
+ * \brief Module data structure.
+ */
+typedef struct simData_s {
+    uint16_t flowML;            /**< flow returned by the water sensor stub */
+    uint32_t day;               /**< current simulated day */
+    uint32_t secondsSinceBoot;  /**< getSecondsSinceBoot stub */
+    uint32_t unit;              /**< current unit */
+    bool quiet;                 /**< only print the summary */
+    bool prevRedFlag;           /**< red flag of the last transmitted daily log */
+    uint8_t *dayFlagsP;         /**< SIM_DAY_* flags per day of the unit */
+    uint32_t rng;               /**< synthetic profile random state */
+    float corruptRate;          /**< chance to corrupt a pending daily log (-x) */
+    float missRate;             /**< chance a modem session fails (-m) */
+    uint8_t sharedBuf[2 + 128]; /**< modemMgr_getSharedBuffer stub */
+    timePacket_t binTime;       /**< getBinTime stub */
+    simUnitStats_t unitStats;   /**< current unit results */
+    simUnitStats_t fleetStats;  /**< sum over all units */
+    uint16_t fleetActivated;    /**< units that activated */
+    uint32_t activationDaySum;  /**< sum of the activation days */
+    float *profileP;            /**< recorded profile (liters per hour) */
+} simData_t;
+
+/****************************
+ * Module Data Declarations
+ ***************************/
+
+/**
+* \var week1Log, week2Log
+* \brief The weekly logs of storage.c (weeklyLog_t is private to
+*        storage.c).
+*/
+extern const struct weeklyLog_s week1Log;
+extern const struct weeklyLog_s week2Log;
+
+/**
+* \var hourlyWeight
+* \brief Share of the daily liters drawn in each hour for the
+*        synthetic profile (morning and evening peaks).
+*/
+static const float hourlyWeight[SIM_HOURS_IN_A_DAY] = {
+    0.000, 0.000, 0.000, 0.000, 0.000, 0.010,
+    0.060, 0.120, 0.110, 0.080, 0.060, 0.050,
+    0.050, 0.050, 0.050, 0.060, 0.090, 0.100,
+    0.060, 0.030, 0.010, 0.000, 0.000, 0.000,
+};
+
+/**
+* \var weekdayFactor
+* \brief Synthetic usage by day of the week.
+*/
+static const float weekdayFactor[7] = {
+    1.00, 1.05, 1.00, 1.00, 1.10, 0.85, 0.70,
+};
+
+// static
+simData_t sData;
+
+/*********************
+ * Module Prototypes
+ *********************/
+
+static void sim_runDay(const float *litersPerHourP);
+static void sim_startUnit(uint32_t unit);
+static void sim_endUnit(void);
+static void sim_printUnit(const char *nameP, simUnitStats_t *statsP, bool fleet);
+static void sim_decodeDailyLog(uint8_t *dataP);
+#if (DATA_MSG_MULTI_DAY==1)
+static void sim_decodeMultiDay(uint8_t *msgP, uint16_t length, uint8_t **refPP, uint8_t numRef);
+#endif
+static uint32_t sim_loadProfile(const char *fileNameP);
+static void sim_evaluateUnit(void);
+static void sim_syntheticDay(float *litersPerHourP, float baseLiters, float flowFactor);
+static float sim_rand(void);
+static void sim_corruptPendingDailyLogs(void);
+
+/***************************
+ * Module Public Functions
+ **************************/
+
+/**
+* \brief Usage: storageSim [-d days] [-u units] [-l liters]
+*        [-f failures/year] [-s seed] [-c mode,hours,scale]
+*        [-x corrupt rate] [-m miss rate] [-q] [profile files]
+*        Without profile files, a synthetic fleet is simulated.
+*        Half of the breakdowns are a full outage (no flow), the
+*        others a partial one (20% to 70% of the usual flow).
+*        -c arms the minute flow capture as
+*        OTA_OPCODE_MINUTE_CAPTURE does (mode 1 daily, 2 while
+*        red flagged; hours is a bit mask of the storage hours,
+*        MINUTE_FLOW_CAPTURE builds only).  -x leaves one bit of
+*        a pending daily log unprogrammed with the given chance
+*        per session, to check the daily packet CRC
+*        (DAILY_PACKET_CRC builds only).  -m fails a
+*        modem session with the given chance (nothing is sent,
+*        the backlog grows into multi-day messages).
+*
+* @return int 0 if the simulation ran
+*/
+int main(int argc, char *argv[]) {
+    uint32_t days = 10 * 365;
+    uint32_t units = 1;
+    float baseLiters = 1500;
+    float failuresPerYear = 1;
+    uint32_t numFiles = 0;
+    uint32_t totalDays = 0;
+    float litersPerHour[SIM_HOURS_IN_A_DAY];
+#if (MINUTE_FLOW_CAPTURE==1)
+    uint8_t minuteCaptureConfig[5];
+    bool setMinuteCaptureConfig = false;
+#endif
+    clock_t startClock;
+    double wallSec;
+    int i;
+
+    sData.rng = 1;
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            sData.quiet = true;
+        } else if ((argv[i][0] == '-') && ((i + 1) < argc)) {
+            switch (argv[i][1]) {
+            case 'd': days = strtoul(argv[++i], NULL, 0); break;
+            case 'u': units = strtoul(argv[++i], NULL, 0); break;
+            case 'l': baseLiters = atof(argv[++i]); break;
+            case 'f': failuresPerYear = atof(argv[++i]); break;
+            case 's': sData.rng = strtoul(argv[++i], NULL, 0) | 1; break;
+#if (DAILY_PACKET_CRC==1)
+            case 'x': sData.corruptRate = atof(argv[++i]); break;
+#endif
+            case 'm': sData.missRate = atof(argv[++i]); break;
+#if (MINUTE_FLOW_CAPTURE==1)
+            case 'c': {
+                unsigned int mode, hours, scale;
+                if (sscanf(argv[++i], "%u,%x,%u", &mode, &hours, &scale) != 3) {
+                    fprintf(stderr, "-c needs mode,hours,scale\n");
+                    return 1;
+                }
+                minuteCaptureConfig[0] = mode;
+                minuteCaptureConfig[1] = hours;
+                minuteCaptureConfig[2] = hours >> 8;
+                minuteCaptureConfig[3] = hours >> 16;
+                minuteCaptureConfig[4] = scale;
+                setMinuteCaptureConfig = true;
+                break;
+            }
+#endif
+            default:
+                fprintf(stderr, "usage: %s [-d days] [-u units] [-l liters] [-f failures/year] [-s seed] [-c mode,hours,scale] [-x corrupt rate] [-m miss rate] [-q] [profile files]\n", argv[0]);
+                return 1;
+            }
+        } else {
+            argv[++numFiles] = argv[i];
+        }
+    }
+
+    sData.dayFlagsP = calloc(((numFiles || (days > SIM_MAX_PROFILE_DAYS)) ? SIM_MAX_PROFILE_DAYS : days) + 1, 1);
+    if (!numFiles && (days > SIM_MAX_PROFILE_DAYS)) {
+        days = SIM_MAX_PROFILE_DAYS;
+    }
+    if (!hostFlash_open(NULL, true)) {
+        fprintf(stderr, "could not map the flash image\n");
+        return 1;
+    }
+    if (((const uint8_t *)&week2Log - (const uint8_t *)&week1Log < SIM_WEEKLY_LOG_BYTES) &&
+        ((const uint8_t *)&week1Log - (const uint8_t *)&week2Log < SIM_WEEKLY_LOG_BYTES)) {
+        fprintf(stderr, "weekly logs overlap, check SIM_WEEKLY_LOG_BYTES\n");
+        return 1;
+    }
+    hostFlash_mapRegion((void *)&week1Log, SIM_WEEK1_LOG_ADDR, SIM_WEEKLY_LOG_BYTES);
+    hostFlash_mapRegion((void *)&week2Log, SIM_WEEK2_LOG_ADDR, SIM_WEEKLY_LOG_BYTES);
+    hostFlash_setStrict(true);
+#if (MINUTE_FLOW_CAPTURE==1)
+    if (setMinuteCaptureConfig && !storageMgr_setMinuteCaptureConfig(minuteCaptureConfig)) {
+        fprintf(stderr, "minute capture configuration rejected\n");
+        return 1;
+    }
+#endif
+
+    startClock = clock();
+    if (numFiles) {
+        // One unit per recorded profile
+        for (i = 1; i <= (int)numFiles; i++) {
+            uint32_t d;
+            uint32_t profileDays = sim_loadProfile(argv[i]);
+            if (!profileDays) {
+                fprintf(stderr, "could not load %s\n", argv[i]);
+                return 1;
+            }
+            sim_startUnit(i - 1);
+            for (d = 0; d < profileDays; d++) {
+                if (sData.dayFlagsP[d] & SIM_DAY_BROKEN) {
+                    sData.unitStats.brokenDays++;
+                }
+                sim_runDay(&sData.profileP[d * SIM_HOURS_IN_A_DAY]);
+            }
+            sim_endUnit();
+            if (!sData.quiet) {
+                sim_printUnit(argv[i], &sData.unitStats, false);
+            }
+        }
+        units = numFiles;
+    } else {
+        // Synthetic fleet: each unit has its own base usage and random
+        // breakdowns lasting 1 to 60 days.
+        uint32_t u;
+        for (u = 0; u < units; u++) {
+            float unitLiters = baseLiters * (0.5 + sim_rand());
+            uint32_t brokenDaysLeft = 0;
+            float flowFactor = 1;
+            uint32_t d;
+            sim_startUnit(u);
+            for (d = 0; d < days; d++) {
+                if (!brokenDaysLeft && (sim_rand() < (failuresPerYear / 365))) {
+                    brokenDaysLeft = 1 + (uint32_t)(sim_rand() * 60);
+                    flowFactor = (sim_rand() < 0.5) ? 0 : (0.2 + (0.5 * sim_rand()));
+                    if (!sData.quiet) {
+                        printf("unit %u day %u: pump broken for %u days (%.0f%% flow)\n",
+                               u, d, brokenDaysLeft, flowFactor * 100);
+                    }
+                }
+                sim_syntheticDay(litersPerHour, unitLiters, brokenDaysLeft ? flowFactor : 1);
+                if (brokenDaysLeft) {
+                    brokenDaysLeft--;
+                    sData.dayFlagsP[d] |= SIM_DAY_BROKEN;
+                    sData.unitStats.brokenDays++;
+                }
+                sim_runDay(litersPerHour);
+            }
+            sim_endUnit();
+            if (!sData.quiet) {
+                char name[32];
+                snprintf(name, sizeof(name), "unit %u", u);
+                sim_printUnit(name, &sData.unitStats, false);
+            }
+        }
+    }
+    wallSec = (double)(clock() - startClock) / CLOCKS_PER_SEC;
+    totalDays = sData.fleetStats.days;
+
+    printf("\nfleet: %u units, %u activated, %.1f unit-years simulated in %.2f s (%.1f years/s)\n",
+           units, sData.fleetActivated, totalDays / 365.0, wallSec,
+           (wallSec > 0) ? (totalDays / 365.0) / wallSec : 0.0);
+    sim_printUnit("fleet", &sData.fleetStats, true);
+    printf("fleet: mean activation day %.1f\n",
+           sData.fleetActivated ? (double)sData.activationDaySum / sData.fleetActivated : 0.0);
+    printf("red flag detector: outages %u detected %.1f%% "
+           "mean delay %.2f days, false alarms %u (%.2f per unit-year)\n",
+           sData.fleetStats.outages,
+           sData.fleetStats.outages ? (100.0 * sData.fleetStats.detected) / sData.fleetStats.outages : 0.0,
+           sData.fleetStats.detected ? (double)sData.fleetStats.delaySum / sData.fleetStats.detected : 0.0,
+           sData.fleetStats.falseAlarms, totalDays ? (365.0 * sData.fleetStats.falseAlarms) / totalDays : 0.0);
+    printf("\nflash (all units):\n");
+    hostFlash_printStats(stdout);
+    hostFlash_close();
+    free(sData.profileP);
+    free(sData.dayFlagsP);
+    return 0;
+}
+
+/**
+* \brief Water sensor stubs used by storage.c
+*/
+uint16_t waterSense_getLastMeasFlowRateInML(void) {
+    return sData.flowML;
+}
+
+void waterSense_clearStats(void) {
+}
+
+uint16_t waterSense_getPadStatsMax(padId_t padId) {
+    return 0;
+}
+
+uint16_t waterSense_padStatsMin(padId_t padId) {
+    return 0;
+}
+
+uint16_t waterSense_getPadStatsSubmerged(padId_t padId) {
+    return 0;
+}
+
+uint16_t waterSense_getPadStatsUnknowns(void) {
+    return 0;
+}
+
+/**
+* \brief Data message manager stubs.  A daily log send is a
+*        successful modem session that drains the backlog (or,
+*        with -m, a failed session that sends nothing).
+*/
+bool dataMsgMgr_sendDailyLogs(void) {
+    uint16_t sessionMask = 0;
+#if (MINUTE_FLOW_CAPTURE==1)
+    uint8_t captureMask = 0;
+#endif
+#if (RECORD_EVENT_LOG==1)
+    uint8_t eventCount = 0;
+#endif
+#if (DATA_MSG_MULTI_DAY==1)
+    uint16_t refMask = 0;
+    uint8_t *refP[2 * 7];
+    uint8_t numRef = 0;
+    uint8_t numDays;
+#endif
+#if (DATA_MSG_MULTI_DAY==1) || (RECORD_EVENT_LOG==1)
+    uint16_t length;
+#endif
+    uint8_t *dataP;
+    sData.unitStats.sessions++;
+    if ((sData.missRate > 0) && (sim_rand() < sData.missRate)) {
+        return true;
+    }
+    if (sData.corruptRate > 0) {
+        sim_corruptPendingDailyLogs();
+    }
+#if (DATA_MSG_MULTI_DAY==1)
+    // The daily logs as they would be sent one per message
+    while (storageMgr_getNextDailyLogToTransmit(&dataP, &refMask)) {
+        refP[numRef++] = dataP;
+    }
+    numDays = 0;
+    while ((length = storageMgr_getNextMultiDayToTransmit(&sessionMask, SIM_MULTI_DAY_MAX_DAYS, &numDays))) {
+        // Read the payload as the modem command module does
+        uint8_t msg[SIM_MULTI_DAY_MAX_BYTES];
+        uint16_t msgLength = 0;
+        uint16_t segLength;
+        uint8_t segment = 0;
+        while ((segLength = storageMgr_getMultiDaySegment(segment++, &dataP))) {
+            if ((msgLength + segLength) > length) {
+                fprintf(stderr, "unit %u day %u: multi-day segments longer than the message\n", sData.unit, sData.day);
+                exit(1);
+            }
+            memcpy(&msg[msgLength], dataP, segLength);
+            msgLength += segLength;
+        }
+        if (msgLength != length) {
+            fprintf(stderr, "unit %u day %u: multi-day message %u bytes, segments %u\n", sData.unit, sData.day, length, msgLength);
+            exit(1);
+        }
+        sData.unitStats.multiDayMsgs++;
+        sData.unitStats.multiDayBytes += length + SIM_SEND_DATA_FRAME_BYTES;
+        sim_decodeMultiDay(msg, length, refP, numRef);
+        memmove(refP, &refP[numDays], (numRef - numDays) * sizeof(refP[0]));
+        numRef -= numDays;
+    }
+    if (numRef || (refMask != sessionMask)) {
+        fprintf(stderr, "unit %u day %u: multi-day messages missed %u daily logs\n", sData.unit, sData.day, numRef);
+        exit(1);
+    }
+#else
+    while (storageMgr_getNextDailyLogToTransmit(&dataP, &sessionMask)) {
+        sim_decodeDailyLog(dataP);
+    }
+#endif
+#if (MINUTE_FLOW_CAPTURE==1)
+    while (storageMgr_getNextMinuteCaptureToTransmit(&dataP, &captureMask)) {
+        sData.unitStats.minuteCaptures++;
+        if (!sData.quiet) {
+            printf("unit %u day %u: minute capture day %u hour %u week %u, first minutes %u %u %u mL/%u\n",
+                   sData.unit, sData.day, dataP[0] / 24, dataP[0] % 24, (dataP[1] >> 4) & 7,
+                   dataP[2], dataP[3], dataP[4], 1 << (dataP[1] & 0xF));
+        }
+    }
+#endif
+#if (RECORD_EVENT_LOG==1)
+    while ((length = storageMgr_getNextEventLogToTransmit(&dataP, &eventCount))) {
+        // Boot stamp: the current boot number and time since boot
+        uint8_t boot = dataP[SIM_MSG_HEADER_BYTES];
+        uint16_t now = (dataP[SIM_MSG_HEADER_BYTES + 1] << 8) | dataP[SIM_MSG_HEADER_BYTES + 2];
+        uint16_t i;
+        for (i = SIM_MSG_HEADER_BYTES + 3; i < length; i += 4) {
+            uint16_t time = (dataP[i + 2] << 8) | dataP[i + 3];
+            sData.unitStats.events++;
+            if (!sData.quiet) {
+                if ((dataP[i] & 0x70) == boot) {
+                    printf("unit %u day %u: event 0x%03x payload %u age %u min\n", sData.unit, sData.day,
+                           0x100 + (dataP[i] & 0x0F), dataP[i + 1], ((uint16_t)(now - time) * 64) / 60);
+                } else {
+                    printf("unit %u day %u: event 0x%03x payload %u boot %u at %u min\n", sData.unit, sData.day,
+                           0x100 + (dataP[i] & 0x0F), dataP[i + 1], dataP[i] >> 4, (time * 64) / 60);
+                }
+            }
+        }
+    }
+#endif
+    storageMgr_markDailyLogsAsTransmitted(sessionMask);
+#if (MINUTE_FLOW_CAPTURE==1)
+    storageMgr_markMinuteCapturesAsTransmitted(captureMask);
+#endif
+#if (RECORD_EVENT_LOG==1)
+    storageMgr_markEventLogAsTransmitted(eventCount);
+#endif
+    return true;
+}
+
+bool dataMsgMgr_sendCheckin(void) {
+    sData.unitStats.checkins++;
+    return true;
+}
+
+void dbgMsgMgr_sendDebugMsg(MessageType_t msgId, uint8_t *dataP, uint16_t lengthInBytes) {
+}
+
+uint8_t* modemMgr_getSharedBuffer(void) {
+    return &sData.sharedBuf[2];
+}
+
+/**
+* \brief Time stubs.  The storage alignment is not simulated,
+*        the date in the daily log header is the simulated day
+*        (day 0 is Jan 1 2000, months are 30 days).
+*/
+timePacket_t* getBinTime(void) {
+    sData.binTime.second = 0;
+    sData.binTime.minute = 0;
+    sData.binTime.hour24 = 0;
+    sData.binTime.day = 1 + (sData.day % 30);
+    sData.binTime.month = 1 + ((sData.day / 30) % 12);
+    sData.binTime.year = (sData.day / 360) % 100;
+    return &sData.binTime;
+}
+
+timePacket_t* getBcdTime(void) {
+    return getBinTime();
+}
+
+char get24Hour(void) {
+    return 0;
+}
+
+uint32_t getSecondsSinceBoot(void) {
+    return sData.secondsSinceBoot;
+}
+
+uint8_t bcd_to_char(uint8_t bcdValue) {
+    return ((bcdValue >> 4) * 10) + (bcdValue & 0xF);
+}
+
+void sysError(void) {
+    fprintf(stderr, "sysError: unit %u day %u\n", sData.unit, sData.day);
+    exit(1);
+}
+
+/***************************
+ * Module Private Functions
+ **************************/
+
+/**
+* \brief Run one day of virtual time: call storageMgr_exec once
+*        per second with the flow of the hour spread evenly
+*        over the seconds of the hour.
+*
+* @param litersPerHourP the 24 hourly liter values of the day
+*/
+static void sim_runDay(const float *litersPerHourP) {
+    uint8_t h;
+    uint32_t s;
+    for (h = 0; h < SIM_HOURS_IN_A_DAY; h++) {
+        uint32_t hourML = (uint32_t)(litersPerHourP[h] * 1000);
+        uint16_t baseML = hourML / SIM_SECONDS_IN_A_HOUR;
+        uint32_t extraSecs = hourML % SIM_SECONDS_IN_A_HOUR;
+        for (s = 0; s < SIM_SECONDS_IN_A_HOUR; s++) {
+            sData.flowML = baseML + ((s < extraSecs) ? 1 : 0);
+            storageMgr_exec();
+            sData.secondsSinceBoot++;
+        }
+    }
+    if ((sData.unitStats.activationDay < 0) && storageMgr_isUnitActivated()) {
+        sData.unitStats.activationDay = sData.day;
+        if (!sData.quiet) {
+            printf("unit %u day %u: activated\n", sData.unit, sData.day);
+        }
+    }
+    sData.day++;
+    sData.unitStats.days++;
+}
+
+/**
+* \brief Start a unit: erase its flash and initialize the
+*        storage manager (as at power up).
+*
+* @param unit the unit number
+*/
+static void sim_startUnit(uint32_t unit) {
+    memset(&sData.unitStats, 0, sizeof(simUnitStats_t));
+    sData.unitStats.activationDay = -1;
+    sData.unit = unit;
+    sData.day = 0;
+    sData.prevRedFlag = false;
+    sData.secondsSinceBoot = 0;
+    storageMgr_init();
+}
+
+/**
+* \brief Add the unit results to the fleet results.
+*/
+static void sim_endUnit(void) {
+    simUnitStats_t *uP = &sData.unitStats;
+    simUnitStats_t *fP = &sData.fleetStats;
+    sim_evaluateUnit();
+    fP->days += uP->days;
+    fP->sessions += uP->sessions;
+    fP->packets += uP->packets;
+    fP->multiDayMsgs += uP->multiDayMsgs;
+    fP->multiDayBytes += uP->multiDayBytes;
+    fP->checkins += uP->checkins;
+    fP->minuteCaptures += uP->minuteCaptures;
+    fP->corruptedPackets += uP->corruptedPackets;
+    fP->flaggedPackets += uP->flaggedPackets;
+    fP->events += uP->events;
+    fP->redFlagEvents += uP->redFlagEvents;
+    fP->redFlagDays += uP->redFlagDays;
+    fP->brokenDays += uP->brokenDays;
+    fP->outages += uP->outages;
+    fP->detected += uP->detected;
+    fP->delaySum += uP->delaySum;
+    fP->falseAlarms += uP->falseAlarms;
+    if (uP->activationDay >= 0) {
+        sData.fleetActivated++;
+        sData.activationDaySum += uP->activationDay;
+    }
+    memset(sData.dayFlagsP, 0, uP->days);
+}
+
+/**
+* \brief Evaluate the red flags of the unit against the broken 
+*        days.
+*/
+static void sim_evaluateUnit(void) {
+    simUnitStats_t *uP = &sData.unitStats;
+    uint32_t d = 0;
+    while (d < uP->days) {
+        if (sData.dayFlagsP[d] & SIM_DAY_BROKEN) {
+            // An outage: find the first red flag in it
+            uint32_t start = d;
+            bool detected = false;
+            uP->outages++;
+            while ((d < uP->days) && (sData.dayFlagsP[d] & SIM_DAY_BROKEN)) {
+                if (!detected && (sData.dayFlagsP[d] & SIM_DAY_RED_FLAG_SET)) {
+                    detected = true;
+                    uP->detected++;
+                    uP->delaySum += d - start;
+                }
+                d++;
+            }
+        } else {
+            if (sData.dayFlagsP[d] & SIM_DAY_RED_FLAG_SET) {
+                uP->falseAlarms++;
+            }
+            d++;
+        }
+    }
+}
+
+/**
+* \brief Print the results of a unit (or the fleet).
+*
+* @param nameP unit name
+* @param statsP results
+* @param fleet true for the fleet sums (no per unit days)
+*/
+static void sim_printUnit(const char *nameP, simUnitStats_t *statsP, bool fleet) {
+    printf("%s: days %u sessions %u daily packets %u (corrupted %u flagged %u) multi-day msgs %u bytes %u (%u as daily msgs) "
+           "checkins %u minute captures %u events %u "
+           "red flags %u red flag days %u broken days %u outages %u detected %u false alarms %u",
+           nameP, statsP->days, statsP->sessions, statsP->packets,
+           statsP->corruptedPackets, statsP->flaggedPackets, statsP->multiDayMsgs, statsP->multiDayBytes,
+           statsP->packets * (SIM_DAILY_LOG_BYTES + SIM_SEND_DATA_FRAME_BYTES),
+           statsP->checkins, statsP->minuteCaptures, statsP->events,
+           statsP->redFlagEvents, statsP->redFlagDays, statsP->brokenDays,
+           statsP->outages, statsP->detected, statsP->falseAlarms);
+    if (!fleet) {
+        printf(" activation day %d", statsP->activationDay);
+    }
+    printf("\n");
+}
+
+#if (DATA_MSG_MULTI_DAY==1)
+/**
+* \brief Decode a multi-day message as the cloud does: rebuild 
+*        the header of each day from the shared header and the
+*        day offset, check the day against the daily log sent one
+*        per message (all but the GMT time, which the cloud takes
+*        as one day per offset) and decode it.
+*
+* @param msgP the multi-day message
+* @param length its length
+* @param refPP the daily logs as sent one per message, oldest first
+* @param numRef number of daily logs in refPP
+*/
+static void sim_decodeMultiDay(uint8_t *msgP, uint16_t length, uint8_t **refPP, uint8_t numRef) {
+    uint8_t day[SIM_DAILY_LOG_BYTES];
+    uint8_t *headerP = msgP;
+    uint16_t firstDays = (headerP[SIM_PKT_DAYS_ACTIVATED] << 8) | headerP[SIM_PKT_DAYS_ACTIVATED + 1];
+    uint16_t offset = SIM_MULTI_DAY_HEADER_BYTES;
+    uint8_t n = 0;
+
+    if (((length - SIM_MULTI_DAY_HEADER_BYTES) % (1 + SIM_MULTI_DAY_LOG_BYTES)) != 0) {
+        fprintf(stderr, "unit %u day %u: bad multi-day message length %u\n", sData.unit, sData.day, length);
+        exit(1);
+    }
+    for (; offset < length; offset += 1 + SIM_MULTI_DAY_LOG_BYTES, n++) {
+        uint8_t dayOffset = msgP[offset];
+        uint32_t dayIndex = headerP[SIM_PKT_DAY_OF_WEEK] + dayOffset;
+        uint16_t days = firstDays ? (firstDays + dayOffset) : 0;
+
+        memset(day, 0, sizeof(day));
+        memcpy(day, headerP, SIM_MULTI_DAY_HEADER_BYTES);
+        day[SIM_PKT_DAYS_ACTIVATED] = days >> 8;
+        day[SIM_PKT_DAYS_ACTIVATED + 1] = days & 0xFF;
+        day[SIM_PKT_WEEKS] = headerP[SIM_PKT_WEEKS] + (dayIndex / 7);
+        day[SIM_PKT_DAY_OF_WEEK] = dayIndex % 7;
+        memcpy(&day[SIM_PKT_LITERS], &msgP[offset + 1], SIM_MULTI_DAY_LOG_BYTES);
+
+        // Product ID, firmware version, days activated, weeks, day of
+        // the week and the daily log data up to the integrity byte
+        if ((n >= numRef) ||
+            (day[0] != refPP[n][0]) ||
+            memcmp(&day[7], &refPP[n][7], SIM_PKT_LITERS + SIM_MULTI_DAY_LOG_BYTES - 7)) {
+            fprintf(stderr, "unit %u day %u: multi-day message day %u does not match its daily log\n", sData.unit, sData.day, n);
+            exit(1);
+        }
+        sim_decodeDailyLog(day);
+    }
+}
+#endif
+
+/**
+* \brief Decode a transmitted daily log and report red flag
+*        changes.
+*
+* @param dataP the daily log as transmitted
+*/
+static void sim_decodeDailyLog(uint8_t *dataP) {
+    uint8_t weeks = dataP[SIM_PKT_WEEKS];
+    uint32_t curWeek = sData.day / 7;
+    // Unwrap the 8 bit week counter of the header
+    uint32_t logDay = ((curWeek - ((uint8_t)(curWeek - weeks))) * 7) + dataP[SIM_PKT_DAY_OF_WEEK];
+    bool redFlag = dataP[SIM_PKT_RED_FLAG] ? true : false;
+    uint16_t compared = (dataP[SIM_PKT_COMPARED_AVERAGE] << 8) | dataP[SIM_PKT_COMPARED_AVERAGE + 1];
+    uint16_t liters = 0;
+    uint8_t h;
+
+    for (h = 0; h < SIM_HOURS_IN_A_DAY; h++) {
+        uint16_t val = (dataP[SIM_PKT_LITERS + (2 * h)] << 8) | dataP[SIM_PKT_LITERS + (2 * h) + 1];
+        liters += val >> 5;
+    }
+
+    sData.unitStats.packets++;
+    if (!dataP[SIM_PKT_INTEGRITY]) {
+        sData.unitStats.flaggedPackets++;
+        if (liters) {
+            fprintf(stderr, "unit %u day %u: flagged daily log with data\n", sData.unit, logDay);
+            exit(1);
+        }
+    }
+    if (redFlag) {
+        sData.unitStats.redFlagDays++;
+    }
+    if (redFlag != sData.prevRedFlag) {
+        if (redFlag) {
+            sData.unitStats.redFlagEvents++;
+            if (logDay < SIM_MAX_PROFILE_DAYS) {
+                sData.dayFlagsP[logDay] |= SIM_DAY_RED_FLAG_SET;
+            }
+        }
+        if (!sData.quiet) {
+            printf("unit %u day %u: red flag %s (liters %u threshold %u days activated %u)\n",
+                   sData.unit, logDay, redFlag ? "SET" : "CLEARED", liters, compared,
+                   (dataP[SIM_PKT_DAYS_ACTIVATED] << 8) | dataP[SIM_PKT_DAYS_ACTIVATED + 1]);
+        }
+        sData.prevRedFlag = redFlag;
+    }
+}
+
+/**
+* \brief Leave one bit of the data of pending daily logs (ready 
+*        and not transmitted) unprogrammed, as a write that was
+*        cut short would, with the -x chance.  The image is
+*        changed directly (the emulated flash can not set
+*        bits).
+*/
+static void sim_corruptPendingDailyLogs(void) {
+    uint8_t *logP[2] = { (uint8_t *)&week1Log, (uint8_t *)&week2Log };
+    uint16_t logAddr[2] = { SIM_WEEK1_LOG_ADDR, SIM_WEEK2_LOG_ADDR };
+    uint8_t w;
+    uint8_t d;
+    for (w = 0; w < 2; w++) {
+        uint16_t transmitIndex;
+        uint16_t readyIndex;
+        memcpy(&transmitIndex, &logP[w][SIM_WEEKLY_LOG_INDEX_OFFSET], sizeof(uint16_t));
+        memcpy(&readyIndex, &logP[w][SIM_WEEKLY_LOG_INDEX_OFFSET + 2], sizeof(uint16_t));
+        for (d = 0; d < 7; d++) {
+            if (!(readyIndex & (1 << d)) && (transmitIndex & (1 << d)) && (sim_rand() < sData.corruptRate)) {
+                uint16_t offset = (d * 128) + 16 + (uint16_t)(sim_rand() * SIM_PACKET_CRC_BYTES);
+                uint8_t bit = 1 << (uint8_t)(sim_rand() * 8);
+                if (logP[w][offset] != 0xFF) {
+                    // Set a programmed (zero) bit back to one
+                    while (logP[w][offset] & bit) {
+                        bit = (bit << 1) | (bit >> 7);
+                    }
+                    logP[w][offset] |= bit;
+                    *hostFlash_addrToPtr(logAddr[w] + offset) = logP[w][offset];
+                    sData.unitStats.corruptedPackets++;
+                }
+            }
+        }
+    }
+}
+
+/**
+* \brief Load a recorded profile.
+*
+* @param fileNameP profile file
+*
+* @return uint32_t number of days loaded
+*/
+static uint32_t sim_loadProfile(const char *fileNameP) {
+    FILE *fP = fopen(fileNameP, "r");
+    char line[512];
+    uint32_t days = 0;
+    if (!fP) {
+        return 0;
+    }
+    if (!sData.profileP) {
+        sData.profileP = malloc(SIM_MAX_PROFILE_DAYS * SIM_HOURS_IN_A_DAY * sizeof(float));
+    }
+    while ((days < SIM_MAX_PROFILE_DAYS) && fgets(line, sizeof(line), fP)) {
+        float *hP = &sData.profileP[days * SIM_HOURS_IN_A_DAY];
+        char *cP = line;
+        char *endP;
+        uint8_t h;
+        if (line[0] == '#') {
+            continue;
+        }
+        float total = 0;
+        float broken;
+        for (h = 0; h < SIM_HOURS_IN_A_DAY; h++) {
+            hP[h] = strtof(cP, &endP);
+            if (endP == cP) {
+                break;
+            }
+            total += hP[h];
+            // Allow comma or space separated values
+            cP = endP;
+            while ((*cP == ',') || (*cP == ' ') || (*cP == '\t')) {
+                cP++;
+            }
+        }
+        if (h == SIM_HOURS_IN_A_DAY) {
+            // Optional broken day marker, otherwise a day without flow
+            broken = strtof(cP, &endP);
+            if (((endP != cP) && (broken != 0)) || ((endP == cP) && (total < 1))) {
+                sData.dayFlagsP[days] |= SIM_DAY_BROKEN;
+            }
+            days++;
+        }
+    }
+    fclose(fP);
+    return days;
+}
+
+/**
+* \brief Create one day of the synthetic profile.
+*
+* @param litersPerHourP returns the 24 hourly liter values
+* @param baseLiters the unit daily liters
+* @param flowFactor 1 for a working pump, less if broken
+*/
+static void sim_syntheticDay(float *litersPerHourP, float baseLiters, float flowFactor) {
+    uint8_t h;
+    // Seasonal change (+-20%), weekday pattern and +-25% daily noise
+    float liters = baseLiters * weekdayFactor[sData.day % 7] *
+        (1.0 + (0.2 * sin(2 * M_PI * sData.day / 365.0))) * (0.75 + (0.5 * sim_rand()));
+    for (h = 0; h < SIM_HOURS_IN_A_DAY; h++) {
+        litersPerHourP[h] = liters * flowFactor * hourlyWeight[h];
+    }
+}
+
+/**
+* \brief Simple xorshift random number generator, so runs are
+*        repeatable for a seed.
+*
+* @return float random value [0, 1)
+*/
+static float sim_rand(void) {
+    sData.rng ^= sData.rng << 13;
+    sData.rng ^= sData.rng >> 17;
+    sData.rng ^= sData.rng << 5;
+    return (sData.rng >> 8) / 16777216.0;
+}
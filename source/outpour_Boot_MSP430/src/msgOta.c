@@ -620,7 +620,7 @@ static void otaUpgrade_writeSectionData(void) {
 * \brief Firmware Upgrade State Machine Function
 */
 static void otaUpgrade_verifySection(void) {
-    uint16_t calcCrc16 = gen_crc16((const unsigned char *)otaData.sectionStartAddrP, otaData.sectionDataLength);
+    uint16_t calcCrc16 = gen_crc16(FLASH_ADDR_TO_PTR(otaData.sectionStartAddrP), otaData.sectionDataLength);
     if (calcCrc16 == otaData.sectionCrc16) {
         // For outpour, we only can support one section due to lack of 
         // bootloader memory to support burning multiple sections.
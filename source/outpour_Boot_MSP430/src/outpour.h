@@ -147,6 +147,20 @@ void sysError(void);
 /*******************************************************************************
 * Utils.c
 *******************************************************************************/
+/**
+ * \def CRC16_INIT_VALUE
+ * \brief Start value of a CRC16 computed with gen_crc16_update.
+ */
+#define CRC16_INIT_VALUE ((unsigned int)0)
+
+/**
+ * \def CRC16_FINAL
+ * \brief Finish a CRC16 computed with gen_crc16_update (the 
+ *        CRC16 has no output xor).
+ */
+#define CRC16_FINAL(crc) (crc)
+
+unsigned int gen_crc16_update(unsigned int crc, const unsigned char *data, unsigned int size);
 unsigned int gen_crc16(const unsigned char *data, unsigned int size);
 
 /*******************************************************************************
@@ -304,6 +318,16 @@ void msp430Flash_write_bytes(uint8_t *flashP, uint8_t *srcP, uint16_t num_bytes)
 #define FLASH_UPGRADE_KEY3 ((uint8_t)0x59)
 #define FLASH_UPGRADE_KEY4 ((uint8_t)0x26)
 
+/**
+ * \def FLASH_ADDR_TO_PTR
+ * \brief Convert a 16 bit flash address to a pointer used to
+ *        read the flash contents.  The host simulation build
+ *        overrides this to read its emulated flash image.
+ */
+#ifndef FLASH_ADDR_TO_PTR
+#define FLASH_ADDR_TO_PTR(a) ((uint8_t *)(a))
+#endif
+
 #define BLR_LOCATION ((uint8_t *)0x1080)  // INFO B
 #define APR_LOCATION ((uint8_t *)0x1040)  // INFO C
 
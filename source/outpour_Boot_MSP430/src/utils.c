@@ -9,10 +9,94 @@
 #include "outpour.h"
 
 /**
- * \def CRC16
- * \brief The CRC-16-ANSI polynomial constant.
+ * \def CRC16_BYTE_TABLE
+ * \brief Select the table used for the CRC16 (CRC-16-ANSI,
+ *        polynomial 0x8005 bit reversed, init 0).  Set to 1 for
+ *        the 256 entry byte table (512 bytes of flash, one lookup
+ *        per byte) or 0 for the 16 entry nibble table (32 bytes,
+ *        two lookups per byte).  Both give the same result.
  */
-#define CRC16 0x8005
+#ifndef CRC16_BYTE_TABLE
+#define CRC16_BYTE_TABLE 0
+#endif
+
+#if (CRC16_BYTE_TABLE==1)
+/**
+ * \var crc16Table
+ * \brief CRC16 of each byte value (polynomial 0xA001).
+ */
+static const uint16_t crc16Table[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+#else
+/**
+ * \var crc16NibbleTable
+ * \brief CRC16 of each nibble value (polynomial 0xA001).
+ */
+static const uint16_t crc16NibbleTable[16] = {
+    0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+    0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400,
+};
+#endif
+
+/**
+* \brief Utility function to update a 16 bit CRC with the data 
+*        in a buffer.  A CRC is computed in pieces by starting
+*        with CRC16_INIT_VALUE, calling this function for each
+*        piece in order, and applying CRC16_FINAL.
+* 
+* @param crc The CRC of the preceding data
+* @param data Pointer to the data buffer to calculate the CRC
+*             over
+* @param size Length of the data in bytes to calculate over.
+* 
+* @return unsigned int The updated CRC value
+*/
+unsigned int gen_crc16_update(unsigned int crc, const unsigned char *data, unsigned int size) {
+    while (size > 0) {
+#if (CRC16_BYTE_TABLE==1)
+        crc = (crc >> 8) ^ crc16Table[(crc ^ *data) & 0xFF];
+#else
+        crc = (crc >> 4) ^ crc16NibbleTable[(crc ^ *data) & 0xF];
+        crc = (crc >> 4) ^ crc16NibbleTable[(crc ^ (*data >> 4)) & 0xF];
+#endif
+        data++;
+        size--;
+        WATCHDOG_TICKLE();
+    }
+    return crc;
+}
 
 /**
 * \brief Utility function to calculate a 16 bit CRC on data in a
@@ -25,43 +109,7 @@
 * @return unsigned int The CRC calculated value
 */
 unsigned int gen_crc16(const unsigned char *data, unsigned int size) {
-    volatile unsigned int out = 0;
-    volatile int bits_read = 0;
-    volatile int bit_flag;
-
-    while (size > 0) {
-        bit_flag = out >> 15;
-        /* Get next bit: */
-        out <<= 1;
-        out |= (*data >> bits_read) & 1; // item a) work from the least significant bits
-        /* Increment bit counter: */
-        bits_read++;
-        if (bits_read > 7) {
-            bits_read = 0;
-            data++;
-            size--;
-            WATCHDOG_TICKLE();
-        }
-        /* Cycle check: */
-        if (bit_flag) out ^= CRC16;
-    }
-
-    // item b) "push out" the last 16 bits
-    unsigned int i;
-    for (i = 0; i < 16; ++i) {
-        bit_flag = out >> 15;
-        out <<= 1;
-        if (bit_flag) out ^= CRC16;
-    }
-
-    // item c) reverse the bits
-    unsigned int crc = 0;
-    i = 0x8000;
-    unsigned int j = 0x0001;
-    for (; i != 0; i >>= 1, j <<= 1) {
-        if (i & out) crc |= j;
-    }
-    return crc;
+    return CRC16_FINAL(gen_crc16_update(CRC16_INIT_VALUE, data, size));
 }
 
 #if 0